@@ -44,9 +44,9 @@ typedef struct config_node_t {
 
 static config_node *config_value_start = NULL;
 static config_node *config_value_end = NULL;
+static arena_t *config_arena = NULL;	/* 노드와 문자열 (설정 세대마다 하나) */
 
 static int config_value_add(const char *parameter, const char *value);
-static void config_value_destroy(config_node *start);
 static int config_parse(FILE *fp);
 static void trim_value(char **value);
 static char *str_chr(const char *string);
@@ -91,14 +91,17 @@ config_value_add(const char *parameter, const char *value)
 	size = strlen(parameter) + 1;
     }
 
-    data = (char *) malloc(size);
-    node = (config_node *) malloc(sizeof(config_node));
-    if(data == NULL || node == NULL) {
-	FREE(data);
-	FREE(node);
+    if(config_arena == NULL && (config_arena = arena_create(0)) == NULL) {
 	return -1;
     }
 
+    /* 노드와 문자열을 한번에 할당 */
+    node = (config_node *) arena_alloc(config_arena, sizeof(config_node) + size);
+    if(node == NULL) {
+	return -1;
+    }
+    data = (char *) (node + 1);
+
     node->parameter = data;
     *node->parameter = '\0';
     strcat(node->parameter, parameter);
@@ -128,29 +131,6 @@ config_value_add(const char *parameter, const char *value)
 }
 
 
-/**
- * @brief 링크드 리스트 제거 함수 
- * @param start - 링크드 리스트 시작점
- * @return 없음
- */
-static void
-config_value_destroy(config_node *start)
-{
-    config_node *next_node = NULL;
-    config_node *cur_node = NULL;
-
-    cur_node = start;
-    while(cur_node) {
-	next_node = cur_node->next_node;
-	if(cur_node->parameter) {
-	    free(cur_node->parameter);
-	}
-	free(cur_node);
-	cur_node = next_node;
-    }
-}
-
-
 /**
  * @brief 파라메터의 설정값 리턴 함수 
  * @param parameter - 검색할 파라메터 이름
@@ -216,6 +196,8 @@ config_read(const char *filename, int (*check)(void **), void **err)
     char msg[8192];
     FILE *fp = NULL;
     config_node *prev_config_start = NULL;
+    config_node *prev_config_end = NULL;
+    arena_t *prev_arena = NULL;
 
     ASSERT(filename != NULL);
 
@@ -226,7 +208,11 @@ config_read(const char *filename, int (*check)(void **), void **err)
     }
 
     prev_config_start = config_value_start;
+    prev_config_end = config_value_end;
+    prev_arena = config_arena;
     config_value_start = NULL;
+    config_value_end = NULL;
+    config_arena = NULL;
 
     /* parsing후 링크드 리스트 생성 */
     if(config_parse(fp) < 0) {
@@ -239,9 +225,7 @@ config_read(const char *filename, int (*check)(void **), void **err)
     /* 새로 설정파일을 읽어들이는데 성공하고나서
      * 기존 설정 리스트를 제거한다
      */
-    if(prev_config_start) {
-	config_value_destroy(prev_config_start);
-    }
+    arena_destroy(prev_arena);
 
     fclose(fp);
 
@@ -251,8 +235,10 @@ finish:
     /* 새로 설정파일을 로드하는데 실패하면 기존
      * 설정 리스트를 복구한다.
      */
-    config_value_destroy(config_value_start);
+    arena_destroy(config_arena);
+    config_arena = prev_arena;
     config_value_start = prev_config_start;
+    config_value_end = prev_config_end;
 
     return -1;
 }
@@ -450,3 +436,45 @@ config_free_list(config_list_t *ptr)
     }
     free(ptr);
 }
+
+
+/**
+ * @brief 현재 설정을 배열로 복사 (arena 할당)
+ * @param a - arena
+ * @return 
+ *  성공 시 현재 설정의 배열 (마지막 항목의 parameter 는 NULL),\n
+ *  실패 시 NULL 포인터
+ *
+ * config_get_list() 와 같은 배열을 \a a 에 할당하므로 config_free_list()
+ * 대신 arena_reset() 으로 한번에 해제한다.
+ */
+config_list_t *
+config_get_list_arena(arena_t *a)
+{
+    int i, cnt;
+    config_list_t *buf = NULL;
+    config_node *cur_node = NULL;
+
+    ASSERT(a != NULL);
+
+    cnt = 0;
+    for (cur_node = config_value_start; cur_node; cur_node = cur_node->next_node)
+	cnt++;
+
+    /* +1 is last NULL entry */
+    buf = arena_alloc(a, sizeof(config_list_t) * (cnt + 1));
+    if (!buf)
+	return NULL;
+
+    for (i = 0, cur_node = config_value_start; i < cnt && cur_node; 
+	    i++, cur_node = cur_node->next_node)
+    {
+	buf[i].parameter = cur_node->parameter ? arena_strdup(a, cur_node->parameter) : NULL;
+	buf[i].value = cur_node->value ? arena_strdup(a, cur_node->value) : NULL;
+	if ((cur_node->parameter && !buf[i].parameter) || (cur_node->value && !buf[i].value))
+	    return NULL;
+    }
+    buf[cnt].parameter = buf[cnt].value = NULL;
+
+    return buf;
+}
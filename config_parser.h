@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include "onvarena.h"
 
 /*
  * 설정사항 리스트 구조체
@@ -39,5 +40,6 @@ int config_check_parameter(const char *parameter);
 int config_read(const char *filename, int (*check)(void **), void **err);
 config_list_t *config_get_list(void);
 void config_free_list(config_list_t *ptr);
+config_list_t *config_get_list_arena(arena_t *a);
 
 #endif
@@ -16,7 +16,13 @@
  *   splint -noeffect +matchanyintegral -mustfreefresh -exportlocal -paramuse -usedef -compdef -retvalint -retvalother -nullpass -nestcomment -unrecog -preproc -warnposix misclib.c
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "misclib.h"
+#include "onvsockopt.h"
+#include "onvwait.h"
 #include <stdio.h>
 #include <errno.h>
 #include <unistd.h>
@@ -29,7 +35,8 @@
 #include <netdb.h>
 #include <ctype.h>
 #include <time.h>
-static int wait_packet(int fd,int msec);
+#include <sched.h>
+#include <sys/uio.h>
 
 /**
  * @brief accept() wrapping 함수
@@ -66,6 +73,59 @@ again:
 }
 
 
+/**
+ * @brief 리슨 소켓의 backlog 를 한번에 accept
+ * @param listenfd - Non-blocking 리슨 소켓
+ * @param conns - (OUT) 받은 연결을 저장할 배열
+ * @param maxconns - \a conns 의 크기
+ * @param opt - 새 연결마다 적용할 소켓 옵션 (NULL 가능)
+ * @return
+ *  성공 시 받은 연결 수 (backlog 가 비었으면 0),\n
+ *  하나도 받지 못하고 에러가 나면 -1
+ *
+ * accept4(SOCK_NONBLOCK | SOCK_CLOEXEC) 로 받으므로 연결마다 fcntl() 을 따로
+ * 호출할 필요가 없다. \a maxconns 만큼 받았으면 backlog 가 남아있을 수
+ * 있으므로 0 을 반환하거나 \a maxconns 보다 작을 때까지 다시 호출한다.
+ */
+int
+accept_batch(int listenfd, accept_conn_t *conns, int maxconns, const struct sockopt_s *opt)
+{
+    int n = 0, fd;
+
+    ASSERT(conns != NULL);
+
+    while (n < maxconns) {
+	conns[n].addrlen = sizeof(conns[n].addr);
+	fd = accept4(listenfd, (struct sockaddr *) &conns[n].addr, &conns[n].addrlen,
+		SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0) {
+#ifdef  EPROTO
+	    if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+#else
+	    if (errno == EINTR || errno == ECONNABORTED) {
+#endif
+		continue;
+	    }
+	    if (errno == EAGAIN || errno == EWOULDBLOCK || n > 0) {
+		break;
+	    }
+	    return -1;
+	}
+
+	conns[n++].fd = fd;
+    }
+
+    /* 옵션은 accept 가 끝난 뒤 한번에 적용 */
+    if (opt) {
+	for (fd = 0; fd < n; fd++) {
+	    (void) sockopt_apply(conns[fd].fd, opt);
+	}
+    }
+
+    return n;
+}
+
+
 /**
  * @brief 소켓 연결 
  * @param host - 호스트네임 또는 IP
@@ -76,6 +136,25 @@ again:
  *  실패 시 -1
  */
 int tcp_Connect(const char *ip, const int port, int timeout)
+{
+    sockopt_t opt;
+
+    (void) sockopt_profile(SOCKOPT_DEFAULT, &opt);
+    return tcp_Connect_opt(ip, port, timeout, &opt);
+}
+
+
+/**
+ * @brief 소켓 옵션을 적용해서 소켓 연결
+ * @param ip - 접속 IP
+ * @param port - 접속 포트
+ * @param timeout - 최대 접속대기시간
+ * @param opt - connect 전에 적용할 소켓 옵션 (NULL 가능, sockopt_profile() 참고)
+ * @return
+ *  성공 시 socket descriptor,\n
+ *  실패 시 -1
+ */
+int tcp_Connect_opt(const char *ip, const int port, int timeout, const struct sockopt_s *opt)
 {
     int fd;
     struct sockaddr_in servaddr;
@@ -90,6 +169,7 @@ int tcp_Connect(const char *ip, const int port, int timeout)
 //    fd = socket(AF_INET, SOCK_STREAM, 0);
     fd = socket(PF_INET, SOCK_STREAM, 0);
     if (fd < 0) return -1;
+    (void) sockopt_apply_connect(fd, opt);
 
     memset(&servaddr, 0, sizeof(servaddr));
 //    servaddr.sin_family = AF_INET;
@@ -98,7 +178,10 @@ int tcp_Connect(const char *ip, const int port, int timeout)
     servaddr.sin_addr.s_addr = inet_addr(ip);
 //    memcpy(&servaddr.sin_addr, *hptr->h_addr_list, sizeof(servaddr.sin_addr));
 
-    if (connect(fd, (struct sockaddr *) &servaddr, (socklen_t) sizeof(servaddr)) < 0) return -1;
+    if (connect(fd, (struct sockaddr *) &servaddr, (socklen_t) sizeof(servaddr)) < 0) {
+	close(fd);
+	return -1;
+    }
 
     return fd;
 }
@@ -214,6 +297,47 @@ daemonize(void)
  */
 int
 socket_listen(int port)
+{
+    sockopt_t opt;
+
+    (void) sockopt_profile(SOCKOPT_DEFAULT, &opt);
+    return socket_listen_opt(port, 0, &opt);
+}
+
+
+/**
+ * @brief SO_REUSEPORT 로 특정 포트에 리슨하는 함수
+ * @param port - 리슨할 포트 번호
+ * @return
+ *  성공 시 socket descriptor,\n
+ *  실패 시 -1
+ *
+ * 같은 포트에 쓰레드/프로세스마다 하나씩 생성하면 커널이 새 연결을 각
+ * 소켓에 분배하므로 accept queue 경합과 thundering herd 가 없다.
+ */
+int
+socket_listen_reuseport(int port)
+{
+    sockopt_t opt;
+
+    (void) sockopt_profile(SOCKOPT_DEFAULT, &opt);
+    return socket_listen_opt(port, 1, &opt);
+}
+
+
+/**
+ * @brief 소켓 옵션을 적용해서 리슨 소켓 생성
+ * @param port - 리슨할 포트 번호
+ * @param reuseport - 0 이 아니면 SO_REUSEPORT 설정
+ * @param opt - 리슨 소켓 옵션 (NULL 가능, backlog 포함, sockopt_profile() 참고)
+ * @return
+ *  성공 시 socket descriptor,\n
+ *  실패 시 -1
+ *
+ * 옵션은 listen() 전에 적용되어 accept 한 소켓에 상속된다.
+ */
+int
+socket_listen_opt(int port, int reuseport, const struct sockopt_s *opt)
 {
     int fd;
     struct sockaddr_in servaddr;
@@ -229,12 +353,21 @@ socket_listen(int port)
     servaddr.sin_port = htons((uint16_t) port);
 
     if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, (socklen_t) sizeof(on)) < 0) {
+	close(fd);
 	return -1;
     }
+    if(reuseport &&
+	    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, (socklen_t) sizeof(on)) < 0) {
+	close(fd);
+	return -1;
+    }
+    (void) sockopt_apply_listen(fd, opt);
     if(bind(fd, (struct sockaddr *) &servaddr, (socklen_t) sizeof(servaddr)) < 0) {
+	close(fd);
 	return -1;
     }
-    if(listen(fd, 1024) < 0) {
+    if(listen(fd, opt && opt->backlog > 0 ? opt->backlog : SOCKOPT_BACKLOG) < 0) {
+	close(fd);
 	return -1;
     }
 
@@ -242,6 +375,43 @@ socket_listen(int port)
 }
 
 
+/**
+ * @brief 현재 쓰레드(프로세스)를 허용된 CPU 중 \a index 번째에 고정
+ * @param index - 워커 번호 (허용된 CPU 수로 나눈 나머지를 사용)
+ * @return
+ *  성공 시 고정한 CPU 번호,\n
+ *  실패 시 -1
+ */
+int
+cpu_pin(int index)
+{
+    cpu_set_t allowed, set;
+    int cpu, n, ncpu;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+	return -1;
+    }
+    if ((ncpu = CPU_COUNT(&allowed)) <= 0) {
+	return -1;
+    }
+
+    n = index % ncpu;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+	if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+	    break;
+	}
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+	return -1;
+    }
+
+    return cpu;
+}
+
+
 /**
  * @brief Socket에서 \a n 만큼 read
  * @param fd - Socket descriptor
@@ -289,6 +459,8 @@ readn(int fd, void *vptr, size_t n)
  * @return
  *  성공 시 수신한 데이터 사이즈,\n
  *  실패 시 -1
+ *
+ * 대기시간은 패킷마다 다시 시작된다. 전체 제한시간은 readn_deadline() 을 사용.
  */
 ssize_t readn_timewait(int fd, void *vptr, size_t n,int msec)
 {
@@ -300,13 +472,13 @@ ssize_t readn_timewait(int fd, void *vptr, size_t n,int msec)
     ptr = vptr;
     nleft = n;
     while(nleft > 0) {
-        retcode  =  wait_packet(fd,msec);
-        // select time out or error
-        if(retcode < 0 ){ 
+        retcode  =  wait_fd(fd, WAIT_READ, wait_deadline(msec));
+        // time out or error
+        if(retcode <= 0 ){ 
             return (ssize_t) (n - nleft);
         }
 	if((nread = read(fd, ptr, nleft)) < 0) {
-	    if(errno == EINTR) {
+	    if(errno == EINTR || errno == EAGAIN) {
 		nread = 0;
 	    }
 	    else {
@@ -324,6 +496,45 @@ ssize_t readn_timewait(int fd, void *vptr, size_t n,int msec)
 }
 
 
+/**
+ * @brief Socket에서 \a 최대 n 만큼 read (전체 제한시간)
+ * @param fd - Socket descriptor
+ * @param vptr - 수신한 데이터를 저장할 버퍼
+ * @param n - 수신할 데이터의 최대 사이즈
+ * @param deadline - wait_deadline() 으로 구한 완료 시각
+ * @return
+ *  성공 시 수신한 데이터 사이즈 (deadline 초과 또는 EOF 면 n 보다 작음),\n
+ *  실패 시 -1
+ */
+ssize_t readn_deadline(int fd, void *vptr, size_t n, long deadline)
+{
+    size_t nleft;
+    ssize_t nread;
+    char *ptr = NULL;
+
+    ptr = vptr;
+    nleft = n;
+    while(nleft > 0) {
+        if(wait_fd(fd, WAIT_READ, deadline) <= 0) {
+            break;
+        }
+	if((nread = read(fd, ptr, nleft)) < 0) {
+	    if(errno == EINTR || errno == EAGAIN) {
+		continue;
+	    }
+	    return -1;
+	} else if(nread == 0) {
+	    break;
+	}
+
+	nleft -= nread;
+	ptr += nread;
+    }
+
+    return (ssize_t) (n - nleft);
+}
+
+
 /**
  * @brief Socket에 \a len 만큼 write
  * @param connfd - Socket descriptor
@@ -360,6 +571,284 @@ again:
     return (ssize_t) ((twrite == olen) ? twrite : -1);
 }
 
+/**
+ * @brief iovec 배열의 (idx, off) 위치부터 최대 IOV_BATCH 개를 \a out 에 복사
+ * @return 복사한 iovec 수
+ */
+static int
+iov_fill(struct iovec *out, const struct iovec *iov, int iovcnt, int idx, size_t off)
+{
+    int n = 0;
+
+    for (; idx < iovcnt && n < IOV_BATCH; idx++) {
+	if (iov[idx].iov_len <= off) {
+	    off = 0;
+	    continue;
+	}
+	out[n].iov_base = (char *) iov[idx].iov_base + off;
+	out[n].iov_len = iov[idx].iov_len - off;
+	off = 0;
+	n++;
+    }
+
+    return n;
+}
+
+/**
+ * @brief 처리한 바이트 수 \a done 만큼 (idx, off) 위치를 전진
+ */
+static void
+iov_advance(const struct iovec *iov, int iovcnt, int *idx, size_t *off, size_t done)
+{
+    while (*idx < iovcnt && done > 0) {
+	if (iov[*idx].iov_len - *off > done) {
+	    *off += done;
+	    return;
+	}
+	done -= iov[*idx].iov_len - *off;
+	*off = 0;
+	(*idx)++;
+    }
+    /* 길이 0 인 iovec 건너뜀 */
+    while (*idx < iovcnt && iov[*idx].iov_len == *off) {
+	*off = 0;
+	(*idx)++;
+    }
+}
+
+/**
+ * @brief Socket에 iovec 배열의 데이터를 모두 write (scatter-gather)
+ * @param connfd - Socket descriptor
+ * @param iov - write할 데이터 배열 (변경하지 않음)
+ * @param iovcnt - \a iov 의 개수 (IOV_MAX 보다 커도 됨)
+ * @return
+ *  성공 시 write한 바이트수,\n
+ *  실패 시 -1
+ *
+ * 헤더와 본문을 하나의 버퍼로 복사하지 않고 writev() 로 한번에 보낸다.
+ * 일부만 써지면 남은 위치부터 다시 writev() 한다.
+ */
+ssize_t
+writenv(int connfd, const struct iovec *iov, int iovcnt)
+{
+    struct iovec vec[IOV_BATCH];
+    ssize_t nwrite;
+    size_t twrite = 0, off = 0;
+    int idx = 0, n;
+
+    ASSERT(iov != NULL || iovcnt == 0);
+
+    iov_advance(iov, iovcnt, &idx, &off, 0);
+    while((n = iov_fill(vec, iov, iovcnt, idx, off)) > 0) {
+	if((nwrite = writev(connfd, vec, n)) < 0) {
+	    if(errno == EINTR) {
+		continue;
+	    }
+	    else {
+		return -1;
+	    }
+	}
+
+	iov_advance(iov, iovcnt, &idx, &off, nwrite);
+	twrite += nwrite;
+    }
+
+    return (ssize_t) twrite;
+}
+
+/**
+ * @brief Socket에서 iovec 배열을 모두 채울 때까지 read (scatter-gather)
+ * @param fd - Socket descriptor
+ * @param iov - 수신한 데이터를 저장할 버퍼 배열
+ * @param iovcnt - \a iov 의 개수 (IOV_MAX 보다 커도 됨)
+ * @return
+ *  성공 시 수신한 데이터 사이즈 (EOF 면 전체 길이보다 작음),\n
+ *  실패 시 -1
+ */
+ssize_t
+readnv(int fd, const struct iovec *iov, int iovcnt)
+{
+    struct iovec vec[IOV_BATCH];
+    ssize_t nread;
+    size_t tread = 0, off = 0;
+    int idx = 0, n;
+
+    ASSERT(iov != NULL || iovcnt == 0);
+
+    iov_advance(iov, iovcnt, &idx, &off, 0);
+    while((n = iov_fill(vec, iov, iovcnt, idx, off)) > 0) {
+	if((nread = readv(fd, vec, n)) < 0) {
+	    if(errno == EINTR) {
+		continue;
+	    }
+	    else {
+		return -1;
+	    }
+	}
+	else if(nread == 0) {
+	    break;
+	}
+
+	iov_advance(iov, iovcnt, &idx, &off, nread);
+	tread += nread;
+    }
+
+    return (ssize_t) tread;
+}
+
+/**
+ * @brief non-blocking Socket에 iovec 배열을 EAGAIN 이 날때까지 write
+ * @param connfd - Socket descriptor (non-blocking)
+ * @param iov - write할 데이터 배열 (변경하지 않음)
+ * @param iovcnt - \a iov 의 개수
+ * @return
+ *  성공 시 write한 바이트수 (전체 길이보다 작으면 나머지는 다음에 써야 함),\n
+ *  실패 시 -1
+ */
+ssize_t
+writenv_nonblock(int connfd, const struct iovec *iov, int iovcnt)
+{
+    struct iovec vec[IOV_BATCH];
+    ssize_t nwrite;
+    size_t twrite = 0, off = 0;
+    int idx = 0, n;
+
+    ASSERT(iov != NULL || iovcnt == 0);
+
+    iov_advance(iov, iovcnt, &idx, &off, 0);
+    while((n = iov_fill(vec, iov, iovcnt, idx, off)) > 0) {
+	if((nwrite = writev(connfd, vec, n)) < 0) {
+	    if(errno == EINTR) {
+		continue;
+	    }
+	    else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+		break;
+	    }
+	    else {
+		return -1;
+	    }
+	}
+
+	iov_advance(iov, iovcnt, &idx, &off, nwrite);
+	twrite += nwrite;
+    }
+
+    return (ssize_t) twrite;
+}
+
+/**
+ * @brief descriptor 를 non-blocking 으로 설정
+ * @param fd - descriptor
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+set_nonblock(int fd)
+{
+    int flags;
+
+    if ((flags = fcntl(fd, F_GETFL, 0)) < 0) {
+	return -1;
+    }
+    if (flags & O_NONBLOCK) {
+	return 0;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * @brief Non-blocking socket 에서 읽을 수 있는 만큼 최대 \a n read
+ * @param fd - Non-blocking socket descriptor
+ * @param vptr - 수신한 데이터를 저장할 버퍼
+ * @param n - 수신할 데이터의 최대 사이즈
+ * @param eof - (OUT) 상대방이 연결을 종료했으면 1 (NULL 가능)
+ * @return
+ *  성공 시 수신한 데이터 사이즈 (EAGAIN 이면 0 일 수 있음),\n
+ *  실패 시 -1
+ *
+ * readn() 과 같지만 EAGAIN 에서 블록하지 않고 그때까지 읽은 길이를 반환한다.
+ * edge-triggered 이벤트 루프에서는 \a n 보다 작게 반환될 때까지 호출한다.
+ */
+ssize_t
+readn_nonblock(int fd, void *vptr, size_t n, int *eof)
+{
+    size_t nleft;
+    ssize_t nread;
+    char *ptr = NULL;
+
+    if (eof) {
+	*eof = 0;
+    }
+
+    ptr = vptr;
+    nleft = n;
+    while(nleft > 0) {
+	if((nread = read(fd, ptr, nleft)) < 0) {
+	    if(errno == EINTR) {
+		nread = 0;
+	    }
+	    else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+		break;
+	    }
+	    else {
+		return -1;
+	    }
+	}
+	else if(nread == 0) {
+	    if (eof) {
+		*eof = 1;
+	    }
+	    break;
+	}
+
+	nleft -= nread;
+	ptr += nread;
+    }
+
+    return (ssize_t) (n - nleft);
+}
+
+/**
+ * @brief Non-blocking socket 에 쓸 수 있는 만큼 최대 \a len write
+ * @param connfd - Non-blocking socket descriptor
+ * @param buf - write할 데이터
+ * @param len - \a buf 의 길이
+ * @return
+ *  성공 시 write한 바이트수 (\a len 보다 작으면 나머지는 쓰기 가능 이벤트 후 재시도),\n
+ *  실패 시 -1
+ */
+ssize_t
+writen_nonblock(int connfd, const char *buf, size_t len)
+{
+    ssize_t nwrite;
+    size_t twrite = 0;
+    const char *ptr = buf;
+
+    ASSERT(buf != NULL);
+
+    while(len > 0) {
+	if((nwrite = write(connfd, ptr, len)) < 0) {
+	    if(errno == EINTR) {
+		continue;
+	    }
+	    else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+		break;
+	    }
+	    else {
+		return -1;
+	    }
+	}
+
+	len -= nwrite;
+	ptr += nwrite;
+	twrite += nwrite;
+    }
+
+    return (ssize_t) twrite;
+}
+
 /**
  * @brief 스트림 의 딜리미터 카운트
  * @param line_buff - 오픈할 로그파일명
@@ -481,6 +970,70 @@ char *only_digit (char *s)
 	return d;
 }
 
+/**
+ * @brief 스트림 to 배열 (arena 할당)
+ * @param a - arena (필드는 arena_reset() 으로 한번에 해제)
+ * @param line_buff - 구분자로 나뉜 문자열
+ * @param arr_ptr - 수평배열 (L2A_MAX_ROW + 1 개)
+ * @param del - 구분자
+ * @return
+ *  성공시 n - 배열의 갯수
+ *  실패시 -1
+ *
+ * l2a() 와 같은 배열을 만들지만 필드마다 strdup 하지 않으므로 free_l2a()
+ * 가 필요 없고, 필드 길이 제한도 없다.
+ */
+int l2a_arena (arena_t *a, const char *line_buff, char *arr_ptr[], const char del)
+{
+	const char *ptr;
+	char dels[2];
+	size_t n;
+	int cnt;
+
+	dels[0] = del;
+	dels[1] = '\0';
+	cnt = 0;
+	ptr = line_buff;
+	while (*ptr != '\0')
+	{
+		n = strcspn (ptr, dels);
+		arr_ptr[cnt] = arena_strndup (a, ptr, n);
+		if (arr_ptr[cnt] == NULL) return -1;
+		cnt++;
+		if (ptr[n] == '\0') break;
+		if (cnt >= L2A_MAX_ROW) return -1;	// 필드 갯수가 너무 큼.
+		ptr += n + 1;	// delimitor skip
+	}
+	arr_ptr[cnt] = NULL;
+
+    return cnt;
+}
+
+/**
+ * @brief 숫자이외의 값 필터링 (arena 할당).
+ * @param a - arena
+ * @param s - 문자열
+ * @return
+ *  성공시 숫자만 남긴 문자열 (free 하지 않음)
+ *  실패시 NULL
+ */
+char *only_digit_arena (arena_t *a, const char *s)
+{
+	char *d, *p;
+
+	d = arena_alloc (a, strlen(s)+1);
+	if (d == NULL) return NULL;
+	p = d;
+	while (*s != '\0')
+	{
+		if (isdigit((unsigned char) *s)) *p++ = *s;
+		s++;
+	}
+	*p = '\0';
+
+	return d;
+}
+
 /*
 // 테스트용 코드...
 int main (int argc, char *argv[])
@@ -556,39 +1109,6 @@ int Exec(char *argv)
 	return i;	/* return code */
 }
 
-/**
- * wait_packet - 연결된 DCE connection에서 패킷 수신 대기
- *
- * @param fd: 소켓 디스크립터
- * @param msec: 소켓 디스크립터
- * @return: 성공 시 0, 실패(Timeout or Error) 시 -1
- */
-static int wait_packet(int fd,int msec) {
-    int result;
-    fd_set rset;
-    struct timeval tm;
-
-    FD_ZERO(&rset);
-    FD_SET(fd, &rset);
-
-    /*
-     * 소켓이 PING_PERIOD 시간동안 idle 상태이면 select 중지
-     */
-    tm.tv_sec = msec / 1000;
-    tm.tv_usec = (msec % 1000) *1000;
-    result = select(fd + 1, &rset, NULL, NULL, &tm);
-    if (result <= 0) {
-        if (result == 0 || errno == EINTR){ /* Timeout or Interrupt */
-            return -1;
-        }else {
-            /* Error */
-            Log(ERROR,"select() function failed: %s", strerror(errno));
-            return -1;
-        }
-    }
-    return 0;
-}
-
 /**
  * @brief UDP 패킷 전송 함수
  * @param ip ip주소
@@ -22,9 +22,11 @@
 #endif
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <stdlib.h>
 #include "log.h"
+#include "onvarena.h"
 
 #define ARRAY_SIZE(x)	sizeof(x) / sizeof((x)[0])
 #define	FREE(pointer)	do { free(pointer); (pointer) = NULL; } while(0)
@@ -41,13 +43,41 @@
 #define ASSERT(expression)  (void) 0
 #endif
 
+struct sockopt_s;
+
+/**
+ * accept_batch() 로 받은 연결 정보
+ */
+typedef struct accept_conn_s
+{
+    int fd;				/**< 연결 소켓 (non-blocking, close-on-exec) */
+    struct sockaddr_storage addr;	/**< 상대방 주소 */
+    socklen_t addrlen;			/**< \a addr 의 길이 */
+} accept_conn_t;
+
+#define ACCEPT_BATCH_MAX	64	/**< accept_batch() 권장 배열 크기 */
+#define IOV_BATCH		64	/**< writenv()/readnv() 한번의 시스템콜에 넘기는 최대 iovec 수 */
+
 int Accept(int fd, struct sockaddr *sa, socklen_t *salenptr);
+int accept_batch(int listenfd, accept_conn_t *conns, int maxconns,
+	const struct sockopt_s *opt);
 int daemonize(void);
 int socket_listen(int port);
+int socket_listen_reuseport(int port);
+int socket_listen_opt(int port, int reuseport, const struct sockopt_s *opt);
+int cpu_pin(int index);
 int tcp_Connect(const char *ip, const int port, int timeout);
+int tcp_Connect_opt(const char *ip, const int port, int timeout, const struct sockopt_s *opt);
 ssize_t readn_timewait(int fd, void *vptr, size_t n,int msec);
+ssize_t readn_deadline(int fd, void *vptr, size_t n, long deadline);
 ssize_t writen(int connfd, const char *buf, size_t len);
 ssize_t readn(int fd, void *vptr, size_t n);
+ssize_t writenv(int connfd, const struct iovec *iov, int iovcnt);
+ssize_t readnv(int fd, const struct iovec *iov, int iovcnt);
+int set_nonblock(int fd);
+ssize_t readn_nonblock(int fd, void *vptr, size_t n, int *eof);
+ssize_t writen_nonblock(int connfd, const char *buf, size_t len);
+ssize_t writenv_nonblock(int connfd, const struct iovec *iov, int iovcnt);
 int udp_sendPacket(char * ip , int port , char *data, int datalen);
 void dumpdata(char *filename, char* data,int datalen);
 void printbyte(char * buf , int buflen);
@@ -63,6 +93,8 @@ int l2a (char *line_buff, char *arr_ptr[], const char del);
 void free_l2a (char *arr_ptr[]);
 int count_DELIMITOR (char *line_buff, const char del);
 char *only_digit (char *s);
+int l2a_arena (arena_t *a, const char *line_buff, char *arr_ptr[], const char del);
+char *only_digit_arena (arena_t *a, const char *s);
 int Exec(char *argv);
 
 #endif
@@ -0,0 +1,300 @@
+/**
+ * @file onvarena.c
+ * @brief 영역(arena) 메모리 할당기
+ */
+
+/*
+ * 영역(arena) 메모리 할당기
+ *
+ * 요청이나 배치 하나를 처리하는 동안 쓰는 작은 문자열(l2a 필드,
+ * only_digit, escape 문자열, 설정 목록 등)을 malloc/free 로 하나씩 다루지
+ * 않고 chunk 안에서 포인터만 증가시켜 할당한다. 개별 해제는 없고
+ * arena_reset() 한번으로 모두 버린다.
+ *
+ * arena_reset() 은 chunk 를 해제하지 않고 처음부터 다시 쓰므로 같은 크기의
+ * 배치를 반복하면 워밍업 이후에는 malloc 이 없다. chunk 보다 큰 할당은
+ * 그 크기의 chunk 를 따로 만든다. 스레드에 안전하지 않다 (스레드/요청마다
+ * 하나씩 쓴다).
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvarena.h"
+
+/**
+ * chunk (데이터는 헤더 바로 뒤)
+ */
+typedef struct arena_chunk_s
+{
+    struct arena_chunk_s *next;
+    size_t size;		/**< 데이터 영역 크기 */
+    size_t used;		/**< 사용한 크기 */
+} arena_chunk_t;
+
+struct arena_s
+{
+    arena_chunk_t *head;	/**< chunk 목록 */
+    arena_chunk_t *cur;		/**< 할당중인 chunk */
+    size_t chunk;		/**< 기본 chunk 크기 */
+    size_t used;		/**< 이전 chunk 들에서 사용한 크기 */
+};
+
+#define CHUNK_DATA(c)	((char *) ((c) + 1))
+
+static void *chunk_take(arena_chunk_t *c, size_t n);
+static arena_chunk_t *chunk_new(arena_t *a, size_t n);
+
+
+/**
+ * @brief chunk 에서 \a n 바이트를 정렬해서 잘라냄
+ * @return
+ *  성공 시 주소,\n
+ *  공간이 모자라면 NULL
+ */
+static void *
+chunk_take(arena_chunk_t *c, size_t n)
+{
+    uintptr_t base = (uintptr_t) CHUNK_DATA(c);
+    size_t off;
+
+    off = (size_t) (((base + c->used + ARENA_ALIGN - 1) & ~((uintptr_t) ARENA_ALIGN - 1)) - base);
+    if (off > c->size || n > c->size - off) {
+	return NULL;
+    }
+    c->used = off + n;
+
+    return CHUNK_DATA(c) + off;
+}
+
+
+/**
+ * @brief 새 chunk 를 만들어 현재 chunk 뒤에 연결
+ */
+static arena_chunk_t *
+chunk_new(arena_t *a, size_t n)
+{
+    arena_chunk_t *c = NULL;
+    size_t size = a->chunk;
+
+    if (n + ARENA_ALIGN > size) {
+	size = n + ARENA_ALIGN;
+    }
+    if ((c = malloc(sizeof(arena_chunk_t) + size)) == NULL) {
+	Log(ERROR, "arena: malloc(%zu) failed: %s", size, strerror(errno));
+	return NULL;
+    }
+    c->size = size;
+    c->used = 0;
+
+    if (a->cur) {
+	c->next = a->cur->next;
+	a->cur->next = c;
+	a->used += a->cur->used;
+    }
+    else {
+	c->next = a->head;
+	a->head = c;
+    }
+    a->cur = c;
+
+    return c;
+}
+
+
+/**
+ * @brief arena 생성
+ * @param chunk - chunk 크기 (0 이면 ARENA_CHUNK)
+ * @return
+ *  성공 시 arena,\n
+ *  실패 시 NULL
+ *
+ * 첫 chunk 는 처음 할당할 때 만든다.
+ */
+arena_t *
+arena_create(size_t chunk)
+{
+    arena_t *a = NULL;
+
+    if ((a = calloc(1, sizeof(arena_t))) == NULL) {
+	Log(ERROR, "arena: calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    a->chunk = chunk ? chunk : ARENA_CHUNK;
+
+    return a;
+}
+
+
+/**
+ * @brief arena 와 모든 chunk 해제
+ * @param a - arena (NULL 가능)
+ * @return 없음
+ */
+void
+arena_destroy(arena_t *a)
+{
+    arena_chunk_t *c = NULL, *next = NULL;
+
+    if (a == NULL) {
+	return;
+    }
+    for (c = a->head; c != NULL; c = next) {
+	next = c->next;
+	free(c);
+    }
+    free(a);
+}
+
+
+/**
+ * @brief 할당한 메모리를 모두 버림 (chunk 는 다시 쓰기 위해 유지)
+ * @param a - arena
+ * @return 없음
+ */
+void
+arena_reset(arena_t *a)
+{
+    ASSERT(a != NULL);
+
+    a->cur = a->head;
+    a->used = 0;
+    if (a->cur) {
+	a->cur->used = 0;
+    }
+}
+
+
+/**
+ * @brief \a n 바이트 할당 (ARENA_ALIGN 정렬, 개별 해제 없음)
+ * @param a - arena
+ * @param n - 크기
+ * @return
+ *  성공 시 주소 (arena_reset()/arena_destroy() 까지 유효),\n
+ *  실패 시 NULL
+ */
+void *
+arena_alloc(arena_t *a, size_t n)
+{
+    arena_chunk_t *c = NULL, *prev = NULL;
+    void *p = NULL;
+
+    ASSERT(a != NULL);
+
+    if (n == 0) {
+	n = 1;
+    }
+
+    if (a->cur && (p = chunk_take(a->cur, n)) != NULL) {
+	return p;
+    }
+
+    /*
+     * reset 전에 쓰던 chunk 중 들어가는 것을 현재 chunk 바로 뒤로 옮겨서
+     * 재사용 (건너뛴 chunk 는 그 뒤에 남아 다음에 쓴다)
+     */
+    for (prev = a->cur, c = a->cur ? a->cur->next : NULL; c != NULL; prev = c, c = c->next) {
+	if (c->size < n + ARENA_ALIGN) {
+	    continue;
+	}
+	if (prev != a->cur) {
+	    prev->next = c->next;
+	    c->next = a->cur->next;
+	    a->cur->next = c;
+	}
+	a->used += a->cur->used;
+	c->used = 0;
+	a->cur = c;
+	return chunk_take(c, n);
+    }
+
+    if ((c = chunk_new(a, n)) == NULL) {
+	return NULL;
+    }
+
+    return chunk_take(c, n);
+}
+
+
+/**
+ * @brief 문자열 복사
+ * @param a - arena
+ * @param s - 문자열
+ * @return
+ *  성공 시 복사한 문자열,\n
+ *  실패 시 NULL
+ */
+char *
+arena_strdup(arena_t *a, const char *s)
+{
+    ASSERT(s != NULL);
+
+    return arena_strndup(a, s, strlen(s));
+}
+
+
+/**
+ * @brief 최대 \a n 바이트 문자열 복사 (항상 '\\0' 으로 끝남)
+ * @param a - arena
+ * @param s - 문자열
+ * @param n - 최대 길이
+ * @return
+ *  성공 시 복사한 문자열,\n
+ *  실패 시 NULL
+ */
+char *
+arena_strndup(arena_t *a, const char *s, size_t n)
+{
+    char *d = NULL;
+
+    ASSERT(s != NULL);
+
+    n = strnlen(s, n);
+    if ((d = arena_alloc(a, n + 1)) == NULL) {
+	return NULL;
+    }
+    memcpy(d, s, n);
+    d[n] = '\0';
+
+    return d;
+}
+
+
+/**
+ * @brief 현재 사용중인 크기 (정렬 여유 포함)
+ */
+size_t
+arena_used(const arena_t *a)
+{
+    return a->used + (a->cur ? a->cur->used : 0);
+}
+
+
+/**
+ * @brief 잡고 있는 chunk 전체 크기
+ */
+size_t
+arena_size(const arena_t *a)
+{
+    const arena_chunk_t *c = NULL;
+    size_t size = 0;
+
+    for (c = a->head; c != NULL; c = c->next) {
+	size += c->size;
+    }
+
+    return size;
+}
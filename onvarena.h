@@ -0,0 +1,38 @@
+/**
+ * @file onvarena.h
+ * @brief 영역(arena) 메모리 할당기 헤더
+ */
+
+/*
+ * 영역(arena) 메모리 할당기 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_ARENA_H
+#define ONV_ARENA_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define ARENA_CHUNK	16384	/**< 기본 chunk 크기 */
+#define ARENA_ALIGN	16	/**< 할당 정렬 */
+
+typedef struct arena_s arena_t;
+
+arena_t *arena_create(size_t chunk);
+void arena_destroy(arena_t *a);
+void arena_reset(arena_t *a);
+void *arena_alloc(arena_t *a, size_t n);
+char *arena_strdup(arena_t *a, const char *s);
+char *arena_strndup(arena_t *a, const char *s, size_t n);
+size_t arena_used(const arena_t *a);
+size_t arena_size(const arena_t *a);
+
+#endif
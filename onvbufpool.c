@@ -0,0 +1,525 @@
+/**
+ * @file onvbufpool.c
+ * @brief 크기별 송수신 버퍼 풀 (slab, 스레드 캐시, 참조계수)
+ */
+
+/*
+ * 크기별 송수신 버퍼 풀 (slab, 스레드 캐시, 참조계수)
+ *
+ * readn()/onvRead() 주변에서 메시지마다 malloc/free 하면 부하가 걸릴 때
+ * 힙이 조각나고 할당기 lock 비용이 든다. 이 풀은 256B ~ 32KB 의 2배수 크기
+ * 등급별로 mmap 한 slab 을 잘라 버퍼를 만들고, 한번 만든 버퍼는 해제하지
+ * 않고 다시 쓴다.
+ *
+ *  - 스레드마다 등급별 캐시(BUFPOOL_CACHE 개)를 두어 lock 없이 주고 받는다.
+ *    캐시가 비거나 넘치면 절반씩 전역 free list 와 lock 을 잡고 옮긴다.
+ *    다른 스레드에서 해제한 버퍼는 해제한 스레드의 캐시로 들어간다.
+ *  - 버퍼 헤더(pbuf_t)는 slab 안에서 데이터 바로 앞에 있으므로 워밍업이
+ *    끝나면 bufpool_get()/pbuf_unref() 경로에서 malloc 이 없다.
+ *  - 참조계수 버퍼이며 pbuf_slice() 로 일부를 복사 없이 넘길 수 있다.
+ *  - BUFPOOL_HUGEPAGE 이면 2MB slab 을 MAP_HUGETLB 로 잡고, 안되면
+ *    MADV_HUGEPAGE 를 요청한다 (TLB miss 감소).
+ *
+ * BUFPOOL_MAX_SIZE 보다 큰 요청은 malloc 으로 처리하고 통계에 남긴다.
+ * bufpool_destroy() 는 모든 스레드가 풀 사용을 끝낸 뒤 호출해야 한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvbufpool.h"
+
+#define PBUF_ALIGN	64
+#define PBUF_HDR	((sizeof(pbuf_t) + PBUF_ALIGN - 1) & ~((size_t) PBUF_ALIGN - 1))
+#define SLAB_HDR	PBUF_ALIGN
+#define CLASS_SIZE(c)	((size_t) 1 << (BUFPOOL_MIN_SHIFT + (c)))
+
+/**
+ * slab 앞부분 (slab 목록)
+ */
+typedef struct slab_s
+{
+    struct slab_s *next;
+    size_t size;
+} slab_t;
+
+/**
+ * 스레드 캐시
+ */
+typedef struct bcache_s
+{
+    bufpool_t *pool;
+    pbuf_t *free[BUFPOOL_CLASSES];	/**< 등급별 free list */
+    int count[BUFPOOL_CLASSES];		/**< 등급별 버퍼 수 */
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t hits;
+    struct bcache_s *prev;
+    struct bcache_s *next;
+} bcache_t;
+
+struct bufpool_s
+{
+    pthread_mutex_t lock;		/**< 전역 free list, slab, 캐시 목록 보호 */
+    pthread_key_t key;			/**< 스레드 캐시 */
+    int flags;
+    pbuf_t *free[BUFPOOL_CLASSES];	/**< 전역 free list */
+    slab_t *slabs;
+    bcache_t *caches;			/**< 살아있는 스레드 캐시 목록 */
+    bufpool_stats_t st;			/**< 종료한 스레드 통계와 lock 으로 보호되는 통계 */
+};
+
+static int class_of(size_t size);
+static bcache_t *get_cache(bufpool_t *pool);
+static void cache_destroy(void *arg);
+static void move_to_global(bufpool_t *pool, bcache_t *c, int cls, int n);
+static int slab_new(bufpool_t *pool, int cls);
+static int refill(bufpool_t *pool, bcache_t *c, int cls);
+static void put(pbuf_t *b);
+
+
+/**
+ * @brief 크기에 맞는 등급
+ */
+static int
+class_of(size_t size)
+{
+    int cls = 0;
+
+    while (CLASS_SIZE(cls) < size) {
+	cls++;
+    }
+
+    return cls;
+}
+
+
+/**
+ * @brief 현재 스레드의 캐시 (처음이면 생성)
+ */
+static bcache_t *
+get_cache(bufpool_t *pool)
+{
+    bcache_t *c = NULL;
+
+    if ((c = pthread_getspecific(pool->key)) != NULL) {
+	return c;
+    }
+
+    if ((c = calloc(1, sizeof(bcache_t))) == NULL) {
+	return NULL;
+    }
+    c->pool = pool;
+    if (pthread_setspecific(pool->key, c) != 0) {
+	free(c);
+	return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    c->next = pool->caches;
+    if (pool->caches) {
+	pool->caches->prev = c;
+    }
+    pool->caches = c;
+    pthread_mutex_unlock(&pool->lock);
+
+    return c;
+}
+
+
+/**
+ * @brief 캐시의 버퍼 \a n 개를 전역 free list 로 (lock 을 잡은 상태)
+ */
+static void
+move_to_global(bufpool_t *pool, bcache_t *c, int cls, int n)
+{
+    pbuf_t *b = NULL;
+
+    while (n-- > 0 && (b = c->free[cls]) != NULL) {
+	c->free[cls] = b->next;
+	c->count[cls]--;
+	b->next = pool->free[cls];
+	pool->free[cls] = b;
+    }
+}
+
+
+/**
+ * @brief 스레드 종료 시 캐시를 전역으로 돌려줌 (pthread key destructor)
+ */
+static void
+cache_destroy(void *arg)
+{
+    bcache_t *c = (bcache_t *) arg;
+    bufpool_t *pool = c->pool;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < BUFPOOL_CLASSES; i++) {
+	move_to_global(pool, c, i, c->count[i]);
+    }
+    if (c->prev) {
+	c->prev->next = c->next;
+    }
+    else {
+	pool->caches = c->next;
+    }
+    if (c->next) {
+	c->next->prev = c->prev;
+    }
+    pool->st.allocs += c->allocs;
+    pool->st.frees += c->frees;
+    pool->st.hits += c->hits;
+    pthread_mutex_unlock(&pool->lock);
+
+    free(c);
+}
+
+
+/**
+ * @brief 버퍼 풀 생성
+ * @param flags - 0 또는 BUFPOOL_HUGEPAGE
+ * @return
+ *  성공 시 풀,\n
+ *  실패 시 NULL
+ */
+bufpool_t *
+bufpool_create(int flags)
+{
+    bufpool_t *pool = NULL;
+
+    if ((pool = calloc(1, sizeof(bufpool_t))) == NULL) {
+	Log(ERROR, "bufpool: calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    if (pthread_key_create(&pool->key, cache_destroy) != 0) {
+	free(pool);
+	return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->flags = flags;
+
+    return pool;
+}
+
+
+/**
+ * @brief 버퍼 풀 해제 (slab 과 모든 스레드 캐시)
+ * @param pool - 풀
+ * @return 없음
+ *
+ * 아직 참조중인 풀 버퍼도 함께 사라진다.
+ */
+void
+bufpool_destroy(bufpool_t *pool)
+{
+    bcache_t *c = NULL, *cnext = NULL;
+    slab_t *s = NULL, *snext = NULL;
+
+    if (pool == NULL) {
+	return;
+    }
+
+    pthread_key_delete(pool->key);
+    for (c = pool->caches; c != NULL; c = cnext) {
+	cnext = c->next;
+	free(c);
+    }
+    for (s = pool->slabs; s != NULL; s = snext) {
+	snext = s->next;
+	munmap(s, s->size);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+
+/**
+ * @brief slab 하나를 할당해서 \a cls 등급 버퍼로 잘라 전역 free list 에 추가
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (lock 을 잡은 상태에서 호출)
+ */
+static int
+slab_new(bufpool_t *pool, int cls)
+{
+    slab_t *s = NULL;
+    pbuf_t *b = NULL;
+    size_t size = BUFPOOL_SLAB, chunk, off;
+    void *addr = MAP_FAILED;
+
+    if (pool->flags & BUFPOOL_HUGEPAGE) {
+	size = BUFPOOL_HUGE_SLAB;
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (addr != MAP_FAILED) {
+	    pool->st.huge = 1;
+	}
+    }
+    if (addr == MAP_FAILED) {
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+	    Log(ERROR, "bufpool: mmap(%zu) failed: %s", size, strerror(errno));
+	    return -1;
+	}
+	if (pool->flags & BUFPOOL_HUGEPAGE) {
+	    madvise(addr, size, MADV_HUGEPAGE);
+	}
+    }
+
+    s = (slab_t *) addr;
+    s->size = size;
+    s->next = pool->slabs;
+    pool->slabs = s;
+    pool->st.slabs++;
+    pool->st.slab_bytes += size;
+
+    chunk = PBUF_HDR + CLASS_SIZE(cls);
+    for (off = SLAB_HDR; off + chunk <= size; off += chunk) {
+	b = (pbuf_t *) ((char *) addr + off);
+	b->data = (char *) b + PBUF_HDR;
+	b->size = CLASS_SIZE(cls);
+	b->cls = cls;
+	b->pool = pool;
+	b->next = pool->free[cls];
+	pool->free[cls] = b;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 전역 free list 에서 캐시로 BUFPOOL_CACHE / 2 개를 가져옴
+ */
+static int
+refill(bufpool_t *pool, bcache_t *c, int cls)
+{
+    pbuf_t *b = NULL;
+    int n;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->free[cls] == NULL && slab_new(pool, cls) < 0) {
+	pthread_mutex_unlock(&pool->lock);
+	return -1;
+    }
+    for (n = 0; n < BUFPOOL_CACHE / 2 && (b = pool->free[cls]) != NULL; n++) {
+	pool->free[cls] = b->next;
+	b->next = c->free[cls];
+	c->free[cls] = b;
+	c->count[cls]++;
+    }
+    pool->st.refills++;
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+
+/**
+ * @brief 버퍼 할당
+ * @param pool - 풀
+ * @param size - 필요한 크기
+ * @return
+ *  성공 시 버퍼 (참조계수 1, len 0, size 는 등급 크기),\n
+ *  실패 시 NULL
+ */
+pbuf_t *
+bufpool_get(bufpool_t *pool, size_t size)
+{
+    bcache_t *c = NULL;
+    pbuf_t *b = NULL;
+    int cls;
+
+    ASSERT(pool != NULL);
+
+    if (size > BUFPOOL_MAX_SIZE) {
+	if ((b = malloc(PBUF_HDR + size)) == NULL) {
+	    return NULL;
+	}
+	b->data = (char *) b + PBUF_HDR;
+	b->size = size;
+	b->cls = -1;
+	b->pool = pool;
+	pthread_mutex_lock(&pool->lock);
+	pool->st.oversize++;
+	pool->st.allocs++;
+	pthread_mutex_unlock(&pool->lock);
+    }
+    else {
+	if ((c = get_cache(pool)) == NULL) {
+	    return NULL;
+	}
+	cls = class_of(size);
+	if (c->free[cls] != NULL) {
+	    c->hits++;
+	}
+	else if (refill(pool, c, cls) < 0) {
+	    return NULL;
+	}
+	b = c->free[cls];
+	c->free[cls] = b->next;
+	c->count[cls]--;
+	c->allocs++;
+    }
+
+    b->next = NULL;
+    b->len = 0;
+    b->refcnt = 1;
+
+    return b;
+}
+
+
+/**
+ * @brief 참조계수가 0 이 된 버퍼를 현재 스레드 캐시로 반환
+ */
+static void
+put(pbuf_t *b)
+{
+    bufpool_t *pool = b->pool;
+    bcache_t *c = NULL;
+    int cls = b->cls;
+
+    if (cls < 0) {
+	pthread_mutex_lock(&pool->lock);
+	pool->st.frees++;
+	pthread_mutex_unlock(&pool->lock);
+	free(b);
+	return;
+    }
+
+    if ((c = get_cache(pool)) == NULL) {
+	pthread_mutex_lock(&pool->lock);
+	b->next = pool->free[cls];
+	pool->free[cls] = b;
+	pool->st.frees++;
+	pthread_mutex_unlock(&pool->lock);
+	return;
+    }
+
+    b->next = c->free[cls];
+    c->free[cls] = b;
+    c->frees++;
+    if (++c->count[cls] >= BUFPOOL_CACHE) {
+	pthread_mutex_lock(&pool->lock);
+	move_to_global(pool, c, cls, BUFPOOL_CACHE / 2);
+	pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+/**
+ * @brief 참조 추가
+ * @param b - 버퍼
+ * @return \a b
+ */
+pbuf_t *
+pbuf_ref(pbuf_t *b)
+{
+    __atomic_add_fetch(&b->refcnt, 1, __ATOMIC_RELAXED);
+    return b;
+}
+
+
+/**
+ * @brief 참조 해제 (0 이 되면 풀로 반환)
+ * @param b - 버퍼 (NULL 가능)
+ * @return 없음
+ */
+void
+pbuf_unref(pbuf_t *b)
+{
+    if (b == NULL || __atomic_sub_fetch(&b->refcnt, 1, __ATOMIC_ACQ_REL) > 0) {
+	return;
+    }
+    put(b);
+}
+
+
+/**
+ * @brief 버퍼 일부를 참조 (zero-copy hand-off)
+ * @param b - 버퍼
+ * @param off - 시작 위치
+ * @param len - 길이
+ * @param s - (OUT) slice (pslice_release() 로 해제)
+ * @return
+ *  성공 시 0,\n
+ *  범위를 벗어나면 -1 (EINVAL)
+ */
+int
+pbuf_slice(pbuf_t *b, size_t off, size_t len, pslice_t *s)
+{
+    ASSERT(b != NULL && s != NULL);
+
+    if (off > b->size || len > b->size - off) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    s->buf = pbuf_ref(b);
+    s->data = b->data + off;
+    s->len = len;
+
+    return 0;
+}
+
+
+/**
+ * @brief slice 해제
+ * @param s - slice
+ * @return 없음
+ */
+void
+pslice_release(pslice_t *s)
+{
+    if (s == NULL || s->buf == NULL) {
+	return;
+    }
+    pbuf_unref(s->buf);
+    s->buf = NULL;
+    s->data = NULL;
+    s->len = 0;
+}
+
+
+/**
+ * @brief 풀 통계
+ * @param pool - 풀
+ * @param st - (OUT) 통계
+ * @return 없음
+ */
+void
+bufpool_stats(bufpool_t *pool, bufpool_stats_t *st)
+{
+    bcache_t *c = NULL;
+
+    ASSERT(pool != NULL && st != NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    *st = pool->st;
+    for (c = pool->caches; c != NULL; c = c->next) {
+	st->allocs += __atomic_load_n(&c->allocs, __ATOMIC_RELAXED);
+	st->frees += __atomic_load_n(&c->frees, __ATOMIC_RELAXED);
+	st->hits += __atomic_load_n(&c->hits, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file onvbufpool.h
+ * @brief 크기별 송수신 버퍼 풀 (slab, 스레드 캐시, 참조계수) 헤더
+ */
+
+/*
+ * 크기별 송수신 버퍼 풀 (slab, 스레드 캐시, 참조계수) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_BUFPOOL_H
+#define ONV_BUFPOOL_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define BUFPOOL_CLASSES		8			/**< 크기 등급 수 (256B ~ 32KB) */
+#define BUFPOOL_MIN_SHIFT	8			/**< 가장 작은 등급 256B */
+#define BUFPOOL_MAX_SIZE	(1 << (BUFPOOL_MIN_SHIFT + BUFPOOL_CLASSES - 1))	/**< 풀에서 주는 최대 크기 */
+#define BUFPOOL_SLAB		(256 * 1024)		/**< slab 크기 */
+#define BUFPOOL_HUGE_SLAB	(2 * 1024 * 1024)	/**< hugepage slab 크기 */
+#define BUFPOOL_CACHE		64			/**< 스레드 캐시에 등급별로 두는 최대 버퍼 수 */
+
+#define BUFPOOL_HUGEPAGE	0x01	/**< slab 을 hugepage 로 할당 */
+
+typedef struct bufpool_s bufpool_t;
+
+/**
+ * 풀 버퍼 (헤더는 slab 안에서 데이터 바로 앞에 있음)
+ */
+typedef struct pbuf_s
+{
+    char *data;			/**< 데이터 */
+    size_t len;			/**< 사용한 길이 (사용자가 설정) */
+    size_t size;		/**< \a data 크기 */
+    int refcnt;			/**< 참조계수 */
+    int cls;			/**< 크기 등급 (-1 이면 풀 밖에서 malloc) */
+    bufpool_t *pool;		/**< 소속 풀 */
+    struct pbuf_s *next;	/**< free list */
+} pbuf_t;
+
+/**
+ * 버퍼 일부에 대한 참조 (복사 없이 다른 모듈/스레드로 넘길 때)
+ */
+typedef struct pslice_s
+{
+    pbuf_t *buf;		/**< 참조하는 버퍼 */
+    char *data;			/**< 시작 위치 */
+    size_t len;			/**< 길이 */
+} pslice_t;
+
+/**
+ * 풀 통계 (스레드 캐시 값을 합친 근사값)
+ */
+typedef struct bufpool_stats_s
+{
+    uint64_t allocs;		/**< bufpool_get() 횟수 */
+    uint64_t frees;		/**< 풀로 돌아온 횟수 */
+    uint64_t hits;		/**< 스레드 캐시에서 바로 준 횟수 */
+    uint64_t refills;		/**< 전역 free list 에서 가져온 횟수 (lock) */
+    uint64_t oversize;		/**< BUFPOOL_MAX_SIZE 초과로 malloc 한 횟수 */
+    uint64_t slabs;		/**< 할당한 slab 수 */
+    uint64_t slab_bytes;	/**< slab 전체 크기 */
+    int huge;			/**< hugepage slab 사용 여부 */
+} bufpool_stats_t;
+
+bufpool_t *bufpool_create(int flags);
+void bufpool_destroy(bufpool_t *pool);
+pbuf_t *bufpool_get(bufpool_t *pool, size_t size);
+void bufpool_stats(bufpool_t *pool, bufpool_stats_t *st);
+
+pbuf_t *pbuf_ref(pbuf_t *b);
+void pbuf_unref(pbuf_t *b);
+int pbuf_slice(pbuf_t *b, size_t off, size_t len, pslice_t *s);
+void pslice_release(pslice_t *s);
+
+#endif
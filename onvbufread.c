@@ -0,0 +1,450 @@
+/**
+ * @file onvbufread.c
+ * @brief 버퍼링 소켓 리더 (ring buffer, frame/line 단위 읽기)
+ */
+
+/*
+ * 버퍼링 소켓 리더 (ring buffer, frame/line 단위 읽기)
+ *
+ * 연결마다 하나의 ring buffer 를 두고 read() 한번에 비어있는 공간을 최대한
+ * 채운다. 작은 메시지 여러개가 read() 한번으로 처리되므로 헤더/본문을 따로
+ * readn() 하는 것보다 시스템콜이 훨씬 적다.
+ *
+ * ring buffer 는 memfd 를 가상메모리에 두번 연속으로 매핑(mirror)하여 만든다.
+ * 끝을 넘어가는 데이터도 연속된 메모리로 보이므로 peek/frame/line 이 복사 없이
+ * 버퍼 안의 포인터를 반환한다. mirror 매핑이 불가능하면 선형 버퍼를 쓰고
+ * 필요할 때 남은 데이터를 앞으로 옮긴다.
+ *
+ * 반환된 포인터는 다음 bufread_*() 호출 전까지만 유효하다.
+ * non-blocking fd 에서는 데이터가 모자라면 NULL 을 반환하고 errno = EAGAIN 이며,
+ * 아무것도 소비하지 않으므로 다시 읽을 수 있게 되었을 때 같은 호출을 반복한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvbufread.h"
+
+/**
+ * 버퍼링 리더
+ */
+struct bufread_s
+{
+    int fd;			/**< 읽을 descriptor */
+    char *buf;			/**< 버퍼 (mirror 이면 2 * size 매핑) */
+    size_t size;		/**< 버퍼 크기 */
+    size_t head;		/**< 읽을 위치 */
+    size_t tail;		/**< 쓸 위치 */
+    int mirror;			/**< mirror 매핑이면 1 */
+    int eof;			/**< 상대방 연결 종료 */
+};
+
+static int map_mirror(bufread_t *br);
+static char *data_ptr(bufread_t *br);
+static int want(bufread_t *br, size_t n);
+
+
+/**
+ * @brief memfd 를 두번 연속 매핑하여 mirror ring buffer 생성
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+static int
+map_mirror(bufread_t *br)
+{
+    char *addr = NULL;
+    int memfd;
+
+    if ((memfd = memfd_create("onvbufread", MFD_CLOEXEC)) < 0) {
+	return -1;
+    }
+    if (ftruncate(memfd, br->size) < 0) {
+	close(memfd);
+	return -1;
+    }
+
+    addr = mmap(NULL, br->size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+	close(memfd);
+	return -1;
+    }
+    if (mmap(addr, br->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED ||
+	    mmap(addr + br->size, br->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED) {
+	munmap(addr, br->size * 2);
+	close(memfd);
+	return -1;
+    }
+    close(memfd);
+
+    br->buf = addr;
+    br->mirror = 1;
+    return 0;
+}
+
+
+/**
+ * @brief 읽지 않은 데이터의 시작 주소
+ */
+static char *
+data_ptr(bufread_t *br)
+{
+    return br->buf + (br->mirror ? br->head % br->size : br->head);
+}
+
+
+/**
+ * @brief 버퍼링 리더 생성
+ * @param fd - 읽을 descriptor (blocking, non-blocking 모두 가능)
+ * @param size - 버퍼 크기 (0 이면 BUFREAD_SIZE, 페이지 크기 배수로 올림)
+ * @return
+ *  성공 시 리더,\n
+ *  실패 시 NULL
+ *
+ * 한 frame(헤더 포함) 또는 한 줄의 최대 길이는 버퍼 크기이다.
+ * fd 는 bufread_destroy() 에서 닫지 않는다.
+ */
+bufread_t *
+bufread_create(int fd, size_t size)
+{
+    bufread_t *br = NULL;
+    size_t page;
+
+    page = (size_t) sysconf(_SC_PAGESIZE);
+    if (size == 0) {
+	size = BUFREAD_SIZE;
+    }
+    size = (size + page - 1) / page * page;
+
+    if ((br = calloc(1, sizeof(bufread_t))) == NULL) {
+	Log(ERROR, "bufread: calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    br->fd = fd;
+    br->size = size;
+
+    if (map_mirror(br) < 0) {
+	Log(DEBUG, "bufread: mirror mapping unavailable, using linear buffer");
+	if ((br->buf = malloc(size)) == NULL) {
+	    Log(ERROR, "bufread: malloc() failed: %s", strerror(errno));
+	    free(br);
+	    return NULL;
+	}
+    }
+
+    return br;
+}
+
+
+/**
+ * @brief 버퍼링 리더 해제 (fd 는 닫지 않음)
+ * @param br - 리더
+ * @return 없음
+ */
+void
+bufread_destroy(bufread_t *br)
+{
+    if (!br) {
+	return;
+    }
+    if (br->mirror) {
+	munmap(br->buf, br->size * 2);
+    }
+    else {
+	free(br->buf);
+    }
+    free(br);
+}
+
+
+/**
+ * @brief 리더의 descriptor
+ */
+int
+bufread_fd(const bufread_t *br)
+{
+    return br->fd;
+}
+
+
+/**
+ * @brief 버퍼 크기 (frame/line 최대 길이)
+ */
+size_t
+bufread_size(const bufread_t *br)
+{
+    return br->size;
+}
+
+
+/**
+ * @brief 버퍼에 남아있는 읽지 않은 데이터 크기
+ */
+size_t
+bufread_available(const bufread_t *br)
+{
+    return br->tail - br->head;
+}
+
+
+/**
+ * @brief 버퍼의 빈 공간을 read() 한번으로 채움
+ * @param br - 리더
+ * @return
+ *  성공 시 읽은 바이트수,\n
+ *  EOF 또는 버퍼가 가득 찬 경우 0,\n
+ *  실패 시 -1 (non-blocking 이면 errno = EAGAIN 가능)
+ */
+ssize_t
+bufread_fill(bufread_t *br)
+{
+    ssize_t nread;
+    size_t room;
+    char *ptr = NULL;
+
+    if (br->mirror) {
+	room = br->size - (br->tail - br->head);
+	ptr = br->buf + br->tail % br->size;
+    }
+    else {
+	/* 선형 버퍼: 끝에 공간이 없으면 남은 데이터를 앞으로 */
+	if (br->tail == br->size && br->head > 0) {
+	    memmove(br->buf, br->buf + br->head, br->tail - br->head);
+	    br->tail -= br->head;
+	    br->head = 0;
+	}
+	room = br->size - br->tail;
+	ptr = br->buf + br->tail;
+    }
+
+    if (room == 0) {
+	return 0;
+    }
+
+    while ((nread = read(br->fd, ptr, room)) < 0) {
+	if (errno != EINTR) {
+	    return -1;
+	}
+    }
+    if (nread == 0) {
+	br->eof = 1;
+    }
+    br->tail += nread;
+
+    return nread;
+}
+
+
+/**
+ * @brief \a n 바이트가 연속된 메모리로 준비될 때까지 채움
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (EOF 이면 errno = ECONNRESET, 너무 크면 EMSGSIZE)
+ */
+static int
+want(bufread_t *br, size_t n)
+{
+    ssize_t nread;
+
+    if (n > br->size) {
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    while (br->tail - br->head < n) {
+	if (!br->mirror && br->head + n > br->size) {
+	    memmove(br->buf, br->buf + br->head, br->tail - br->head);
+	    br->tail -= br->head;
+	    br->head = 0;
+	}
+	if (br->eof) {
+	    errno = ECONNRESET;
+	    return -1;
+	}
+	if ((nread = bufread_fill(br)) < 0) {
+	    return -1;
+	}
+	if (nread == 0 && br->eof) {
+	    errno = ECONNRESET;
+	    return -1;
+	}
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 소비하지 않고 \a n 바이트를 봄 (zero-copy)
+ * @param br - 리더
+ * @param n - 볼 바이트수 (버퍼 크기 이하)
+ * @return
+ *  성공 시 데이터 포인터 (다음 bufread_*() 호출 전까지 유효),\n
+ *  실패 시 NULL (errno = EAGAIN, ECONNRESET, EMSGSIZE 등)
+ */
+const char *
+bufread_peek(bufread_t *br, size_t n)
+{
+    if (want(br, n) < 0) {
+	return NULL;
+    }
+    return data_ptr(br);
+}
+
+
+/**
+ * @brief \a n 바이트 소비
+ * @param br - 리더
+ * @param n - 소비할 바이트수 (bufread_available() 이하)
+ * @return 없음
+ */
+void
+bufread_consume(bufread_t *br, size_t n)
+{
+    ASSERT(n <= br->tail - br->head);
+
+    br->head += n;
+    if (br->head == br->tail) {
+	br->head = br->tail = 0;
+    }
+}
+
+
+/**
+ * @brief 최대 \a n 바이트를 \a buf 로 복사 (read() 대체)
+ * @param br - 리더
+ * @param buf - 저장할 버퍼
+ * @param n - 최대 바이트수
+ * @return
+ *  성공 시 복사한 바이트수,\n
+ *  EOF 이면 0,\n
+ *  실패 시 -1
+ *
+ * 버퍼가 비어있을 때만 read() 를 한번 한다.
+ */
+ssize_t
+bufread_read(bufread_t *br, void *buf, size_t n)
+{
+    ssize_t nread;
+    size_t avail;
+
+    if (br->tail == br->head) {
+	if (br->eof) {
+	    return 0;
+	}
+	if ((nread = bufread_fill(br)) <= 0) {
+	    return nread;
+	}
+    }
+
+    avail = br->tail - br->head;
+    if (n > avail) {
+	n = avail;
+    }
+    memcpy(buf, data_ptr(br), n);
+    bufread_consume(br, n);
+
+    return (ssize_t) n;
+}
+
+
+/**
+ * @brief 다음 길이 prefix frame 을 읽음 (zero-copy)
+ * @param br - 리더
+ * @param lensize - 길이 필드 크기 (1, 2, 4)
+ * @param order - BUFREAD_BE 또는 BUFREAD_LE
+ * @param len - (OUT) 본문 길이 (길이 필드 제외)
+ * @return
+ *  성공 시 본문 포인터 (frame 은 소비됨, 다음 bufread_*() 호출 전까지 유효),\n
+ *  실패 시 NULL (errno = EAGAIN 이면 아무것도 소비하지 않음)
+ *
+ * 헤더와 본문 길이의 합이 버퍼 크기보다 크면 errno = EMSGSIZE.
+ */
+const char *
+bufread_frame(bufread_t *br, int lensize, int order, size_t *len)
+{
+    const unsigned char *p = NULL;
+    const char *body = NULL;
+    uint32_t n = 0;
+    int i;
+
+    ASSERT(lensize == 1 || lensize == 2 || lensize == 4);
+    ASSERT(len != NULL);
+
+    if ((p = (const unsigned char *) bufread_peek(br, lensize)) == NULL) {
+	return NULL;
+    }
+    for (i = 0; i < lensize; i++) {
+	if (order == BUFREAD_LE) {
+	    n |= (uint32_t) p[i] << (8 * i);
+	}
+	else {
+	    n = (n << 8) | p[i];
+	}
+    }
+
+    if ((body = bufread_peek(br, (size_t) lensize + n)) == NULL) {
+	return NULL;
+    }
+    bufread_consume(br, (size_t) lensize + n);
+    *len = n;
+
+    return body + lensize;
+}
+
+
+/**
+ * @brief 다음 \a delim 으로 끝나는 줄을 읽음 (zero-copy)
+ * @param br - 리더
+ * @param delim - 구분 문자 (예: '\\n')
+ * @param len - (OUT) 줄 길이 (구분 문자 제외)
+ * @return
+ *  성공 시 줄 포인터 (구분 문자까지 소비됨, 다음 bufread_*() 호출 전까지 유효),\n
+ *  실패 시 NULL (errno = EAGAIN 이면 아무것도 소비하지 않음)
+ *
+ * 버퍼가 가득 찰 때까지 구분 문자가 없으면 errno = EMSGSIZE.
+ * EOF 로 끝난 마지막 조각은 줄로 반환하지 않는다 (bufread_available() 로 확인).
+ */
+const char *
+bufread_line(bufread_t *br, int delim, size_t *len)
+{
+    const char *data = NULL, *end = NULL;
+    size_t scanned = 0, avail;
+
+    ASSERT(len != NULL);
+
+    for (;;) {
+	avail = br->tail - br->head;
+	if (avail > scanned) {
+	    data = data_ptr(br);
+	    if ((end = memchr(data + scanned, delim, avail - scanned)) != NULL) {
+		*len = (size_t) (end - data);
+		bufread_consume(br, *len + 1);
+		return data;
+	    }
+	    scanned = avail;
+	}
+	if (want(br, avail + 1) < 0) {
+	    return NULL;
+	}
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * @file onvbufread.h
+ * @brief 버퍼링 소켓 리더 (ring buffer, frame/line 단위 읽기) 헤더
+ */
+
+/*
+ * 버퍼링 소켓 리더 (ring buffer, frame/line 단위 읽기) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_BUFREAD_H
+#define ONV_BUFREAD_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define BUFREAD_SIZE	65536	/**< 기본 버퍼 크기 */
+
+#define BUFREAD_BE	0	/**< 길이 필드 big-endian (network order) */
+#define BUFREAD_LE	1	/**< 길이 필드 little-endian */
+
+typedef struct bufread_s bufread_t;
+
+bufread_t *bufread_create(int fd, size_t size);
+void bufread_destroy(bufread_t *br);
+int bufread_fd(const bufread_t *br);
+size_t bufread_size(const bufread_t *br);
+size_t bufread_available(const bufread_t *br);
+
+ssize_t bufread_fill(bufread_t *br);
+const char *bufread_peek(bufread_t *br, size_t n);
+void bufread_consume(bufread_t *br, size_t n);
+ssize_t bufread_read(bufread_t *br, void *buf, size_t n);
+const char *bufread_frame(bufread_t *br, int lensize, int order, size_t *len);
+const char *bufread_line(bufread_t *br, int delim, size_t *len);
+
+#endif
@@ -0,0 +1,816 @@
+/**
+ * @file onvco.hpp
+ * @brief C++20 코루틴 비동기 API (onvevent 이벤트 루프 기반, header-only)
+ */
+
+/*
+ * C++20 코루틴 비동기 API (onvevent 이벤트 루프 기반, header-only)
+ *
+ * blocking 함수(tcp_Connect, readn_timewait, writen)를 쓰레드로 감싸는 대신
+ * 하나의 event_loop_t 위에서 많은 세션을 코루틴으로 실행한다.
+ *
+ *     onv::task<void> session(event_loop_t *loop)
+ *     {
+ *         onv::socket s = co_await onv::connect(loop, "host", "8080", onv::after(3s));
+ *         if (!s) co_return;                       // s.error() == -errno
+ *         char hdr[4];
+ *         if (co_await s.read_exact(hdr, 4, onv::after(1s)) != 4) co_return;
+ *         co_await s.write_all("ok", 2);
+ *         co_await onv::sleep_for(loop, 100ms);
+ *     }
+ *     onv::spawn(loop, session(loop));
+ *     event_loop_run(loop);
+ *
+ * 모든 연산은 C 함수들과 같이 결과를 반환값으로 알린다: 성공 시 0 이상,
+ * 실패 시 -errno (timeout 은 -ETIMEDOUT, 취소는 -ECANCELED).
+ * deadline 은 연산 전체에 적용된다. cancel_source::cancel() 은 그 source 로
+ * 대기중인 모든 연산을 -ECANCELED 로 끝낸다.
+ *
+ * 코루틴, socket, cancel_source 는 루프 쓰레드에서만 사용한다.
+ * 다른 쓰레드에서는 spawn() 으로 코루틴을 넘긴다 (event_defer() 사용).
+ * connect() 의 이름 해석은 resolv_lookup() 캐시를 쓰며, 캐시에 없으면
+ * resolv_lookup_async() 로 재조회 쓰레드에 넘기고 event_defer() 로 재개하므로
+ * 조회하는 동안 루프의 다른 코루틴이 멈추지 않는다.
+ *
+ * 컴파일: g++ -std=c++20 ... libonv.a -lpthread
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_CO_HPP
+#define ONV_CO_HPP
+
+#include <coroutine>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netdb.h>
+
+extern "C" {
+#include "misclib.h"
+#include "onvevent.h"
+#include "onvresolv.h"
+}
+
+namespace onv {
+
+using clock = std::chrono::steady_clock;
+using deadline = clock::time_point;
+
+/** 무제한 deadline */
+inline deadline never() { return deadline::max(); }
+
+/** 현재부터 \a d 후의 deadline */
+template <class Rep, class Period>
+inline deadline after(std::chrono::duration<Rep, Period> d)
+{
+    return clock::now() + std::chrono::duration_cast<clock::duration>(d);
+}
+
+class cancel_source;
+class socket;
+
+namespace detail {
+
+/**
+ * 하나의 대기 (fd 준비, 타이머, 취소 중 먼저 오는 것으로 코루틴 재개)
+ */
+struct waiter
+{
+    event_loop_t *loop = nullptr;
+    std::coroutine_handle<> h;
+    long timer = -1;
+    int result = 0;
+    waiter **slot = nullptr;		/* socket 의 대기 슬롯 */
+    cancel_source *cancel = nullptr;
+    waiter *cprev = nullptr;
+    waiter *cnext = nullptr;
+
+    bool ready(deadline dl);
+    bool suspend(std::coroutine_handle<> handle, deadline dl);
+    void complete(int res);
+
+    static void on_timer(event_loop_t *, void *arg)
+    {
+	waiter *w = static_cast<waiter *>(arg);
+	w->timer = -1;
+	w->complete(-ETIMEDOUT);
+    }
+};
+
+} // namespace detail
+
+/**
+ * 취소 요청 (루프 쓰레드 전용)
+ */
+class cancel_source
+{
+public:
+    cancel_source() = default;
+    cancel_source(const cancel_source &) = delete;
+    cancel_source &operator=(const cancel_source &) = delete;
+    ~cancel_source() { cancel(); }
+
+    /** 대기중인 연산을 모두 -ECANCELED 로 끝내고, 이후 연산도 바로 실패시킴 */
+    void cancel()
+    {
+	cancelled_ = true;
+	while (head_) {
+	    head_->complete(-ECANCELED);
+	}
+    }
+
+    bool cancelled() const { return cancelled_; }
+
+private:
+    friend struct detail::waiter;
+    detail::waiter *head_ = nullptr;
+    bool cancelled_ = false;
+};
+
+namespace detail {
+
+inline bool
+waiter::ready(deadline dl)
+{
+    if (cancel && cancel->cancelled()) {
+	result = -ECANCELED;
+	return true;
+    }
+    if (dl != never() && dl <= clock::now()) {
+	result = -ETIMEDOUT;
+	return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 대기 시작 (await_suspend() 에서 호출)
+ * @return 대기하면 true, deadline 타이머를 등록하지 못하면 false (result = -errno, 바로 재개)
+ */
+inline bool
+waiter::suspend(std::coroutine_handle<> handle, deadline dl)
+{
+    long long ms;
+
+    if (dl != never()) {
+	ms = std::chrono::ceil<std::chrono::milliseconds>(dl - clock::now()).count();
+	timer = event_timer_add(loop, ms > INT_MAX ? INT_MAX : (int) (ms < 0 ? 0 : ms), 0, on_timer, this);
+	if (timer < 0) {
+	    /* deadline 없이 대기하면 영원히 멈출 수 있음 */
+	    result = -(errno ? errno : ENOMEM);
+	    return false;
+	}
+    }
+    h = handle;
+    if (slot) {
+	*slot = this;
+    }
+    if (cancel) {
+	cnext = cancel->head_;
+	if (cnext) {
+	    cnext->cprev = this;
+	}
+	cancel->head_ = this;
+    }
+    return true;
+}
+
+inline void
+waiter::complete(int res)
+{
+    std::coroutine_handle<> handle = h;
+
+    if (!handle) {
+	return;
+    }
+    h = nullptr;
+    if (timer >= 0) {
+	event_timer_del(loop, timer);
+	timer = -1;
+    }
+    if (slot && *slot == this) {
+	*slot = nullptr;
+    }
+    if (cancel) {
+	if (cprev) {
+	    cprev->cnext = cnext;
+	}
+	else if (cancel->head_ == this) {
+	    cancel->head_ = cnext;
+	}
+	if (cnext) {
+	    cnext->cprev = cprev;
+	}
+	cprev = cnext = nullptr;
+    }
+    result = res;
+    handle.resume();
+}
+
+/**
+ * waiter 를 감싼 awaitable (결과: 0 준비됨, -ETIMEDOUT, -ECANCELED, 타이머 등록 실패 시 -ENOMEM)
+ */
+struct wait_awaiter
+{
+    waiter w;
+    deadline dl;
+
+    bool await_ready() { return w.ready(dl); }
+    bool await_suspend(std::coroutine_handle<> handle) { return w.suspend(handle, dl); }
+    int await_resume() { return w.result; }
+};
+
+} // namespace detail
+
+/**
+ * 코루틴 반환 타입 (lazy: co_await 또는 spawn() 할 때 시작)
+ */
+template <class T = void>
+class task;
+
+namespace detail {
+
+struct promise_base
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    struct final_awaiter
+    {
+	bool await_ready() noexcept { return false; }
+	template <class P>
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+	{
+	    std::coroutine_handle<> next = h.promise().continuation;
+	    return next ? next : std::noop_coroutine();
+	}
+	void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+} // namespace detail
+
+template <class T>
+class task
+{
+public:
+    struct promise_type : detail::promise_base
+    {
+	T value{};
+
+	task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	template <class U>
+	void return_value(U &&v) { value = std::forward<U>(v); }
+    };
+
+    task(task &&o) noexcept : h_(std::exchange(o.h_, nullptr)) {}
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task() { if (h_) h_.destroy(); }
+
+    bool await_ready() { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont)
+    {
+	h_.promise().continuation = cont;
+	return h_;
+    }
+    T await_resume()
+    {
+	if (h_.promise().error) {
+	    std::rethrow_exception(h_.promise().error);
+	}
+	return std::move(h_.promise().value);
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+template <>
+class task<void>
+{
+public:
+    struct promise_type : detail::promise_base
+    {
+	task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	void return_void() {}
+    };
+
+    task(task &&o) noexcept : h_(std::exchange(o.h_, nullptr)) {}
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task() { if (h_) h_.destroy(); }
+
+    bool await_ready() { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont)
+    {
+	h_.promise().continuation = cont;
+	return h_;
+    }
+    void await_resume()
+    {
+	if (h_.promise().error) {
+	    std::rethrow_exception(h_.promise().error);
+	}
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail {
+
+/**
+ * spawn() 용 분리 실행 코루틴 (끝나면 스스로 해제, 처리되지 않은 예외는 terminate)
+ */
+struct detached
+{
+    struct promise_type
+    {
+	detached get_return_object() { return detached{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	std::suspend_never final_suspend() noexcept { return {}; }
+	void return_void() {}
+	void unhandled_exception() { std::terminate(); }
+    };
+    std::coroutine_handle<promise_type> h;
+};
+
+inline detached
+run_detached(task<void> t)
+{
+    co_await t;
+}
+
+inline void
+start_detached(event_loop_t *, void *arg)
+{
+    std::coroutine_handle<>::from_address(arg).resume();
+}
+
+} // namespace detail
+
+/**
+ * @brief 코루틴을 루프 쓰레드에서 분리 실행 (다른 쓰레드에서 호출해도 됨)
+ * @return 성공 시 0, 실패 시 -1
+ */
+inline int
+spawn(event_loop_t *loop, task<void> t)
+{
+    detail::detached d = detail::run_detached(std::move(t));
+
+    if (event_defer(loop, detail::start_detached, d.h.address()) < 0) {
+	d.h.destroy();
+	return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief \a ms 동안 대기
+ * @return 0, 취소 시 -ECANCELED, 타이머 등록 실패 시 -ENOMEM
+ */
+struct sleep_awaiter
+{
+    detail::waiter w;
+    deadline dl;
+
+    bool await_ready() { return w.cancel && w.cancel->cancelled(); }
+    bool await_suspend(std::coroutine_handle<> handle) { return w.suspend(handle, dl); }
+    int await_resume()
+    {
+	if (w.result == -ETIMEDOUT) {
+	    return 0;
+	}
+	if (w.cancel && w.cancel->cancelled()) {
+	    return -ECANCELED;
+	}
+	return w.result;
+    }
+};
+
+template <class Rep, class Period>
+inline sleep_awaiter
+sleep_for(event_loop_t *loop, std::chrono::duration<Rep, Period> d, cancel_source *cancel = nullptr)
+{
+    sleep_awaiter a;
+
+    a.w.loop = loop;
+    a.w.cancel = cancel;
+    a.dl = after(d);
+    return a;
+}
+
+/**
+ * non-blocking 소켓 (이벤트 루프에 등록, 소멸 시 close)
+ */
+class socket
+{
+public:
+    socket() = default;
+
+    /** @brief 기존 fd 를 넘겨받아 루프에 등록 (non-blocking 으로 설정) */
+    socket(event_loop_t *loop, int fd) : st_(new state{loop, fd, nullptr, nullptr})
+    {
+	if (event_add(loop, fd, on_read, on_write, st_.get()) < 0) {
+	    err_ = -(errno ? errno : EBADF);
+	    ::close(fd);
+	    st_.reset();
+	}
+    }
+
+    /** @brief 실패 결과 (\a err 는 -errno) */
+    static socket failed(int err)
+    {
+	socket s;
+	s.err_ = err;
+	return s;
+    }
+
+    socket(socket &&o) noexcept : st_(std::move(o.st_)), err_(o.err_) {}
+    socket &operator=(socket &&o) noexcept
+    {
+	if (this != &o) {
+	    close();
+	    st_ = std::move(o.st_);
+	    err_ = o.err_;
+	}
+	return *this;
+    }
+    ~socket() { close(); }
+
+    explicit operator bool() const { return st_ != nullptr; }
+    int fd() const { return st_ ? st_->fd : -1; }
+    int error() const { return err_; }
+    event_loop_t *loop() const { return st_ ? st_->loop : nullptr; }
+
+    /** @brief 루프에서 제거하고 close (대기중인 연산은 -ECANCELED) */
+    void close()
+    {
+	int fd = release();
+
+	if (fd >= 0) {
+	    ::close(fd);
+	}
+    }
+
+    /** @brief 루프에서 제거하고 fd 를 돌려줌 (close 하지 않음) */
+    int release()
+    {
+	std::unique_ptr<state> st = std::move(st_);
+	int fd;
+
+	if (!st) {
+	    return -1;
+	}
+	fd = st->fd;
+	event_del(st->loop, fd);
+	if (st->rd) {
+	    st->rd->complete(-ECANCELED);
+	}
+	if (st->wr) {
+	    st->wr->complete(-ECANCELED);
+	}
+	return fd;
+    }
+
+    /** @brief 읽기 가능할 때까지 대기 (0, -ETIMEDOUT, -ECANCELED) */
+    detail::wait_awaiter readable(deadline dl = never(), cancel_source *cancel = nullptr)
+    {
+	return make_wait(&st_->rd, dl, cancel);
+    }
+
+    /** @brief 쓰기 가능할 때까지 대기 (0, -ETIMEDOUT, -ECANCELED) */
+    detail::wait_awaiter writable(deadline dl = never(), cancel_source *cancel = nullptr)
+    {
+	return make_wait(&st_->wr, dl, cancel);
+    }
+
+    /** @brief 최대 \a n 바이트 읽기 (읽은 바이트수, EOF 면 0) */
+    task<ssize_t> read_some(void *buf, size_t n, deadline dl = never(), cancel_source *cancel = nullptr)
+    {
+	ssize_t nread;
+	int r;
+
+	for (;;) {
+	    if ((nread = ::read(fd(), buf, n)) >= 0) {
+		co_return nread;
+	    }
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		co_return -errno;
+	    }
+	    if ((r = co_await readable(dl, cancel)) < 0) {
+		co_return r;
+	    }
+	}
+    }
+
+    /**
+     * @brief \a n 바이트를 모두 읽기 (readn_deadline() 대응)
+     * @return \a n, EOF 면 그때까지 읽은 바이트수, 실패 시 -errno
+     */
+    task<ssize_t> read_exact(void *buf, size_t n, deadline dl = never(), cancel_source *cancel = nullptr)
+    {
+	char *ptr = static_cast<char *>(buf);
+	size_t nleft = n;
+	ssize_t nread;
+	int r;
+
+	while (nleft > 0) {
+	    if ((nread = ::read(fd(), ptr, nleft)) > 0) {
+		nleft -= nread;
+		ptr += nread;
+		continue;
+	    }
+	    if (nread == 0) {
+		break;
+	    }
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		co_return -errno;
+	    }
+	    if ((r = co_await readable(dl, cancel)) < 0) {
+		co_return r;
+	    }
+	}
+	co_return (ssize_t) (n - nleft);
+    }
+
+    /**
+     * @brief \a n 바이트를 모두 쓰기 (writen() 대응)
+     * @return \a n, 실패 시 -errno
+     */
+    task<ssize_t> write_all(const void *buf, size_t n, deadline dl = never(), cancel_source *cancel = nullptr)
+    {
+	const char *ptr = static_cast<const char *>(buf);
+	size_t nleft = n;
+	ssize_t nwrite;
+	int r;
+
+	while (nleft > 0) {
+	    if ((nwrite = ::write(fd(), ptr, nleft)) >= 0) {
+		nleft -= nwrite;
+		ptr += nwrite;
+		continue;
+	    }
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		co_return -errno;
+	    }
+	    if ((r = co_await writable(dl, cancel)) < 0) {
+		co_return r;
+	    }
+	}
+	co_return (ssize_t) n;
+    }
+
+    /** @brief 리슨 소켓에서 새 연결 받기 */
+    task<socket> accept(deadline dl = never(), cancel_source *cancel = nullptr)
+    {
+	int connfd, r;
+
+	for (;;) {
+	    if ((connfd = accept4(fd(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		co_return socket(loop(), connfd);
+	    }
+	    if (errno == EINTR || errno == ECONNABORTED) {
+		continue;
+	    }
+	    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+		co_return failed(-errno);
+	    }
+	    if ((r = co_await readable(dl, cancel)) < 0) {
+		co_return failed(r);
+	    }
+	}
+    }
+
+private:
+    struct state
+    {
+	event_loop_t *loop;
+	int fd;
+	detail::waiter *rd;
+	detail::waiter *wr;
+    };
+
+    detail::wait_awaiter make_wait(detail::waiter **slot, deadline dl, cancel_source *cancel)
+    {
+	detail::wait_awaiter a;
+
+	a.w.loop = st_->loop;
+	a.w.slot = slot;
+	a.w.cancel = cancel;
+	a.dl = dl;
+	return a;
+    }
+
+    static void on_read(event_loop_t *, int, int events, void *arg)
+    {
+	state *st = static_cast<state *>(arg);
+
+	if (st->rd) {
+	    st->rd->complete(0);
+	}
+	else if ((events & EV_ERROR) && st->wr) {
+	    st->wr->complete(0);
+	}
+    }
+
+    static void on_write(event_loop_t *, int, int, void *arg)
+    {
+	state *st = static_cast<state *>(arg);
+
+	if (st->wr) {
+	    st->wr->complete(0);
+	}
+    }
+
+    std::unique_ptr<state> st_;
+    int err_ = 0;
+};
+
+/**
+ * @brief 리슨 소켓 생성 (socket_listen())
+ */
+inline socket
+listen(event_loop_t *loop, int port)
+{
+    int fd;
+
+    if ((fd = socket_listen(port)) < 0) {
+	return socket::failed(-(errno ? errno : EADDRINUSE));
+    }
+    return socket(loop, fd);
+}
+
+namespace detail {
+
+/**
+ * connect() 의 비동기 이름 해석 (resolv_lookup_async() 결과를 event_defer() 로 루프 쓰레드에 전달)
+ *
+ * deadline 이나 취소로 코루틴이 먼저 재개되면 결과가 올 때까지 남아있다가 on_done() 에서 해제된다.
+ */
+struct resolve_op
+{
+    waiter w;
+    int error = EAI_AGAIN;
+    struct addrinfo *res = nullptr;
+    bool pending = false;		/* 결과를 기다리는 중 (루프 쓰레드에서만 접근) */
+    bool abandoned = false;		/* 코루틴이 더 이상 기다리지 않음 */
+
+    /* 재조회 쓰레드 */
+    static void on_result(int error, struct addrinfo *res, void *arg)
+    {
+	resolve_op *op = static_cast<resolve_op *>(arg);
+
+	op->error = error;
+	op->res = res;
+	/* 실패하면 (메모리 부족) 코루틴은 deadline 이나 취소로만 깨어난다 */
+	(void) event_defer(op->w.loop, on_done, op);
+    }
+
+    /* 루프 쓰레드 */
+    static void on_done(event_loop_t *, void *arg)
+    {
+	resolve_op *op = static_cast<resolve_op *>(arg);
+
+	op->pending = false;
+	if (op->abandoned) {
+	    resolv_free(op->res);
+	    delete op;
+	    return;
+	}
+	op->w.complete(0);
+    }
+};
+
+struct resolve_awaiter
+{
+    resolve_op *op;
+    const char *host;
+    const char *service;
+    deadline dl;
+
+    bool await_ready() { return op->w.ready(dl); }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+	op->pending = true;
+	if (resolv_lookup_async(host, service, resolve_op::on_result, op) < 0) {
+	    op->pending = false;
+	    op->w.result = -(errno ? errno : ENOMEM);
+	    return false;
+	}
+	return op->w.suspend(handle, dl);
+    }
+    int await_resume() { return op->w.result; }
+};
+
+} // namespace detail
+
+/**
+ * @brief TCP 접속 (onvTCPconnectNonBlock() 대응)
+ * @param loop - 이벤트 루프
+ * @param host - 호스트명 또는 IP
+ * @param service - 포트 또는 서비스명
+ * @param dl - 전체 접속 deadline (모든 주소 시도 포함)
+ * @param cancel - 취소 source
+ * @return 접속된 socket, 실패 시 !socket (error() = -errno)
+ *
+ * 캐시에 없는 이름은 재조회 쓰레드에서 조회하며, 그동안 \a dl 과 \a cancel 이 적용된다.
+ */
+inline task<socket>
+connect(event_loop_t *loop, std::string host, std::string service,
+	deadline dl = never(), cancel_source *cancel = nullptr)
+{
+    struct addrinfo *res = nullptr, *ai = nullptr;
+    detail::resolve_op *op = nullptr;
+    socklen_t len;
+    int fd, r, err, last = -ECONNREFUSED;
+
+    if ((err = resolv_lookup_cached(host.c_str(), service.c_str(), &res)) == EAI_AGAIN) {
+	op = new detail::resolve_op;
+	op->w.loop = loop;
+	op->w.cancel = cancel;
+	r = co_await detail::resolve_awaiter{op, host.c_str(), service.c_str(), dl};
+	if (r < 0) {
+	    if (op->pending) {
+		op->abandoned = true;	/* 결과가 오면 on_done() 에서 해제 */
+	    }
+	    else {
+		delete op;
+	    }
+	    co_return socket::failed(r);
+	}
+	err = op->error;
+	res = op->res;
+	delete op;
+    }
+    if (err != 0) {
+	co_return socket::failed(-EHOSTUNREACH);
+    }
+
+    for (ai = res; ai; ai = ai->ai_next) {
+	if ((fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol)) < 0) {
+	    last = -errno;
+	    continue;
+	}
+	if (::connect(fd, ai->ai_addr, ai->ai_addrlen) < 0 && errno != EINPROGRESS) {
+	    last = -errno;
+	    ::close(fd);
+	    continue;
+	}
+
+	socket s(loop, fd);
+	if (!s) {
+	    last = s.error();
+	    continue;
+	}
+	if ((r = co_await s.writable(dl, cancel)) < 0) {
+	    last = r;
+	    break;
+	}
+	err = 0;
+	len = sizeof(err);
+	if (getsockopt(s.fd(), SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+	    err = errno;
+	}
+	if (err == 0) {
+	    resolv_free(res);
+	    co_return s;
+	}
+	last = -err;
+    }
+
+    resolv_free(res);
+    co_return socket::failed(last);
+}
+
+} // namespace onv
+
+#endif
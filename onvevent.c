@@ -0,0 +1,865 @@
+/**
+ * @file onvevent.c
+ * @brief epoll 이벤트 루프(reactor)
+ */
+
+/*
+ * epoll 이벤트 루프(reactor)
+ *
+ * 연결당 쓰레드/프로세스 대신 하나의 쓰레드에서 edge-triggered epoll 로
+ * 다수의 non-blocking 소켓을 처리한다. fd 별 읽기/쓰기 콜백, 타이머,
+ * 지연작업(deferred task)을 제공한다. 타이머는 계층 타이머 휠(onvtimer)로
+ * 관리하므로 수만개 연결의 timeout 도 등록/취소가 O(1) 이다.
+ *
+ * event_defer() 와 event_loop_stop() 은 다른 쓰레드에서 호출해도 된다.
+ * 그 외 함수는 루프를 실행하는 쓰레드에서만 호출해야 한다. 루프 쓰레드에서
+ * 반복 끝에 한번 실행할 작업은 잠금과 할당이 없는 event_tick() 을 쓴다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvtimer.h"
+#include "onvevent.h"
+
+/**
+ * fd 핸들러 구조체 (fd 번호로 인덱싱)
+ */
+typedef struct event_handler_s
+{
+    event_cb rcb;		/**< 읽기 콜백 */
+    event_cb wcb;		/**< 쓰기 콜백 */
+    void *arg;			/**< 콜백 인자 */
+    void *owned;		/**< event_del() 시 free 할 메모리 */
+    int active;			/**< 등록되어 있으면 1 */
+} event_handler_t;
+
+#define TIMER_INDEX_BITS	24	/**< 타이머 ID 중 슬롯 번호 비트 수 */
+#define TIMER_INDEX_MASK	((1L << TIMER_INDEX_BITS) - 1)
+#define TIMER_GEN_MASK		(LONG_MAX >> TIMER_INDEX_BITS)
+
+/**
+ * 타이머 구조체 (ID = 세대 << TIMER_INDEX_BITS | 슬롯 번호)
+ */
+typedef struct event_timer_s
+{
+    wheel_timer_t wt;		/**< 타이머 휠 노드 */
+    event_loop_t *loop;		/**< 소속 루프 */
+    long gen;			/**< 세대 (해제할 때마다 증가, 예전 ID 무효화) */
+    int index;			/**< loop->timers 에서의 위치 */
+    int repeat;			/**< 반복 여부 */
+    event_task_cb cb;		/**< 콜백 */
+    void *arg;			/**< 콜백 인자 */
+    struct event_timer_s *next_free;	/**< 빈 타이머 리스트 */
+} event_timer_t;
+
+/**
+ * 지연작업 리스트 구조체
+ */
+typedef struct event_task_s
+{
+    event_task_cb cb;
+    void *arg;
+    struct event_task_s *next;
+} event_task_t;
+
+/**
+ * 리슨 소켓 컨텍스트
+ */
+typedef struct event_listener_s
+{
+    event_accept_cb cb;
+    void *arg;
+    int has_opt;		/**< opt 가 설정되어 있으면 1 */
+    sockopt_t opt;		/**< 새 연결에 적용할 소켓 옵션 */
+} event_listener_t;
+
+struct event_loop_s
+{
+    int epfd;			/**< epoll descriptor */
+    int wakefd;			/**< 다른 쓰레드에서 깨우기 위한 eventfd */
+    int spare_fd;		/**< EMFILE 시 backlog 를 비우기 위한 예비 fd */
+    volatile int stop;		/**< 종료 요청 */
+
+    event_handler_t *handlers;	/**< fd 별 핸들러 배열 */
+    int nhandlers;		/**< \a handlers 의 크기 */
+
+    wheel_t *wheel;		/**< 타이머 휠 */
+    event_timer_t **timers;	/**< 타이머 슬롯 (ID 로 인덱싱) */
+    int ntimers;		/**< 할당된 타이머 슬롯 수 */
+    int maxtimers;		/**< \a timers 의 크기 */
+    event_timer_t *timer_free;	/**< 빈 타이머 리스트 */
+
+    pthread_mutex_t task_lock;	/**< 지연작업 리스트 잠금 */
+    event_task_t *task_head;	/**< 지연작업 리스트 */
+    event_task_t *task_tail;
+
+    event_tick_t *ticks;	/**< 반복 끝 작업 리스트 (루프 쓰레드 전용) */
+    event_tick_t *tick_run;	/**< 실행중인 반복 끝 작업 리스트 */
+};
+
+static void wakeup(event_loop_t *loop);
+static void timer_fire(wheel_timer_t *wt, void *arg);
+static void timer_release(event_loop_t *loop, event_timer_t *t);
+static void run_tasks(event_loop_t *loop);
+static void run_ticks(event_loop_t *loop);
+static void accept_handler(event_loop_t *loop, int fd, int events, void *arg);
+
+
+/**
+ * @brief epoll_wait() 중인 루프를 깨움
+ * @param loop - 이벤트 루프
+ * @return 없음
+ */
+static void
+wakeup(event_loop_t *loop)
+{
+    uint64_t one = 1;
+
+    (void) write(loop->wakefd, &one, sizeof(one));
+}
+
+
+/**
+ * @brief 이벤트 루프 생성
+ * @param 없음
+ * @return
+ *  성공 시 이벤트 루프 포인터 (사용 후 event_loop_destroy()),\n
+ *  실패 시 NULL
+ */
+event_loop_t *
+event_loop_create(void)
+{
+    event_loop_t *loop = NULL;
+    struct epoll_event ev;
+
+    if ((loop = calloc(1, sizeof(event_loop_t))) == NULL) {
+	return NULL;
+    }
+    loop->epfd = -1;
+    loop->wakefd = -1;
+    loop->spare_fd = -1;
+    loop->stop = 0;
+    pthread_mutex_init(&loop->task_lock, NULL);
+
+    if ((loop->wheel = wheel_create(WHEEL_TICK)) == NULL ||
+	    (loop->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+	    (loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+	Log(ERROR, "event loop create failed: %s", strerror(errno));
+	event_loop_destroy(loop);
+	return NULL;
+    }
+    if ((loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC)) < 0) {
+	Log(WARN, "event loop: spare fd open failed: %s", strerror(errno));
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->wakefd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev) < 0) {
+	event_loop_destroy(loop);
+	return NULL;
+    }
+
+    return loop;
+}
+
+
+/**
+ * @brief 이벤트 루프 제거
+ * @param loop - 이벤트 루프
+ * @return 없음
+ *
+ * 등록된 fd 는 close 하지 않는다.
+ */
+void
+event_loop_destroy(event_loop_t *loop)
+{
+    event_task_t *task = NULL;
+    int i;
+
+    if (!loop) {
+	return;
+    }
+
+    for (i = 0; i < loop->nhandlers; i++) {
+	free(loop->handlers[i].owned);
+    }
+    while ((task = loop->task_head) != NULL) {
+	loop->task_head = task->next;
+	free(task);
+    }
+
+    if (loop->wakefd >= 0) {
+	close(loop->wakefd);
+    }
+    if (loop->spare_fd >= 0) {
+	close(loop->spare_fd);
+    }
+    if (loop->epfd >= 0) {
+	close(loop->epfd);
+    }
+    pthread_mutex_destroy(&loop->task_lock);
+    wheel_destroy(loop->wheel);
+    for (i = 0; i < loop->ntimers; i++) {
+	free(loop->timers[i]);
+    }
+    free(loop->handlers);
+    free(loop->timers);
+    free(loop);
+}
+
+
+/**
+ * @brief fd 를 이벤트 루프에 등록
+ * @param loop - 이벤트 루프
+ * @param fd - 등록할 descriptor (non-blocking 으로 설정됨)
+ * @param rcb - 읽기 가능 콜백 (NULL 가능)
+ * @param wcb - 쓰기 가능 콜백 (NULL 가능)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * edge-triggered 로 읽기/쓰기를 모두 등록하므로 쓰기 대기를 위해 다시
+ * 등록할 필요가 없다. EAGAIN 이 난 뒤 소켓이 쓰기 가능해지면 wcb 가 호출된다.
+ * 에러나 연결 종료는 rcb 에 EV_ERROR 로 전달된다.
+ */
+int
+event_add(event_loop_t *loop, int fd, event_cb rcb, event_cb wcb, void *arg)
+{
+    event_handler_t *tmp = NULL;
+    struct epoll_event ev;
+    int n;
+
+    ASSERT(loop != NULL);
+
+    if (fd < 0) {
+	errno = EBADF;
+	return -1;
+    }
+
+    if (fd >= loop->nhandlers) {
+	n = loop->nhandlers ? loop->nhandlers : 64;
+	while (n <= fd) {
+	    n *= 2;
+	}
+	if ((tmp = realloc(loop->handlers, sizeof(event_handler_t) * n)) == NULL) {
+	    return -1;
+	}
+	memset(tmp + loop->nhandlers, 0, sizeof(event_handler_t) * (n - loop->nhandlers));
+	loop->handlers = tmp;
+	loop->nhandlers = n;
+    }
+
+    if (loop->handlers[fd].active) {
+	errno = EEXIST;
+	return -1;
+    }
+    if (set_nonblock(fd) < 0) {
+	return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	return -1;
+    }
+
+    loop->handlers[fd].rcb = rcb;
+    loop->handlers[fd].wcb = wcb;
+    loop->handlers[fd].arg = arg;
+    loop->handlers[fd].owned = NULL;
+    loop->handlers[fd].active = 1;
+
+    return 0;
+}
+
+
+/**
+ * @brief fd 를 이벤트 루프에서 제거
+ * @param loop - 이벤트 루프
+ * @param fd - 제거할 descriptor
+ * @return
+ *  성공 시 0,\n
+ *  등록되지 않은 fd 이면 -1
+ *
+ * fd 를 close 하기 전에 호출해야 한다. 콜백 안에서 호출해도 된다.
+ */
+int
+event_del(event_loop_t *loop, int fd)
+{
+    ASSERT(loop != NULL);
+
+    if (fd < 0 || fd >= loop->nhandlers || !loop->handlers[fd].active) {
+	errno = ENOENT;
+	return -1;
+    }
+
+    (void) epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+    FREE(loop->handlers[fd].owned);
+    memset(&loop->handlers[fd], 0, sizeof(event_handler_t));
+
+    return 0;
+}
+
+
+/**
+ * @brief 리슨 소켓의 읽기 콜백 - backlog 를 모두 accept
+ *
+ * accept_batch() 로 ACCEPT_BATCH_MAX 개씩 받아 연결마다 콜백을 호출한다.
+ * edge-triggered 이므로 EAGAIN 까지 비워야 한다. fd 가 모자라면 (EMFILE,
+ * ENFILE) 예비 fd 를 잠시 닫고 대기중인 연결을 받아 바로 닫는다. 그냥
+ * 돌아가면 backlog 에 남은 연결 때문에 다시 깨어나지 않는다.
+ */
+static void
+accept_handler(event_loop_t *loop, int fd, int events, void *arg)
+{
+    event_listener_t *listener = arg;
+    accept_conn_t conns[ACCEPT_BATCH_MAX];
+    int i, n, err, connfd;
+
+    (void) events;
+
+    for (;;) {
+	n = accept_batch(fd, conns, ACCEPT_BATCH_MAX,
+		listener->has_opt ? &listener->opt : NULL);
+	if (n == 0) {
+	    break;	/* backlog 가 비었음 */
+	}
+	if (n < 0) {
+	    err = errno;
+	    if ((err == EMFILE || err == ENFILE) && loop->spare_fd >= 0) {
+		close(loop->spare_fd);
+		if ((connfd = accept(fd, NULL, NULL)) >= 0) {
+		    close(connfd);
+		}
+		else {
+		    err = errno;
+		}
+		loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		if (connfd >= 0) {
+		    Log(WARN, "accept4() failed: %s, connection dropped", strerror(err));
+		    continue;
+		}
+		if (err == EAGAIN || err == EWOULDBLOCK) {
+		    return;
+		}
+	    }
+	    Log(ERROR, "accept4() failed: %s", strerror(err));
+	    return;
+	}
+
+	for (i = 0; i < n; i++) {
+	    listener->cb(loop, conns[i].fd, (struct sockaddr *) &conns[i].addr,
+		    conns[i].addrlen, listener->arg);
+
+	    /* 콜백에서 리슨 소켓이 제거되었으면 listener 도 해제된 상태 */
+	    if (!loop->handlers[fd].active) {
+		while (++i < n) {
+		    close(conns[i].fd);
+		}
+		return;
+	    }
+	}
+
+	/*
+	 * n > 0 이면 errno 는 이번 호출의 결과가 아니다 (이전 호출이나 콜백에서
+	 * 남은 값). EAGAIN 으로 끝났는지 에러로 (EMFILE 등) 끝났는지는 다시
+	 * 호출해서 0 또는 -1 로 판단한다.
+	 */
+    }
+}
+
+
+/**
+ * @brief 리슨 소켓 등록
+ * @param loop - 이벤트 루프
+ * @param listenfd - socket_listen() 등으로 생성한 리슨 소켓
+ * @param cb - 새 연결 콜백
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 리슨 소켓이 읽기 가능해지면 backlog 가 빌 때까지 accept 하여 non-blocking
+ * 으로 설정된 연결마다 \a cb 를 호출한다.
+ */
+int
+event_listen(event_loop_t *loop, int listenfd, event_accept_cb cb, void *arg)
+{
+    return event_listen_sockopt(loop, listenfd, NULL, cb, arg);
+}
+
+
+/**
+ * @brief 소켓 옵션을 지정하여 리슨 소켓 등록
+ * @param loop - 이벤트 루프
+ * @param listenfd - socket_listen() 등으로 생성한 리슨 소켓
+ * @param opt - 새 연결마다 적용할 소켓 옵션 (NULL 가능, 복사하여 보관)
+ * @param cb - 새 연결 콜백
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+event_listen_sockopt(event_loop_t *loop, int listenfd, const sockopt_t *opt,
+	event_accept_cb cb, void *arg)
+{
+    event_listener_t *listener = NULL;
+
+    ASSERT(loop != NULL && cb != NULL);
+
+    if ((listener = calloc(1, sizeof(event_listener_t))) == NULL) {
+	return -1;
+    }
+    listener->cb = cb;
+    listener->arg = arg;
+    if (opt) {
+	listener->opt = *opt;
+	listener->has_opt = 1;
+    }
+
+    if (event_add(loop, listenfd, accept_handler, NULL, listener) < 0) {
+	free(listener);
+	return -1;
+    }
+    loop->handlers[listenfd].owned = listener;
+
+    return 0;
+}
+
+
+/**
+ * @brief 타이머 등록
+ * @param loop - 이벤트 루프
+ * @param msec - 만료시간(밀리초)
+ * @param repeat - 0 이 아니면 \a msec 주기로 반복
+ * @param cb - 콜백
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 타이머 ID (> 0),\n
+ *  실패 시 -1
+ */
+long
+event_timer_add(event_loop_t *loop, int msec, int repeat, event_task_cb cb, void *arg)
+{
+    event_timer_t **tmp = NULL;
+    event_timer_t *t = NULL;
+    int n;
+
+    ASSERT(loop != NULL && cb != NULL);
+
+    if ((t = loop->timer_free) != NULL) {
+	loop->timer_free = t->next_free;
+    }
+    else {
+	if (loop->ntimers > TIMER_INDEX_MASK) {
+	    errno = ENOSPC;
+	    return -1;
+	}
+	if (loop->ntimers == loop->maxtimers) {
+	    n = loop->maxtimers ? loop->maxtimers * 2 : 64;
+	    if ((tmp = realloc(loop->timers, sizeof(event_timer_t *) * n)) == NULL) {
+		return -1;
+	    }
+	    loop->timers = tmp;
+	    loop->maxtimers = n;
+	}
+	if ((t = calloc(1, sizeof(event_timer_t))) == NULL) {
+	    return -1;
+	}
+	t->loop = loop;
+	t->gen = 1;
+	t->index = loop->ntimers;
+	loop->timers[loop->ntimers++] = t;
+    }
+
+    t->repeat = repeat;
+    t->cb = cb;
+    t->arg = arg;
+    t->next_free = NULL;
+    wheel_timer_init(&t->wt, timer_fire, t);
+    (void) wheel_timer_add(loop->wheel, &t->wt, msec, repeat);
+
+    return (t->gen << TIMER_INDEX_BITS) | t->index;
+}
+
+
+/**
+ * @brief 타이머 취소
+ * @param loop - 이벤트 루프
+ * @param id - event_timer_add() 가 반환한 타이머 ID
+ * @return
+ *  성공 시 0,\n
+ *  없는 타이머이면 -1
+ */
+int
+event_timer_del(event_loop_t *loop, long id)
+{
+    event_timer_t *t = NULL;
+    long index;
+
+    ASSERT(loop != NULL);
+
+    index = id & TIMER_INDEX_MASK;
+    if (id <= 0 || index >= loop->ntimers) {
+	return -1;
+    }
+    t = loop->timers[index];
+    if (t->gen != (id >> TIMER_INDEX_BITS) || !wheel_timer_pending(&t->wt)) {
+	return -1;
+    }
+
+    wheel_timer_del(loop->wheel, &t->wt);
+    timer_release(loop, t);
+
+    return 0;
+}
+
+
+/**
+ * @brief 이벤트 루프의 타이머 휠
+ * @param loop - 이벤트 루프
+ * @return 타이머 휠
+ *
+ * 연결마다 idle timeout 을 두는 경우 등에는 wheel_timer_t 를 연결 구조체에
+ * 넣고 이 휠에 직접 등록하면 ID 관리와 메모리 할당 없이 재등록할 수 있다.
+ * 콜백은 루프 쓰레드에서 event_timer_add() 타이머와 함께 실행된다.
+ */
+wheel_t *
+event_loop_wheel(event_loop_t *loop)
+{
+    ASSERT(loop != NULL);
+
+    return loop->wheel;
+}
+
+
+/**
+ * @brief 타이머 휠 만료 콜백 (event_timer_add() 타이머)
+ */
+static void
+timer_fire(wheel_timer_t *wt, void *arg)
+{
+    event_timer_t *t = arg;
+    event_loop_t *loop = t->loop;
+    event_task_cb cb = t->cb;
+    void *cb_arg = t->arg;
+
+    (void) wt;
+
+    /* 1회 타이머는 콜백 전에 해제 (콜백에서의 event_timer_del() 은 -1) */
+    if (!t->repeat) {
+	timer_release(loop, t);
+    }
+    cb(loop, cb_arg);
+}
+
+
+/**
+ * @brief 타이머를 빈 리스트로 돌려보냄 (예전 ID 는 무효가 됨)
+ */
+static void
+timer_release(event_loop_t *loop, event_timer_t *t)
+{
+    t->gen = (t->gen + 1) & TIMER_GEN_MASK;
+    if (t->gen == 0) {
+	t->gen = 1;
+    }
+    t->next_free = loop->timer_free;
+    loop->timer_free = t;
+}
+
+
+/**
+ * @brief 지연작업 등록
+ * @param loop - 이벤트 루프
+ * @param cb - 콜백
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 현재 이벤트 처리가 끝난 뒤 루프 쓰레드에서 \a cb 를 실행한다.
+ * 다른 쓰레드에서 작업을 넘길 때도 사용한다.
+ */
+int
+event_defer(event_loop_t *loop, event_task_cb cb, void *arg)
+{
+    event_task_t *task = NULL;
+
+    ASSERT(loop != NULL && cb != NULL);
+
+    if ((task = malloc(sizeof(event_task_t))) == NULL) {
+	return -1;
+    }
+    task->cb = cb;
+    task->arg = arg;
+    task->next = NULL;
+
+    pthread_mutex_lock(&loop->task_lock);
+    if (loop->task_tail) {
+	loop->task_tail->next = task;
+    }
+    else {
+	loop->task_head = task;
+    }
+    loop->task_tail = task;
+    pthread_mutex_unlock(&loop->task_lock);
+
+    wakeup(loop);
+
+    return 0;
+}
+
+
+/**
+ * @brief 반복 끝 작업 노드 초기화
+ * @param t - 노드
+ * @param cb - 콜백
+ * @param arg - 콜백 인자
+ * @return 없음
+ */
+void
+event_tick_init(event_tick_t *t, event_task_cb cb, void *arg)
+{
+    ASSERT(t != NULL && cb != NULL);
+
+    memset(t, 0, sizeof(event_tick_t));
+    t->cb = cb;
+    t->arg = arg;
+}
+
+
+/**
+ * @brief 현재 반복이 끝날 때 (다음 epoll_wait() 전) 콜백 예약
+ * @param loop - 이벤트 루프
+ * @param t - event_tick_init() 으로 초기화한 노드
+ * @return 없음
+ *
+ * 루프 쓰레드에서만 호출한다. event_defer() 와 달리 할당, 잠금, eventfd
+ * 깨우기가 없다. 이미 예약되어 있으면 아무것도 하지 않는다. 노드를 해제하기
+ * 전에 event_tick_cancel() 해야 한다.
+ */
+void
+event_tick(event_loop_t *loop, event_tick_t *t)
+{
+    ASSERT(loop != NULL && t != NULL);
+
+    if (t->queued) {
+	return;
+    }
+    t->queued = 1;
+    t->prev = NULL;
+    t->next = loop->ticks;
+    if (loop->ticks) {
+	loop->ticks->prev = t;
+    }
+    loop->ticks = t;
+}
+
+
+/**
+ * @brief 예약된 반복 끝 작업 취소
+ * @param loop - 이벤트 루프
+ * @param t - 노드 (예약되어 있지 않으면 아무것도 하지 않음)
+ * @return 없음
+ */
+void
+event_tick_cancel(event_loop_t *loop, event_tick_t *t)
+{
+    ASSERT(loop != NULL && t != NULL);
+
+    if (!t->queued) {
+	return;
+    }
+    if (t->prev) {
+	t->prev->next = t->next;
+    }
+    else if (loop->ticks == t) {
+	loop->ticks = t->next;
+    }
+    else {
+	loop->tick_run = t->next;
+    }
+    if (t->next) {
+	t->next->prev = t->prev;
+    }
+    t->queued = 0;
+    t->prev = t->next = NULL;
+}
+
+
+/**
+ * @brief 예약된 반복 끝 작업 실행
+ * @param loop - 이벤트 루프
+ * @return 없음
+ *
+ * 실행중에 새로 예약된 작업은 다음 반복에서 실행한다.
+ */
+static void
+run_ticks(event_loop_t *loop)
+{
+    event_tick_t *t = NULL;
+
+    loop->tick_run = loop->ticks;
+    loop->ticks = NULL;
+    while ((t = loop->tick_run) != NULL) {
+	loop->tick_run = t->next;
+	if (t->next) {
+	    t->next->prev = NULL;
+	}
+	t->queued = 0;
+	t->prev = t->next = NULL;
+	t->cb(loop, t->arg);
+    }
+}
+
+
+/**
+ * @brief 등록된 지연작업 실행
+ * @param loop - 이벤트 루프
+ * @return 없음
+ *
+ * 실행중에 새로 등록된 작업은 다음 반복에서 실행한다.
+ */
+static void
+run_tasks(event_loop_t *loop)
+{
+    event_task_t *task = NULL, *next = NULL;
+
+    pthread_mutex_lock(&loop->task_lock);
+    task = loop->task_head;
+    loop->task_head = loop->task_tail = NULL;
+    pthread_mutex_unlock(&loop->task_lock);
+
+    for (; task; task = next) {
+	next = task->next;
+	task->cb(loop, task->arg);
+	free(task);
+    }
+}
+
+
+/**
+ * @brief 이벤트 루프 실행
+ * @param loop - 이벤트 루프
+ * @return
+ *  event_loop_stop() 으로 종료 시 0,\n
+ *  epoll_wait() 실패 시 -1
+ */
+int
+event_loop_run(event_loop_t *loop)
+{
+    struct epoll_event events[EVENT_MAX_EVENTS];
+    event_handler_t *h = NULL;
+    uint64_t count;
+    long next;
+    int i, n, fd, ev, timeout, tasks;
+
+    ASSERT(loop != NULL);
+
+    /* 실행 전에 요청된 event_loop_stop() 도 지켜야 하므로 여기서 지우지 않음 */
+    while (!loop->stop) {
+	pthread_mutex_lock(&loop->task_lock);
+	tasks = loop->task_head != NULL;
+	pthread_mutex_unlock(&loop->task_lock);
+
+	if (tasks || loop->ticks) {
+	    timeout = 0;
+	}
+	else {
+	    next = wheel_next(loop->wheel);
+	    timeout = next > INT_MAX ? INT_MAX : (int) next;
+	}
+
+	if ((n = epoll_wait(loop->epfd, events, EVENT_MAX_EVENTS, timeout)) < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    Log(ERROR, "epoll_wait() failed: %s", strerror(errno));
+	    return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+	    fd = events[i].data.fd;
+	    if (fd == loop->wakefd) {
+		(void) read(loop->wakefd, &count, sizeof(count));
+		continue;
+	    }
+
+	    ev = 0;
+	    if (events[i].events & (EPOLLIN | EPOLLPRI)) {
+		ev |= EV_READ;
+	    }
+	    if (events[i].events & EPOLLOUT) {
+		ev |= EV_WRITE;
+	    }
+	    if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+		ev |= EV_ERROR;
+	    }
+
+	    /* 앞선 콜백에서 제거된 fd 는 건너뜀 */
+	    if (fd >= loop->nhandlers || !loop->handlers[fd].active) {
+		continue;
+	    }
+	    h = &loop->handlers[fd];
+	    if ((ev & (EV_READ | EV_ERROR)) && h->rcb) {
+		h->rcb(loop, fd, ev, h->arg);
+	    }
+	    /* rcb 에서 제거되었거나 handlers 가 재할당되었을 수 있음 */
+	    if (fd < loop->nhandlers && loop->handlers[fd].active &&
+		    (ev & EV_WRITE) && loop->handlers[fd].wcb) {
+		h = &loop->handlers[fd];
+		h->wcb(loop, fd, ev, h->arg);
+	    }
+	}
+
+	wheel_run(loop->wheel);
+	run_tasks(loop);
+	run_ticks(loop);
+    }
+    loop->stop = 0;
+
+    return 0;
+}
+
+
+/**
+ * @brief 이벤트 루프 종료 요청
+ * @param loop - 이벤트 루프
+ * @return 없음
+ *
+ * 다른 쓰레드나 콜백 안에서 호출해도 된다. 현재 반복이 끝나면
+ * event_loop_run() 이 반환한다.
+ */
+void
+event_loop_stop(event_loop_t *loop)
+{
+    ASSERT(loop != NULL);
+
+    loop->stop = 1;
+    wakeup(loop);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file onvevent.h
+ * @brief epoll 이벤트 루프(reactor) 헤더
+ */
+
+/*
+ * epoll 이벤트 루프(reactor) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_EVENT_H
+#define ONV_EVENT_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/socket.h>
+#include "onvsockopt.h"
+#include "onvtimer.h"
+
+#define EV_READ		0x01	/**< 읽기 가능 */
+#define EV_WRITE	0x02	/**< 쓰기 가능 */
+#define EV_ERROR	0x04	/**< 에러 또는 상대방 연결 종료 */
+
+#define EVENT_MAX_EVENTS	256	/**< epoll_wait() 한번에 처리할 최대 이벤트 수 */
+
+typedef struct event_loop_s event_loop_t;
+
+/**
+ * fd 이벤트 콜백
+ * edge-triggered 이므로 EAGAIN 이 날때까지 읽고 써야 한다.
+ */
+typedef void (*event_cb)(event_loop_t *loop, int fd, int events, void *arg);
+
+/**
+ * 타이머 및 지연작업 콜백
+ */
+typedef void (*event_task_cb)(event_loop_t *loop, void *arg);
+
+/**
+ * 반복 끝 작업 노드 (호출자 구조체에 포함해서 사용, event_tick() 참고)
+ */
+typedef struct event_tick_s
+{
+    event_task_cb cb;		/**< 콜백 */
+    void *arg;			/**< 콜백 인자 */
+    int queued;			/**< 예약되어 있으면 1 */
+    struct event_tick_s *prev;
+    struct event_tick_s *next;
+} event_tick_t;
+
+/**
+ * 새 연결 콜백 (connfd 는 non-blocking 으로 설정되어 있음)
+ */
+typedef void (*event_accept_cb)(event_loop_t *loop, int connfd,
+	struct sockaddr *sa, socklen_t salen, void *arg);
+
+event_loop_t *event_loop_create(void);
+void event_loop_destroy(event_loop_t *loop);
+int event_loop_run(event_loop_t *loop);
+void event_loop_stop(event_loop_t *loop);
+
+int event_add(event_loop_t *loop, int fd, event_cb rcb, event_cb wcb, void *arg);
+int event_del(event_loop_t *loop, int fd);
+int event_listen(event_loop_t *loop, int listenfd, event_accept_cb cb, void *arg);
+int event_listen_sockopt(event_loop_t *loop, int listenfd, const sockopt_t *opt,
+	event_accept_cb cb, void *arg);
+
+long event_timer_add(event_loop_t *loop, int msec, int repeat, event_task_cb cb, void *arg);
+int event_timer_del(event_loop_t *loop, long id);
+int event_defer(event_loop_t *loop, event_task_cb cb, void *arg);
+void event_tick_init(event_tick_t *t, event_task_cb cb, void *arg);
+void event_tick(event_loop_t *loop, event_tick_t *t);
+void event_tick_cancel(event_loop_t *loop, event_tick_t *t);
+wheel_t *event_loop_wheel(event_loop_t *loop);
+
+#endif
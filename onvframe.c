@@ -0,0 +1,380 @@
+/**
+ * @file onvframe.c
+ * @brief 길이 prefix 메시지 framing (zero-copy encode/decode)
+ */
+
+/*
+ * 길이 prefix 메시지 framing (zero-copy encode/decode)
+ *
+ * 서비스마다 readn()/writen() 위에 따로 만들던 헤더 형식을 하나로 모은다.
+ * 헤더는 magic, version, length, type, seq 필드로 되어 있고 필드마다 크기
+ * (없음/1/2/4 바이트)와 byte order 를 frame_fmt_t 로 정한다.
+ *
+ *  - 디코딩: frame_decode() 는 받은 버퍼에서, frame_read() 는 onvbufread
+ *    리더에서 완성된 frame 을 찾아 본문을 복사 없이 버퍼 안의 위치로
+ *    돌려준다. length 가 max_len 을 넘으면 본문을 기다리지 않고 헤더만
+ *    보고 EMSGSIZE 로 거부하므로 상대가 메모리를 잡아둘 수 없다.
+ *  - 인코딩: 본문 앞에 frame_hdr_size() 만큼 headroom 을 비워두고
+ *    frame_encode() 하면 그 자리에 헤더를 쓴다. 본문은 옮기지 않으므로
+ *    wbuf/wqueue 로 그대로 보낼 수 있다. frame_send() 는 헤더와 본문을
+ *    writev 한번으로 보낸다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvbufread.h"
+#include "onvframe.h"
+
+static int field_valid(int size);
+static int fmt_valid(const frame_fmt_t *fmt);
+static uint32_t get_field(const unsigned char *p, int size, int order);
+static void put_field(unsigned char *p, int size, int order, uint32_t v);
+static int parse_hdr(const frame_fmt_t *fmt, const char *hdr, frame_t *f);
+
+
+static int
+field_valid(int size)
+{
+    return size == 0 || size == 1 || size == 2 || size == 4;
+}
+
+
+/**
+ * @brief 필드 크기 검사 (헤더는 FRAME_HDR_MAX 를 넘지 않음)
+ */
+static int
+fmt_valid(const frame_fmt_t *fmt)
+{
+    return field_valid(fmt->magic_size) && field_valid(fmt->version_size) &&
+	field_valid(fmt->length_size) && fmt->length_size != 0 &&
+	field_valid(fmt->type_size) && field_valid(fmt->seq_size);
+}
+
+
+static uint32_t
+get_field(const unsigned char *p, int size, int order)
+{
+    uint32_t v = 0;
+    int i;
+
+    for (i = 0; i < size; i++) {
+	if (order == FRAME_LE) {
+	    v |= (uint32_t) p[i] << (8 * i);
+	}
+	else {
+	    v = (v << 8) | p[i];
+	}
+    }
+
+    return v;
+}
+
+
+static void
+put_field(unsigned char *p, int size, int order, uint32_t v)
+{
+    int i;
+
+    for (i = 0; i < size; i++) {
+	if (order == FRAME_LE) {
+	    p[i] = (unsigned char) (v >> (8 * i));
+	}
+	else {
+	    p[size - 1 - i] = (unsigned char) (v >> (8 * i));
+	}
+    }
+}
+
+
+/**
+ * @brief 기본 헤더 형식으로 초기화
+ * @param fmt - 헤더 형식
+ * @return 없음
+ *
+ * magic 2, version 1, length 4, type 2, seq 4 바이트 (13 바이트, big-endian).
+ * 필요한 필드만 바꿔서 쓴다.
+ */
+void
+frame_fmt_init(frame_fmt_t *fmt)
+{
+    ASSERT(fmt != NULL);
+
+    memset(fmt, 0, sizeof(frame_fmt_t));
+    fmt->order = FRAME_BE;
+    fmt->magic_size = 2;
+    fmt->version_size = 1;
+    fmt->length_size = 4;
+    fmt->type_size = 2;
+    fmt->seq_size = 4;
+    fmt->magic = FRAME_MAGIC;
+    fmt->version = FRAME_VERSION;
+    fmt->max_len = FRAME_MAX_LEN;
+}
+
+
+/**
+ * @brief 헤더 크기 (encode 시 비워둘 headroom)
+ */
+size_t
+frame_hdr_size(const frame_fmt_t *fmt)
+{
+    ASSERT(fmt_valid(fmt));
+
+    return (size_t) (fmt->magic_size + fmt->version_size + fmt->length_size +
+	    fmt->type_size + fmt->seq_size);
+}
+
+
+/**
+ * @brief 헤더 해석 및 검사
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (EPROTO: magic/version 불일치, EMSGSIZE: 최대 길이 초과)
+ */
+static int
+parse_hdr(const frame_fmt_t *fmt, const char *hdr, frame_t *f)
+{
+    const unsigned char *p = (const unsigned char *) hdr;
+    uint32_t magic;
+
+    if (fmt->magic_size) {
+	magic = get_field(p, fmt->magic_size, fmt->order);
+	p += fmt->magic_size;
+	if (magic != fmt->magic) {
+	    errno = EPROTO;
+	    return -1;
+	}
+    }
+
+    f->version = 0;
+    if (fmt->version_size) {
+	f->version = get_field(p, fmt->version_size, fmt->order);
+	p += fmt->version_size;
+	if (f->version > fmt->version) {
+	    errno = EPROTO;
+	    return -1;
+	}
+    }
+
+    f->len = get_field(p, fmt->length_size, fmt->order);
+    p += fmt->length_size;
+    if (f->len > fmt->max_len) {
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    f->type = get_field(p, fmt->type_size, fmt->order);
+    p += fmt->type_size;
+    f->seq = get_field(p, fmt->seq_size, fmt->order);
+    f->data = NULL;
+
+    return 0;
+}
+
+
+/**
+ * @brief 버퍼에서 frame 하나를 디코딩 (zero-copy)
+ * @param fmt - 헤더 형식
+ * @param buf - 받은 데이터
+ * @param len - \a buf 의 길이
+ * @param f - (OUT) frame (f->data 는 \a buf 안을 가리킴)
+ * @return
+ *  완성된 frame 이 있으면 frame 전체 크기 (헤더 포함, 소비할 바이트수),\n
+ *  데이터가 모자라면 0,\n
+ *  잘못된 헤더이면 -1 (EPROTO, EMSGSIZE, 헤더 형식이 잘못되면 EINVAL)
+ *
+ * 헤더만 도착해도 길이를 검사하므로 너무 큰 frame 은 본문을 받기 전에
+ * 거부된다.
+ */
+ssize_t
+frame_decode(const frame_fmt_t *fmt, const char *buf, size_t len, frame_t *f)
+{
+    size_t hlen;
+
+    ASSERT(buf != NULL || len == 0);
+    ASSERT(f != NULL);
+
+    if (!fmt_valid(fmt)) {
+	errno = EINVAL;
+	return -1;
+    }
+    hlen = frame_hdr_size(fmt);
+    if (len < hlen) {
+	return 0;
+    }
+    if (parse_hdr(fmt, buf, f) < 0) {
+	return -1;
+    }
+    if (len - hlen < f->len) {
+	return 0;
+    }
+    f->data = buf + hlen;
+
+    return (ssize_t) (hlen + f->len);
+}
+
+
+/**
+ * @brief 버퍼링 리더에서 다음 frame 을 읽음 (zero-copy)
+ * @param br - 리더
+ * @param fmt - 헤더 형식
+ * @param f - (OUT) frame (f->data 는 다음 bufread_*() 호출 전까지 유효)
+ * @return
+ *  성공 시 0 (frame 은 소비됨),\n
+ *  실패 시 -1 (errno = EAGAIN 이면 아무것도 소비하지 않음, EPROTO,
+ *  EMSGSIZE, EINVAL, ECONNRESET 등)
+ *
+ * 헤더와 본문 합이 bufread_size() 보다 커도 EMSGSIZE 이다.
+ */
+int
+frame_read(bufread_t *br, const frame_fmt_t *fmt, frame_t *f)
+{
+    const char *p = NULL;
+    size_t hlen;
+
+    ASSERT(br != NULL && f != NULL);
+
+    if (!fmt_valid(fmt)) {
+	errno = EINVAL;
+	return -1;
+    }
+    hlen = frame_hdr_size(fmt);
+    if ((p = bufread_peek(br, hlen)) == NULL) {
+	return -1;
+    }
+    if (parse_hdr(fmt, p, f) < 0) {
+	return -1;
+    }
+    if ((p = bufread_peek(br, hlen + f->len)) == NULL) {
+	return -1;
+    }
+    bufread_consume(br, hlen + f->len);
+    f->data = p + hlen;
+
+    return 0;
+}
+
+
+/**
+ * @brief 헤더 쓰기
+ * @param fmt - 헤더 형식
+ * @param hdr - (OUT) 헤더를 쓸 위치 (frame_hdr_size() 바이트)
+ * @param len - 본문 길이
+ * @param type - 메시지 종류
+ * @param seq - 순서 번호
+ * @return
+ *  성공 시 헤더 크기,\n
+ *  본문이 max_len 또는 length 필드 범위를 넘으면 0 (EMSGSIZE),\n
+ *  필드 크기가 잘못되었으면 0 (EINVAL)
+ *
+ * 필드는 0, 1, 2, 4 바이트만 허용하므로 헤더는 FRAME_HDR_MAX 이하이다.
+ */
+size_t
+frame_put_hdr(const frame_fmt_t *fmt, char *hdr, size_t len, uint32_t type, uint32_t seq)
+{
+    unsigned char *p = (unsigned char *) hdr;
+
+    ASSERT(hdr != NULL);
+
+    if (!fmt_valid(fmt)) {
+	errno = EINVAL;
+	return 0;
+    }
+    if (len > fmt->max_len ||
+	    (fmt->length_size < 4 && len >= ((size_t) 1 << (8 * fmt->length_size)))) {
+	errno = EMSGSIZE;
+	return 0;
+    }
+
+    put_field(p, fmt->magic_size, fmt->order, fmt->magic);
+    p += fmt->magic_size;
+    put_field(p, fmt->version_size, fmt->order, fmt->version);
+    p += fmt->version_size;
+    put_field(p, fmt->length_size, fmt->order, (uint32_t) len);
+    p += fmt->length_size;
+    put_field(p, fmt->type_size, fmt->order, type);
+    p += fmt->type_size;
+    put_field(p, fmt->seq_size, fmt->order, seq);
+
+    return frame_hdr_size(fmt);
+}
+
+
+/**
+ * @brief 본문 앞 headroom 에 헤더를 써서 frame 완성 (본문 복사 없음)
+ * @param fmt - 헤더 형식
+ * @param payload - 본문 (앞에 frame_hdr_size() 바이트의 여유가 있어야 함)
+ * @param len - 본문 길이
+ * @param type - 메시지 종류
+ * @param seq - 순서 번호
+ * @return
+ *  성공 시 frame 시작 위치 (payload - frame_hdr_size()),\n
+ *  실패 시 NULL (EMSGSIZE, EINVAL)
+ */
+char *
+frame_encode(const frame_fmt_t *fmt, char *payload, size_t len, uint32_t type, uint32_t seq)
+{
+    char *hdr = NULL;
+
+    ASSERT(payload != NULL);
+
+    if (!fmt_valid(fmt)) {
+	errno = EINVAL;
+	return NULL;
+    }
+    hdr = payload - frame_hdr_size(fmt);
+    if (frame_put_hdr(fmt, hdr, len, type, seq) == 0) {
+	return NULL;
+    }
+
+    return hdr;
+}
+
+
+/**
+ * @brief frame 전송 (헤더와 본문을 writev 한번으로)
+ * @param fd - 연결된 socket descriptor
+ * @param fmt - 헤더 형식
+ * @param type - 메시지 종류
+ * @param seq - 순서 번호
+ * @param payload - 본문
+ * @param len - 본문 길이
+ * @return
+ *  성공 시 보낸 바이트수 (헤더 포함),\n
+ *  실패 시 -1
+ */
+ssize_t
+frame_send(int fd, const frame_fmt_t *fmt, uint32_t type, uint32_t seq, const void *payload, size_t len)
+{
+    char hdr[FRAME_HDR_MAX];
+    struct iovec iov[2];
+    size_t hlen;
+
+    ASSERT(payload != NULL || len == 0);
+
+    if ((hlen = frame_put_hdr(fmt, hdr, len, type, seq)) == 0) {
+	return -1;
+    }
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = hlen;
+    iov[1].iov_base = (void *) payload;
+    iov[1].iov_len = len;
+
+    return writenv(fd, iov, len ? 2 : 1);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file onvframe.h
+ * @brief 길이 prefix 메시지 framing (zero-copy encode/decode) 헤더
+ */
+
+/*
+ * 길이 prefix 메시지 framing (zero-copy encode/decode) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_FRAME_H
+#define ONV_FRAME_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "onvbufread.h"
+
+#define FRAME_BE	0		/**< 헤더 필드 big-endian (network order) */
+#define FRAME_LE	1		/**< 헤더 필드 little-endian */
+
+#define FRAME_MAGIC	0x4f4e		/**< 기본 magic ("ON") */
+#define FRAME_VERSION	1		/**< 기본 version */
+#define FRAME_MAX_LEN	(1024 * 1024)	/**< 기본 최대 본문 길이 */
+#define FRAME_HDR_MAX	20		/**< 헤더 최대 크기 (필드 5개 * 4 바이트) */
+
+/**
+ * 헤더 형식 (필드 순서: magic, version, length, type, seq)
+ *
+ * 각 필드의 크기는 0(없음), 1, 2, 4 바이트이며 length 는 반드시 있어야
+ * 한다. length 는 헤더를 제외한 본문 길이이다.
+ */
+typedef struct frame_fmt_s
+{
+    int order;			/**< FRAME_BE 또는 FRAME_LE */
+    int magic_size;		/**< magic 필드 크기 (0, 1, 2, 4) */
+    int version_size;		/**< version 필드 크기 (0, 1, 2, 4) */
+    int length_size;		/**< length 필드 크기 (1, 2, 4) */
+    int type_size;		/**< type 필드 크기 (0, 1, 2, 4) */
+    int seq_size;		/**< seq 필드 크기 (0, 1, 2, 4) */
+    uint32_t magic;		/**< 기대하는 magic (다르면 EPROTO) */
+    uint32_t version;		/**< 보내는 version, 받을 때는 이 값 이하만 허용 */
+    size_t max_len;		/**< 최대 본문 길이 (넘으면 EMSGSIZE) */
+} frame_fmt_t;
+
+/**
+ * 디코딩한 frame (본문은 받은 버퍼 안을 가리킴)
+ */
+typedef struct frame_s
+{
+    uint32_t version;		/**< version */
+    uint32_t type;		/**< 메시지 종류 */
+    uint32_t seq;		/**< 순서 번호 */
+    size_t len;			/**< 본문 길이 */
+    const char *data;		/**< 본문 (복사하지 않음) */
+} frame_t;
+
+void frame_fmt_init(frame_fmt_t *fmt);
+size_t frame_hdr_size(const frame_fmt_t *fmt);
+
+ssize_t frame_decode(const frame_fmt_t *fmt, const char *buf, size_t len, frame_t *f);
+int frame_read(bufread_t *br, const frame_fmt_t *fmt, frame_t *f);
+
+size_t frame_put_hdr(const frame_fmt_t *fmt, char *hdr, size_t len, uint32_t type, uint32_t seq);
+char *frame_encode(const frame_fmt_t *fmt, char *payload, size_t len, uint32_t type, uint32_t seq);
+ssize_t frame_send(int fd, const frame_fmt_t *fmt, uint32_t type, uint32_t seq, const void *payload, size_t len);
+
+#endif
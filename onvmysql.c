@@ -341,6 +341,28 @@ db_escape_string(sql_t *sql, char **to, const char *from, unsigned long length)
     return 0;
 }
 
+/**
+ * @brief SQL 쿼리 문자열 Escape String (arena 할당)
+ * @param sql - SQL 구조체
+ * @param a - arena (결과는 free 하지 않고 arena_reset() 으로 해제)
+ * @param to - (OUT) Escape String된 문자열을 저장할 포인터
+ * @param from - Escape시킬 문자열
+ * @param length - \a from 의 길이
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+db_escape_string_arena(sql_t *sql, arena_t *a, char **to, const char *from, unsigned long length)
+{
+    *to = arena_alloc(a, (size_t)(length * 2) + 1);
+    if (!*to)
+	return -1;
+
+    (void) mysql_real_escape_string(sql->mysql, *to, from, length);
+    return 0;
+}
+
 /**
  * @brief 최근 쿼리에 영향을 받은 row의 개수를 리턴
  * @param sql - SQL 핸들러
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <mysql.h>
+#include "onvarena.h"
 
 #define MAX_SQL_ERRMSG  8192
 
@@ -54,6 +55,7 @@ unsigned int db_num_rows(sql_res_t *res);
 char *db_errmsg(sql_t *sql);
 unsigned long long db_insert_id(sql_t *sql);
 int db_escape_string(sql_t *sql, char **to, const char *from, unsigned long length);
+int db_escape_string_arena(sql_t *sql, arena_t *a, char **to, const char *from, unsigned long length);
 int db_set_character_set(sql_t *sql, const char *charset);
 unsigned long long db_affected_rows(sql_t *sql);
 unsigned int db_num_fields(sql_res_t *res);
@@ -0,0 +1,425 @@
+/**
+ * @file onvpool.c
+ * @brief TCP 연결 풀
+ */
+
+/*
+ * TCP 연결 풀
+ *
+ * host:port 별로 연결을 재사용하여 요청마다 TCP handshake 와 getaddrinfo()
+ * 를 하지 않도록 한다. connpool_get() 으로 빌리고 connpool_put() 으로
+ * 돌려준다. 에러가 난 연결은 broken 으로 돌려주면 재사용하지 않고 close 한다.
+ *
+ * 여러 쓰레드에서 같은 풀을 사용해도 된다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvsock.h"
+#include "onvsockopt.h"
+#include "onvpool.h"
+
+/**
+ * idle 연결 구조체
+ */
+typedef struct pool_conn_s
+{
+    int fd;			/**< 연결 소켓 */
+    time_t last_used;		/**< 반납된 시각 */
+    struct pool_conn_s *next;
+} pool_conn_t;
+
+/**
+ * host:port 별 연결 목록
+ */
+typedef struct pool_key_s
+{
+    char *host;			/**< 호스트명 또는 IP */
+    int port;			/**< 포트 */
+    int nidle;			/**< idle 연결 수 */
+    int nleased;		/**< 사용중 + 접속중 연결 수 */
+    pool_conn_t *idle;		/**< idle 연결 스택 (최근 반납한 연결이 앞) */
+    struct pool_key_s *next;
+} pool_key_t;
+
+struct connpool_s
+{
+    connpool_conf_t conf;	/**< 풀 설정 */
+    pthread_mutex_t lock;	/**< 풀 잠금 */
+    pool_key_t *keys;		/**< host:port 목록 */
+    pool_key_t **leased;	/**< 사용중인 fd 의 host:port (fd 로 인덱싱) */
+    int nleased_slots;		/**< \a leased 의 크기 */
+};
+
+static pool_key_t *find_key(connpool_t *pool, const char *host, int port);
+static int conn_alive(int fd);
+static int evict_key(connpool_t *pool, pool_key_t *key, time_t now);
+static int set_leased(connpool_t *pool, int fd, pool_key_t *key);
+
+
+/**
+ * @brief 연결 풀 생성
+ * @param conf - 풀 설정 (NULL 이면 기본값, 복사하여 보관)
+ * @return
+ *  성공 시 연결 풀 포인터 (사용 후 connpool_destroy()),\n
+ *  실패 시 NULL
+ */
+connpool_t *
+connpool_create(const connpool_conf_t *conf)
+{
+    connpool_t *pool = NULL;
+
+    if ((pool = calloc(1, sizeof(connpool_t))) == NULL) {
+	return NULL;
+    }
+    if (conf) {
+	pool->conf = *conf;
+    }
+
+    if (pool->conf.max_idle <= 0) {
+	pool->conf.max_idle = CONNPOOL_MAX_IDLE;
+    }
+    if (pool->conf.max_total <= 0) {
+	pool->conf.max_total = CONNPOOL_MAX_TOTAL;
+    }
+    if (pool->conf.max_idle > pool->conf.max_total) {
+	pool->conf.max_idle = pool->conf.max_total;
+    }
+    if (pool->conf.idle_timeout <= 0) {
+	pool->conf.idle_timeout = CONNPOOL_IDLE_TIMEOUT;
+    }
+    if (pool->conf.connect_timeout <= 0) {
+	pool->conf.connect_timeout = CONNPOOL_CONN_TIMEOUT;
+    }
+    /* 상대방이 말없이 사라진 idle 연결을 커널이 정리하도록 항상 keepalive */
+    pool->conf.opt.keepalive = 1;
+
+    pthread_mutex_init(&pool->lock, NULL);
+
+    return pool;
+}
+
+
+/**
+ * @brief 연결 풀 제거
+ * @param pool - 연결 풀
+ * @return 없음
+ *
+ * idle 연결은 close 한다. 사용중인 연결은 호출자가 close 해야 한다.
+ */
+void
+connpool_destroy(connpool_t *pool)
+{
+    pool_key_t *key = NULL, *next_key = NULL;
+    pool_conn_t *conn = NULL, *next = NULL;
+
+    if (!pool) {
+	return;
+    }
+
+    for (key = pool->keys; key; key = next_key) {
+	next_key = key->next;
+	for (conn = key->idle; conn; conn = next) {
+	    next = conn->next;
+	    close(conn->fd);
+	    free(conn);
+	}
+	free(key->host);
+	free(key);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->leased);
+    free(pool);
+}
+
+
+/**
+ * @brief host:port 목록 검색 (없으면 생성, 잠금 상태에서 호출)
+ * @param pool - 연결 풀
+ * @param host - 호스트명 또는 IP
+ * @param port - 포트
+ * @return
+ *  성공 시 host:port 목록 포인터,\n
+ *  실패 시 NULL
+ */
+static pool_key_t *
+find_key(connpool_t *pool, const char *host, int port)
+{
+    pool_key_t *key = NULL;
+
+    for (key = pool->keys; key; key = key->next) {
+	if (key->port == port && strcmp(key->host, host) == 0) {
+	    return key;
+	}
+    }
+
+    if ((key = calloc(1, sizeof(pool_key_t))) == NULL) {
+	return NULL;
+    }
+    if ((key->host = strdup(host)) == NULL) {
+	free(key);
+	return NULL;
+    }
+    key->port = port;
+    key->next = pool->keys;
+    pool->keys = key;
+
+    return key;
+}
+
+
+/**
+ * @brief 사용중인 fd 의 host:port 기록 (잠금 상태에서 호출)
+ * @param pool - 연결 풀
+ * @param fd - 연결 소켓
+ * @param key - host:port 목록 (NULL 이면 기록 삭제)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+static int
+set_leased(connpool_t *pool, int fd, pool_key_t *key)
+{
+    pool_key_t **tmp = NULL;
+    int n;
+
+    if (fd >= pool->nleased_slots) {
+	if (!key) {
+	    return 0;
+	}
+	n = pool->nleased_slots ? pool->nleased_slots : 64;
+	while (n <= fd) {
+	    n *= 2;
+	}
+	if ((tmp = realloc(pool->leased, sizeof(pool_key_t *) * n)) == NULL) {
+	    return -1;
+	}
+	memset(tmp + pool->nleased_slots, 0, sizeof(pool_key_t *) * (n - pool->nleased_slots));
+	pool->leased = tmp;
+	pool->nleased_slots = n;
+    }
+
+    pool->leased[fd] = key;
+
+    return 0;
+}
+
+
+/**
+ * @brief idle 연결이 아직 사용 가능한지 확인
+ * @param fd - 연결 소켓
+ * @return
+ *  사용 가능하면 1,\n
+ *  상대방이 연결을 끊었거나 읽지 않은 데이터가 남아 있으면 0
+ */
+static int
+conn_alive(int fd)
+{
+    char c;
+    ssize_t n;
+
+    n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+	return 1;
+    }
+
+    /* n == 0 : 상대방 종료, n > 0 : 이전 요청의 응답이 남은 오염된 연결 */
+    return 0;
+}
+
+
+/**
+ * @brief 제한시간이 지난 idle 연결 close (잠금 상태에서 호출)
+ * @param pool - 연결 풀
+ * @param key - host:port 목록
+ * @param now - 현재 시각
+ * @return close 한 연결 수
+ */
+static int
+evict_key(connpool_t *pool, pool_key_t *key, time_t now)
+{
+    pool_conn_t **pp = NULL, *conn = NULL;
+    int n = 0;
+
+    pp = &key->idle;
+    while ((conn = *pp) != NULL) {
+	if (now - conn->last_used >= pool->conf.idle_timeout) {
+	    *pp = conn->next;
+	    close(conn->fd);
+	    free(conn);
+	    key->nidle--;
+	    n++;
+	}
+	else {
+	    pp = &conn->next;
+	}
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief 연결 빌리기
+ * @param pool - 연결 풀
+ * @param host - 호스트명 또는 IP
+ * @param port - 포트
+ * @return
+ *  성공 시 socket descriptor (사용 후 connpool_put()),\n
+ *  실패 시 -1 (max_total 초과 시 errno = EAGAIN)
+ *
+ * 살아있는 idle 연결이 있으면 그것을 주고, 없으면 onvTCPconnectParallel()
+ * 으로 새로 접속한다. 반환된 소켓은 blocking 이다.
+ */
+int
+connpool_get(connpool_t *pool, const char *host, int port)
+{
+    pool_key_t *key = NULL;
+    pool_conn_t *conn = NULL;
+    char service[16];
+    int fd = -1;
+
+    ASSERT(pool != NULL && host != NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    if ((key = find_key(pool, host, port)) == NULL) {
+	pthread_mutex_unlock(&pool->lock);
+	return -1;
+    }
+    evict_key(pool, key, time(NULL));
+
+    while ((conn = key->idle) != NULL) {
+	key->idle = conn->next;
+	key->nidle--;
+	fd = conn->fd;
+	free(conn);
+	if (conn_alive(fd) && set_leased(pool, fd, key) == 0) {
+	    key->nleased++;
+	    pthread_mutex_unlock(&pool->lock);
+	    return fd;
+	}
+	close(fd);
+    }
+
+    if (key->nleased >= pool->conf.max_total) {
+	pthread_mutex_unlock(&pool->lock);
+	errno = EAGAIN;
+	return -1;
+    }
+    key->nleased++;		/* 접속중에도 max_total 에 포함 */
+    pthread_mutex_unlock(&pool->lock);
+
+    snprintf(service, sizeof(service), "%d", port);
+    if ((fd = onvTCPconnectParallel(host, service, pool->conf.connect_timeout, 0)) >= 0) {
+	(void) sockopt_apply(fd, &pool->conf.opt);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (fd < 0 || set_leased(pool, fd, key) < 0) {
+	key->nleased--;
+	pthread_mutex_unlock(&pool->lock);
+	if (fd >= 0) {
+	    close(fd);
+	}
+	return -1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return fd;
+}
+
+
+/**
+ * @brief 연결 반납
+ * @param pool - 연결 풀
+ * @param fd - connpool_get() 으로 빌린 소켓
+ * @param broken - 읽기/쓰기 에러나 프로토콜 에러가 있었으면 1
+ * @return 없음
+ *
+ * broken 이거나 idle 연결이 max_idle 만큼 있으면 close 한다.
+ * 응답을 끝까지 읽지 않은 연결은 broken 으로 반납해야 한다.
+ */
+void
+connpool_put(connpool_t *pool, int fd, int broken)
+{
+    pool_key_t *key = NULL;
+    pool_conn_t *conn = NULL;
+
+    ASSERT(pool != NULL);
+
+    if (fd < 0) {
+	return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (fd >= pool->nleased_slots || (key = pool->leased[fd]) == NULL) {
+	pthread_mutex_unlock(&pool->lock);
+	Log(WARN, "connpool_put: fd %d is not leased from this pool", fd);
+	close(fd);
+	return;
+    }
+    pool->leased[fd] = NULL;
+    key->nleased--;
+
+    if (!broken && key->nidle < pool->conf.max_idle &&
+	    (conn = malloc(sizeof(pool_conn_t))) != NULL) {
+	conn->fd = fd;
+	conn->last_used = time(NULL);
+	conn->next = key->idle;
+	key->idle = conn;
+	key->nidle++;
+	fd = -1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (fd >= 0) {
+	close(fd);
+    }
+}
+
+
+/**
+ * @brief 제한시간이 지난 idle 연결 정리
+ * @param pool - 연결 풀
+ * @return close 한 연결 수
+ *
+ * connpool_get() 에서도 해당 host:port 는 정리하지만, 사용이 뜸한
+ * host:port 의 연결을 정리하려면 주기적으로 호출한다 (예: event_timer_add()).
+ */
+int
+connpool_evict(connpool_t *pool)
+{
+    pool_key_t *key = NULL;
+    time_t now;
+    int n = 0;
+
+    ASSERT(pool != NULL);
+
+    now = time(NULL);
+    pthread_mutex_lock(&pool->lock);
+    for (key = pool->keys; key; key = key->next) {
+	n += evict_key(pool, key, now);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return n;
+}
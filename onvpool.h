@@ -0,0 +1,50 @@
+/**
+ * @file onvpool.h
+ * @brief TCP 연결 풀 헤더
+ */
+
+/*
+ * TCP 연결 풀 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_POOL_H
+#define ONV_POOL_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "onvsockopt.h"
+
+#define CONNPOOL_MAX_IDLE	8	/**< host:port 별 기본 최대 idle 연결 수 */
+#define CONNPOOL_MAX_TOTAL	64	/**< host:port 별 기본 최대 연결 수 */
+#define CONNPOOL_IDLE_TIMEOUT	60	/**< 기본 idle 제한시간(초) */
+#define CONNPOOL_CONN_TIMEOUT	3	/**< 기본 접속 제한시간(초) */
+
+/**
+ * 연결 풀 설정 구조체
+ * 0 인 항목은 기본값을 사용한다.
+ */
+typedef struct connpool_conf_s
+{
+    int max_idle;		/**< host:port 별 최대 idle 연결 수 */
+    int max_total;		/**< host:port 별 최대 연결 수 (idle + 사용중) */
+    int idle_timeout;		/**< idle 연결 제한시간(초), 지나면 close */
+    int connect_timeout;	/**< 새 연결 접속 제한시간(초) */
+    sockopt_t opt;		/**< 새 연결에 적용할 소켓 옵션 (keepalive 는 항상 설정) */
+} connpool_conf_t;
+
+typedef struct connpool_s connpool_t;
+
+connpool_t *connpool_create(const connpool_conf_t *conf);
+void connpool_destroy(connpool_t *pool);
+int connpool_get(connpool_t *pool, const char *host, int port);
+void connpool_put(connpool_t *pool, int fd, int broken);
+int connpool_evict(connpool_t *pool);
+
+#endif
@@ -0,0 +1,613 @@
+/**
+ * @file onvprefork.c
+ * @brief Prefork 워커 프로세스 관리자
+ */
+
+/*
+ * Prefork 워커 프로세스 관리자
+ *
+ * 마스터 프로세스가 daemonize() 후 socket_listen() 으로 리슨 소켓을 한번만
+ * 생성하고, 워커 프로세스를 fork 하여 같은 소켓에서 Accept() 하도록 한다.
+ * reuseport 를 설정하면 워커마다 SO_REUSEPORT 소켓을 따로 두어 accept queue
+ * 경합을 없앤다. 이 소켓도 마스터가 보관하므로 워커가 바로 재시작되면 queue
+ * 에 쌓인 연결은 유실되지 않는다. 워커는 자기 슬롯의 소켓만 열어두고, 죽은
+ * 워커가 backoff 대기에 들어가면 마스터가 그 슬롯의 소켓을 닫았다가 재시작
+ * 직전에 다시 생성한다. 아무도 accept 하지 않는 소켓으로 커널이 새 연결을
+ * 분배하지 않도록 하기 위해서이다.
+ *
+ *  - SIGCHLD : 죽은 워커를 backoff 후 재시작
+ *  - SIGHUP  : 워커를 하나씩 교체하는 롤링 재시작
+ *  - SIGTERM, SIGINT : 워커 종료 후 마스터 종료
+ *  - SIGUSR2 : 리슨 소켓을 새 바이너리에 인계하고, 새 마스터가 준비되면
+ *              워커의 처리중인 연결을 마무리한 뒤 종료 (onvupgrade.c)
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvprefork.h"
+#include "onvupgrade.h"
+
+/**
+ * 워커 슬롯 구조체
+ */
+typedef struct worker_slot_s
+{
+    pid_t pid;		/**< 현재 워커 pid (없으면 0) */
+    pid_t old_pid;	/**< 롤링 재시작 중 종료를 기다리는 이전 워커 pid */
+    int listenfd;	/**< 워커가 사용할 리슨 소켓 */
+    int retired;	/**< 롤링 재시작에서 이미 교체된 슬롯이면 1 */
+    time_t started;	/**< 워커 시작 시각 */
+    time_t next_start;	/**< 재시작 예정 시각 */
+    time_t retire_at;	/**< 이전 워커에 SIGTERM 을 보낸 시각 */
+    int backoff;	/**< 현재 재시작 대기시간(초) */
+} worker_slot_t;
+
+static volatile sig_atomic_t worker_stopping = 0;
+static volatile int worker_listenfd = -1;
+
+static void worker_sigterm(int signo);
+static int open_listeners(prefork_t *pf, worker_slot_t *slots);
+static pid_t spawn_worker(prefork_t *pf, worker_slot_t *slots, int index, const sigset_t *oldmask);
+static void reap_workers(prefork_t *pf, worker_slot_t *slots, int stopping);
+static void rolling_step(prefork_t *pf, worker_slot_t *slots, int *rolling,
+	const sigset_t *oldmask);
+static void stop_workers(prefork_t *pf, worker_slot_t *slots, const sigset_t *set);
+static int upgrade(prefork_t *pf, worker_slot_t *slots);
+
+
+/**
+ * @brief 워커 종료 요청 여부
+ * @param 없음
+ * @return
+ *  종료 요청을 받았으면 1,\n
+ *  아니면 0
+ */
+int
+prefork_worker_stopping(void)
+{
+    return worker_stopping ? 1 : 0;
+}
+
+
+/**
+ * @brief 워커의 SIGTERM 핸들러
+ *
+ * 리슨 소켓을 닫아 Accept() 가 -1 을 반환하도록 하고, 처리중인 연결은
+ * 워커가 마무리한 뒤 반환하도록 한다.
+ */
+static void
+worker_sigterm(int signo)
+{
+    (void) signo;
+
+    worker_stopping = 1;
+    if (worker_listenfd >= 0) {
+	close(worker_listenfd);
+	worker_listenfd = -1;
+    }
+}
+
+
+/**
+ * @brief 워커 프로세스 생성
+ * @param pf - Prefork 설정
+ * @param slots - 워커 슬롯 배열
+ * @param index - 워커 번호 (slots[index].listenfd 를 사용)
+ * @param oldmask - 워커에서 복원할 시그널 마스크
+ * @return
+ *  성공 시 워커 pid,\n
+ *  실패 시 -1
+ */
+static pid_t
+spawn_worker(prefork_t *pf, worker_slot_t *slots, int index, const sigset_t *oldmask)
+{
+    pid_t pid;
+    struct sigaction sa;
+    int i, listenfd = slots[index].listenfd;
+
+    if ((pid = fork()) < 0) {
+	Log(ERROR, "fork() failed: %s", strerror(errno));
+	return -1;
+    }
+    if (pid > 0) {
+	return pid;
+    }
+
+    /* 워커 프로세스: 다른 슬롯의 reuseport 소켓은 닫는다 */
+    if (pf->reuseport) {
+	for (i = 0; i < pf->nworkers; i++) {
+	    if (i != index && slots[i].listenfd >= 0) {
+		close(slots[i].listenfd);
+	    }
+	}
+    }
+    worker_listenfd = listenfd;
+
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = worker_sigterm;	/* SA_RESTART 없음: accept() 를 깨운다 */
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;		/* 터미널 시그널은 마스터가 처리 */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    sa.sa_handler = SIG_DFL;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    if (pf->cpu_affinity && cpu_pin(index) < 0) {
+	Log(WARN, "worker[%d]: cpu_pin() failed: %s", index, strerror(errno));
+    }
+
+    sigprocmask(SIG_SETMASK, oldmask, NULL);
+
+    _exit(pf->worker(listenfd, index, pf->arg) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/**
+ * @brief 종료된 워커를 회수하고 재시작 시각을 계산
+ * @param pf - Prefork 설정
+ * @param slots - 워커 슬롯 배열
+ * @param stopping - 종료중이면 1 (재시작하지 않음)
+ * @return 없음
+ *
+ * 비정상 종료한 워커는 backoff_min 부터 두배씩 backoff_max 까지 대기 후
+ * 재시작한다. backoff_max 이상 동작한 워커가 죽으면 backoff 를 초기화한다.
+ */
+static void
+reap_workers(prefork_t *pf, worker_slot_t *slots, int stopping)
+{
+    int i, status, abnormal;
+    pid_t pid;
+    time_t now;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+	now = time(NULL);
+	for (i = 0; i < pf->nworkers; i++) {
+	    if (slots[i].old_pid == pid) {
+		slots[i].old_pid = 0;
+		break;
+	    }
+	    if (slots[i].pid != pid) {
+		continue;
+	    }
+
+	    slots[i].pid = 0;
+	    if (stopping) {
+		break;
+	    }
+
+	    abnormal = !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	    if (!abnormal) {
+		slots[i].next_start = now;
+	    }
+	    else {
+		if (slots[i].backoff == 0 || now - slots[i].started >= pf->backoff_max) {
+		    slots[i].backoff = pf->backoff_min;
+		}
+		else if ((slots[i].backoff *= 2) > pf->backoff_max) {
+		    slots[i].backoff = pf->backoff_max;
+		}
+		slots[i].next_start = now + slots[i].backoff;
+	    }
+
+	    /* backoff 동안 아무도 accept 하지 않는 소켓으로 연결이 가지 않도록 */
+	    if (pf->reuseport && slots[i].next_start > now && slots[i].listenfd >= 0) {
+		close(slots[i].listenfd);
+		slots[i].listenfd = -1;
+		if (i == 0) {
+		    pf->listenfd = -1;
+		}
+	    }
+
+	    if (WIFSIGNALED(status)) {
+		Log(WARN, "worker[%d] pid %d killed by signal %d, restart in %d sec",
+			i, (int) pid, WTERMSIG(status), (int) (slots[i].next_start - now));
+	    }
+	    else {
+		Log(WARN, "worker[%d] pid %d exited with %d, restart in %d sec",
+			i, (int) pid, WEXITSTATUS(status), (int) (slots[i].next_start - now));
+	    }
+	    break;
+	}
+    }
+}
+
+
+/**
+ * @brief 롤링 재시작 진행
+ * @param pf - Prefork 설정
+ * @param slots - 워커 슬롯 배열
+ * @param rolling - (IN/OUT) 교체중인 슬롯 번호 (-1 이면 진행중 아님)
+ * @param oldmask - 워커에서 복원할 시그널 마스크
+ * @return 없음
+ *
+ * 새 워커를 먼저 띄운 뒤 이전 워커에 SIGTERM 을 보내고, 이전 워커가 종료되면
+ * 다음 슬롯으로 넘어간다. 교체 중에도 워커 수가 줄어들지 않는다.
+ */
+static void
+rolling_step(prefork_t *pf, worker_slot_t *slots, int *rolling, const sigset_t *oldmask)
+{
+    worker_slot_t *s = NULL;
+    time_t now;
+
+    now = time(NULL);
+    while (*rolling >= 0 && *rolling < pf->nworkers) {
+	s = &slots[*rolling];
+
+	/* 이전 워커 종료 대기중 */
+	if (s->old_pid > 0) {
+	    if (now - s->retire_at >= pf->stop_timeout) {
+		kill(s->old_pid, SIGKILL);
+	    }
+	    return;
+	}
+
+	/* 교체가 끝났거나 backoff 대기중인 슬롯 */
+	if (s->retired || s->pid <= 0) {
+	    s->retired = 0;
+	    (*rolling)++;
+	    continue;
+	}
+
+	s->old_pid = s->pid;
+	s->retired = 1;
+	s->retire_at = now;
+	s->started = now;
+	if ((s->pid = spawn_worker(pf, slots, *rolling, oldmask)) < 0) {
+	    s->pid = 0;
+	    s->next_start = now + pf->backoff_min;
+	}
+	kill(s->old_pid, SIGTERM);
+	return;
+    }
+
+    if (*rolling >= pf->nworkers) {
+	Log(INFO, "rolling restart completed");
+	*rolling = -1;
+    }
+}
+
+
+/**
+ * @brief 모든 워커 종료
+ * @param pf - Prefork 설정
+ * @param slots - 워커 슬롯 배열
+ * @param set - 마스터가 대기하는 시그널 집합
+ * @return 없음
+ *
+ * SIGTERM 을 보낸 뒤 stop_timeout 동안 기다리고, 남은 워커는 SIGKILL 한다.
+ */
+static void
+stop_workers(prefork_t *pf, worker_slot_t *slots, const sigset_t *set)
+{
+    int i, alive;
+    time_t deadline;
+    struct timespec ts;
+
+    for (i = 0; i < pf->nworkers; i++) {
+	if (slots[i].pid > 0) {
+	    kill(slots[i].pid, SIGTERM);
+	}
+	if (slots[i].old_pid > 0) {
+	    kill(slots[i].old_pid, SIGTERM);
+	}
+    }
+
+    deadline = time(NULL) + pf->stop_timeout;
+    while (1) {
+	reap_workers(pf, slots, 1);
+	for (i = 0, alive = 0; i < pf->nworkers; i++) {
+	    if (slots[i].pid > 0 || slots[i].old_pid > 0) {
+		alive++;
+	    }
+	}
+	if (alive == 0 || time(NULL) >= deadline) {
+	    break;
+	}
+	ts.tv_sec = 0;
+	ts.tv_nsec = 200 * 1000 * 1000;
+	(void) sigtimedwait(set, NULL, &ts);
+    }
+
+    for (i = 0; i < pf->nworkers; i++) {
+	if (slots[i].pid > 0) {
+	    Log(WARN, "worker[%d] pid %d did not stop, killing", i, (int) slots[i].pid);
+	    kill(slots[i].pid, SIGKILL);
+	    waitpid(slots[i].pid, NULL, 0);
+	}
+	if (slots[i].old_pid > 0) {
+	    kill(slots[i].old_pid, SIGKILL);
+	    waitpid(slots[i].old_pid, NULL, 0);
+	}
+    }
+}
+
+
+/**
+ * @brief 리슨 소켓을 새 바이너리에 인계
+ * @param pf - Prefork 설정
+ * @param slots - 워커 슬롯 배열
+ * @return
+ *  새 마스터가 준비완료를 통지하면 0,\n
+ *  실패 시 -1 (이전 마스터가 계속 서비스)
+ *
+ * pf->argv 가 있으면 직접 실행하며 fd 를 상속시키고, 없으면 pf->upgrade_path
+ * 에서 외부에서 실행된 새 바이너리의 접속을 기다려 SCM_RIGHTS 로 넘겨준다.
+ */
+static int
+upgrade(prefork_t *pf, worker_slot_t *slots)
+{
+    int fds[UPGRADE_MAX_FDS];
+    int i, nfds, readyfd, result;
+    pid_t pid;
+
+    nfds = 1;
+    fds[0] = pf->listenfd;
+    if (pf->reuseport) {
+	/* 일부만 넘기면 나머지 소켓의 accept queue 가 버려지므로 거부 */
+	if (pf->nworkers > UPGRADE_MAX_FDS) {
+	    Log(ERROR, "upgrade: %d reuseport listeners exceed the handover limit %d, aborted",
+		    pf->nworkers, UPGRADE_MAX_FDS);
+	    return -1;
+	}
+	/* backoff 중이라 닫아둔 슬롯은 새 마스터가 다시 생성한다 */
+	for (i = 0, nfds = 0; i < pf->nworkers; i++) {
+	    if (slots[i].listenfd >= 0) {
+		fds[nfds++] = slots[i].listenfd;
+	    }
+	}
+	if (nfds == 0) {
+	    Log(ERROR, "upgrade: no listener to hand over");
+	    return -1;
+	}
+    }
+
+    if (pf->argv) {
+	Log(INFO, "upgrade: executing %s", pf->argv[0]);
+	if ((pid = upgrade_exec(pf->argv, fds, nfds, &readyfd)) < 0) {
+	    Log(ERROR, "upgrade: upgrade_exec() failed: %s", strerror(errno));
+	    return -1;
+	}
+	result = upgrade_wait_ready(readyfd, UPGRADE_READY_TIMEOUT);
+	close(readyfd);
+	if (result < 0) {
+	    Log(ERROR, "upgrade: new master %d is not ready, aborted", (int) pid);
+	    kill(pid, SIGTERM);
+	    waitpid(pid, NULL, 0);
+	}
+	return result;
+    }
+
+    if (pf->upgrade_path) {
+	Log(INFO, "upgrade: waiting for new master on %s", pf->upgrade_path);
+	return upgrade_send_fds(pf->upgrade_path, fds, nfds, UPGRADE_READY_TIMEOUT);
+    }
+
+    Log(WARN, "upgrade requested but neither argv nor upgrade_path is set");
+    return -1;
+}
+
+
+/**
+ * @brief 워커 슬롯별 리슨 소켓 준비
+ * @param pf - Prefork 설정
+ * @param slots - 워커 슬롯 배열
+ * @return
+ *  이전 마스터로부터 소켓을 넘겨받았으면 1,\n
+ *  새로 생성했으면 0,\n
+ *  실패 시 -1
+ *
+ * 업그레이드로 실행되었으면 상속받은 소켓을 사용하고, 아니면 필요 시
+ * daemonize() 후 socket_listen() (reuseport 이면 워커마다
+ * socket_listen_reuseport()) 으로 생성한다.
+ */
+static int
+open_listeners(prefork_t *pf, worker_slot_t *slots)
+{
+    int fds[UPGRADE_MAX_FDS], all[UPGRADE_MAX_FDS];
+    int i, j, n = 0, nall;
+
+    /* upgrade_exec() 로 실행되었으면 이미 데몬이므로 daemonize() 생략 */
+    nall = upgrade_inherited_fds(0, all, UPGRADE_MAX_FDS);
+
+    if (nall == 0 && pf->daemon && daemonize() < 0) {
+	Log(ERROR, "daemonize() failed");
+	return -1;
+    }
+
+    /*
+     * abstract namespace ('@') 경로는 access() 로 확인할 수 없으므로 접속을
+     * 시도해 본다. ENOENT/ECONNREFUSED 이면 이전 마스터가 없는 것이다.
+     */
+    if (nall == 0 && pf->upgrade_path &&
+	    upgrade_recv_fds(pf->upgrade_path, all, UPGRADE_MAX_FDS, 0) > 0) {
+	nall = upgrade_inherited_fds(0, all, UPGRADE_MAX_FDS);
+    }
+    if (nall > 0) {
+	n = upgrade_inherited_fds(pf->port, fds, pf->reuseport ? UPGRADE_MAX_FDS : 1);
+    }
+    /* 워커나 워커가 실행하는 프로그램이 다시 상속받지 않도록 */
+    unsetenv(UPGRADE_ENV_FDS);
+
+    /* 받았지만 쓰지 않는 소켓 (다른 포트, reuseport 가 아니면 두번째부터) 은 닫는다 */
+    for (j = 0; j < nall; j++) {
+	for (i = 0; i < n && fds[i] != all[j]; i++) {
+	    ;
+	}
+	if (i == n) {
+	    close(all[j]);
+	}
+    }
+
+    for (i = 0; i < pf->nworkers; i++) {
+	if (i < n) {
+	    slots[i].listenfd = fds[i];
+	}
+	else if (i > 0 && !pf->reuseport) {
+	    slots[i].listenfd = slots[0].listenfd;
+	}
+	else if ((slots[i].listenfd = pf->reuseport ?
+		    socket_listen_reuseport(pf->port) : socket_listen(pf->port)) < 0) {
+	    Log(ERROR, "listen on port %d failed: %s", pf->port, strerror(errno));
+	    while (--i >= 0) {
+		if (pf->reuseport || i == 0) {
+		    close(slots[i].listenfd);
+		}
+	    }
+	    return -1;
+	}
+    }
+
+    /* 이전 마스터의 워커가 더 많았으면 남는 소켓은 닫는다 */
+    for (i = pf->nworkers; i < n; i++) {
+	close(fds[i]);
+    }
+
+    pf->listenfd = slots[0].listenfd;
+
+    return n > 0 ? 1 : 0;
+}
+
+
+/**
+ * @brief Prefork 마스터 실행
+ * @param pf - Prefork 설정 (port, worker 는 필수)
+ * @return
+ *  SIGTERM, SIGINT 로 정상 종료하거나 업그레이드가 끝나면 0,\n
+ *  실패 시 -1
+ *
+ * 종료 시그널을 받을 때까지 반환하지 않는다. 워커는 pf->worker 를 실행하며
+ * prefork_worker_stopping() 이 참이면 처리중인 연결을 마무리하고 반환해야 한다.
+ * 업그레이드로 실행된 경우 이전 마스터의 리슨 소켓을 그대로 사용한다.
+ */
+int
+prefork_run(prefork_t *pf)
+{
+    worker_slot_t slots[PREFORK_MAX_WORKERS];
+    sigset_t set, oldmask;
+    struct sigaction sa;
+    struct timespec ts;
+    time_t now;
+    long ncpu;
+    int i, signo, rolling = -1, inherited, notified = 0;
+
+    ASSERT(pf != NULL && pf->worker != NULL);
+
+    if (pf->nworkers <= 0) {
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	pf->nworkers = ncpu > 0 ? (int) ncpu : 1;
+    }
+    if (pf->nworkers > PREFORK_MAX_WORKERS) {
+	pf->nworkers = PREFORK_MAX_WORKERS;
+    }
+    if (pf->backoff_min <= 0) {
+	pf->backoff_min = PREFORK_BACKOFF_MIN;
+    }
+    if (pf->backoff_max < pf->backoff_min) {
+	pf->backoff_max = PREFORK_BACKOFF_MAX;
+    }
+    if (pf->stop_timeout <= 0) {
+	pf->stop_timeout = PREFORK_STOP_TIMEOUT;
+    }
+
+    memset(slots, 0, sizeof(slots));
+    if ((inherited = open_listeners(pf, slots)) < 0) {
+	return -1;
+    }
+
+    /* SIGCHLD 가 SIG_IGN 이면 자식이 자동 회수되므로 기본값으로 되돌린다 */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_DFL;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &set, &oldmask);
+
+    Log(INFO, "prefork master %d: port %d, %d workers%s%s",
+	    (int) getpid(), pf->port, pf->nworkers,
+	    pf->reuseport ? ", reuseport" : "", inherited ? " (upgraded)" : "");
+
+    while (1) {
+	now = time(NULL);
+	for (i = 0; i < pf->nworkers; i++) {
+	    if (slots[i].pid == 0 && now >= slots[i].next_start) {
+		/* backoff 동안 닫아둔 reuseport 소켓을 다시 생성 */
+		if (slots[i].listenfd < 0) {
+		    if ((slots[i].listenfd = socket_listen_reuseport(pf->port)) < 0) {
+			Log(ERROR, "worker[%d]: listen on port %d failed: %s",
+				i, pf->port, strerror(errno));
+			slots[i].next_start = now + pf->backoff_min;
+			continue;
+		    }
+		    if (i == 0) {
+			pf->listenfd = slots[0].listenfd;
+		    }
+		}
+		slots[i].started = now;
+		if ((slots[i].pid = spawn_worker(pf, slots, i, &oldmask)) < 0) {
+		    slots[i].pid = 0;
+		    slots[i].next_start = now + pf->backoff_min;
+		}
+	    }
+	}
+	if (!notified) {
+	    (void) upgrade_notify_ready();
+	    notified = 1;
+	}
+
+	ts.tv_sec = 1;
+	ts.tv_nsec = 0;
+	signo = sigtimedwait(&set, NULL, &ts);
+	if (signo == SIGTERM || signo == SIGINT) {
+	    Log(INFO, "prefork master %d: stopping (signal %d)", (int) getpid(), signo);
+	    break;
+	}
+	if (signo == SIGUSR2 && upgrade(pf, slots) == 0) {
+	    Log(INFO, "upgrade: new master is ready, draining workers");
+	    break;
+	}
+	if (signo == SIGHUP && rolling < 0) {
+	    Log(INFO, "rolling restart requested");
+	    rolling = 0;
+	}
+
+	reap_workers(pf, slots, 0);
+	rolling_step(pf, slots, &rolling, &oldmask);
+    }
+
+    stop_workers(pf, slots, &set);
+    for (i = 0; i < pf->nworkers; i++) {
+	if ((pf->reuseport || i == 0) && slots[i].listenfd >= 0) {
+	    close(slots[i].listenfd);
+	}
+    }
+    pf->listenfd = -1;
+    sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file onvprefork.h
+ * @brief Prefork 워커 프로세스 관리자 헤더
+ */
+
+/*
+ * Prefork 워커 프로세스 관리자 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_PREFORK_H
+#define ONV_PREFORK_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define PREFORK_MAX_WORKERS	256	/**< 최대 워커 프로세스 수 */
+#define PREFORK_BACKOFF_MIN	1	/**< 재시작 최소 대기시간(초) */
+#define PREFORK_BACKOFF_MAX	60	/**< 재시작 최대 대기시간(초) */
+#define PREFORK_STOP_TIMEOUT	10	/**< 종료 요청 후 SIGKILL 까지 대기시간(초) */
+
+/**
+ * 워커 함수 타입
+ * listenfd 에서 Accept() 하여 연결을 처리하고, prefork_worker_stopping() 이
+ * 참이 되면 반환한다. 반환값이 0 이면 정상종료, 그 외는 비정상종료로 본다.
+ */
+typedef int (*prefork_worker_fn)(int listenfd, int index, void *arg);
+
+/**
+ * Prefork 설정 구조체
+ * 0 으로 초기화 후 port, worker 만 설정하면 나머지는 기본값을 사용한다.
+ */
+typedef struct prefork_s
+{
+    int port;			/**< 리슨 포트 */
+    int nworkers;		/**< 워커 프로세스 수 (0 이면 온라인 CPU 수) */
+    int daemon;			/**< 0 이 아니면 daemonize() 수행 */
+    int cpu_affinity;		/**< 0 이 아니면 워커를 CPU 에 고정 */
+    int reuseport;		/**< 0 이 아니면 워커마다 SO_REUSEPORT 리슨 소켓 사용 */
+    int backoff_min;		/**< 재시작 최소 대기시간(초) */
+    int backoff_max;		/**< 재시작 최대 대기시간(초) */
+    int stop_timeout;		/**< 워커 종료 대기시간(초) */
+    prefork_worker_fn worker;	/**< 워커 함수 */
+    void *arg;			/**< 워커 함수 인자 */
+    char **argv;		/**< SIGUSR2 업그레이드 시 실행할 새 바이너리 (argv[0] 은 경로) */
+    const char *upgrade_path;	/**< SCM_RIGHTS 로 리슨 소켓을 인계할 Unix 소켓 경로 */
+    int listenfd;		/**< (OUT) 리슨 소켓 (reuseport 이면 첫번째 워커의 소켓) */
+} prefork_t;
+
+int prefork_run(prefork_t *pf);
+int prefork_worker_stopping(void);
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ * @file onvreactor.c
+ * @brief SO_REUSEPORT 멀티 reactor
+ */
+
+/*
+ * SO_REUSEPORT 멀티 reactor
+ *
+ * 쓰레드마다 이벤트 루프와 SO_REUSEPORT 리슨 소켓을 하나씩 두어 커널이
+ * 새 연결을 쓰레드별 accept queue 로 분배하도록 한다. 하나의 리슨 소켓을
+ * 여러 쓰레드가 공유할 때의 queue 경합과 thundering herd 가 없고, 연결은
+ * accept 한 쓰레드(필요 시 고정된 CPU)에서 끝까지 처리된다.
+ *
+ * 프로세스 단위로 나누려면 prefork_t 의 reuseport 를 사용한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvevent.h"
+#include "onvreactor.h"
+
+/**
+ * reactor 쓰레드 구조체
+ */
+typedef struct reactor_s
+{
+    int index;			/**< 쓰레드 번호 */
+    int cpu_affinity;		/**< 0 이 아니면 CPU 고정 */
+    int listenfd;		/**< SO_REUSEPORT 리슨 소켓 */
+    event_loop_t *loop;		/**< 이벤트 루프 */
+    pthread_t tid;		/**< 쓰레드 ID */
+    int running;		/**< 쓰레드가 실행중이면 1 */
+} reactor_t;
+
+struct reactor_group_s
+{
+    int nthreads;		/**< reactor 쓰레드 수 */
+    reactor_t *reactors;	/**< reactor 배열 */
+};
+
+static void *reactor_main(void *arg);
+
+
+/**
+ * @brief reactor 그룹 생성
+ * @param port - 리슨 포트
+ * @param nthreads - reactor 쓰레드 수 (0 이면 온라인 CPU 수)
+ * @param cpu_affinity - 0 이 아니면 쓰레드를 CPU 에 고정
+ * @param cb - 새 연결 콜백 (연결을 accept 한 쓰레드의 루프로 호출됨)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 reactor 그룹 포인터 (사용 후 reactor_group_destroy()),\n
+ *  실패 시 NULL
+ *
+ * 리슨 소켓과 이벤트 루프만 만들고 쓰레드는 reactor_group_start() 에서
+ * 시작한다. 그 전에 reactor_group_loop() 로 루프별 타이머 등을 등록할 수 있다.
+ */
+reactor_group_t *
+reactor_group_create(int port, int nthreads, int cpu_affinity, event_accept_cb cb, void *arg)
+{
+    reactor_group_t *group = NULL;
+    reactor_t *r = NULL;
+    long ncpu;
+    int i;
+
+    ASSERT(cb != NULL);
+
+    if (nthreads <= 0) {
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = ncpu > 0 ? (int) ncpu : 1;
+    }
+    if (nthreads > REACTOR_MAX_THREADS) {
+	nthreads = REACTOR_MAX_THREADS;
+    }
+
+    if ((group = calloc(1, sizeof(reactor_group_t))) == NULL) {
+	return NULL;
+    }
+    if ((group->reactors = calloc(nthreads, sizeof(reactor_t))) == NULL) {
+	free(group);
+	return NULL;
+    }
+    group->nthreads = nthreads;
+    for (i = 0; i < nthreads; i++) {
+	group->reactors[i].listenfd = -1;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+	r = &group->reactors[i];
+	r->index = i;
+	r->cpu_affinity = cpu_affinity;
+
+	if ((r->listenfd = socket_listen_reuseport(port)) < 0) {
+	    Log(ERROR, "reactor[%d]: listen on port %d failed: %s", i, port, strerror(errno));
+	    goto fail;
+	}
+	if ((r->loop = event_loop_create()) == NULL ||
+		event_listen(r->loop, r->listenfd, cb, arg) < 0) {
+	    Log(ERROR, "reactor[%d]: event loop setup failed", i);
+	    goto fail;
+	}
+    }
+
+    return group;
+
+fail:
+    reactor_group_destroy(group);
+    return NULL;
+}
+
+
+/**
+ * @brief reactor 쓰레드 본체
+ */
+static void *
+reactor_main(void *arg)
+{
+    reactor_t *r = arg;
+
+    if (r->cpu_affinity && cpu_pin(r->index) < 0) {
+	Log(WARN, "reactor[%d]: cpu_pin() failed: %s", r->index, strerror(errno));
+    }
+
+    if (event_loop_run(r->loop) < 0) {
+	Log(ERROR, "reactor[%d]: event loop terminated abnormally", r->index);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief reactor 쓰레드 시작
+ * @param group - reactor 그룹
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (이미 시작된 쓰레드는 reactor_group_stop() 으로 종료)
+ */
+int
+reactor_group_start(reactor_group_t *group)
+{
+    int i, result;
+
+    ASSERT(group != NULL);
+
+    for (i = 0; i < group->nthreads; i++) {
+	if (group->reactors[i].running) {
+	    continue;
+	}
+	if ((result = pthread_create(&group->reactors[i].tid, NULL,
+			reactor_main, &group->reactors[i])) != 0) {
+	    Log(ERROR, "reactor[%d]: pthread_create() failed: %s", i, strerror(result));
+	    return -1;
+	}
+	group->reactors[i].running = 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 모든 reactor 쓰레드 종료 및 대기
+ * @param group - reactor 그룹
+ * @return 없음
+ */
+void
+reactor_group_stop(reactor_group_t *group)
+{
+    int i;
+
+    ASSERT(group != NULL);
+
+    for (i = 0; i < group->nthreads; i++) {
+	if (group->reactors[i].running) {
+	    event_loop_stop(group->reactors[i].loop);
+	}
+    }
+    for (i = 0; i < group->nthreads; i++) {
+	if (group->reactors[i].running) {
+	    pthread_join(group->reactors[i].tid, NULL);
+	    group->reactors[i].running = 0;
+	}
+    }
+}
+
+
+/**
+ * @brief reactor 그룹 제거
+ * @param group - reactor 그룹
+ * @return 없음
+ *
+ * 실행중인 쓰레드가 있으면 먼저 종료시키고, 리슨 소켓과 이벤트 루프를
+ * 해제한다. 연결 소켓은 호출자가 close 해야 한다.
+ */
+void
+reactor_group_destroy(reactor_group_t *group)
+{
+    int i;
+
+    if (!group) {
+	return;
+    }
+
+    reactor_group_stop(group);
+    for (i = 0; i < group->nthreads; i++) {
+	event_loop_destroy(group->reactors[i].loop);
+	if (group->reactors[i].listenfd >= 0) {
+	    close(group->reactors[i].listenfd);
+	}
+    }
+    free(group->reactors);
+    free(group);
+}
+
+
+/**
+ * @brief reactor 쓰레드 수
+ * @param group - reactor 그룹
+ * @return 쓰레드 수
+ */
+int
+reactor_group_size(reactor_group_t *group)
+{
+    ASSERT(group != NULL);
+
+    return group->nthreads;
+}
+
+
+/**
+ * @brief \a index 번째 reactor 의 이벤트 루프
+ * @param group - reactor 그룹
+ * @param index - reactor 번호
+ * @return
+ *  성공 시 이벤트 루프 포인터,\n
+ *  범위를 벗어나면 NULL
+ */
+event_loop_t *
+reactor_group_loop(reactor_group_t *group, int index)
+{
+    ASSERT(group != NULL);
+
+    if (index < 0 || index >= group->nthreads) {
+	return NULL;
+    }
+
+    return group->reactors[index].loop;
+}
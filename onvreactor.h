@@ -0,0 +1,36 @@
+/**
+ * @file onvreactor.h
+ * @brief SO_REUSEPORT 멀티 reactor 헤더
+ */
+
+/*
+ * SO_REUSEPORT 멀티 reactor 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_REACTOR_H
+#define ONV_REACTOR_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "onvevent.h"
+
+#define REACTOR_MAX_THREADS	256	/**< 최대 reactor 쓰레드 수 */
+
+typedef struct reactor_group_s reactor_group_t;
+
+reactor_group_t *reactor_group_create(int port, int nthreads, int cpu_affinity,
+	event_accept_cb cb, void *arg);
+int reactor_group_start(reactor_group_t *group);
+void reactor_group_stop(reactor_group_t *group);
+void reactor_group_destroy(reactor_group_t *group);
+int reactor_group_size(reactor_group_t *group);
+event_loop_t *reactor_group_loop(reactor_group_t *group, int index);
+
+#endif
@@ -0,0 +1,654 @@
+/**
+ * @file onvresolv.c
+ * @brief 호스트명 해석 캐시
+ */
+
+/*
+ * 호스트명 해석 캐시
+ *
+ * getaddrinfo() 결과를 TTL 동안 캐시하여 접속할 때마다 DNS/NSS 조회로
+ * 블록되지 않도록 한다. 실패 결과도 짧게 캐시한다.
+ *
+ * resolv_init() 을 호출하면 백그라운드 쓰레드가 만료가 가까운 항목 중
+ * 최근에 사용된 것을 미리 다시 조회하므로, 자주 쓰는 호스트는 조회 지연이
+ * 요청 경로에 나타나지 않는다. 재조회가 실패하면 이전 주소를 계속 쓰되,
+ * 마지막 성공 후 stale_max 가 지나면 주소를 버리고 조회 에러를 돌려준다. resolv_init() 없이도 캐시는 동작하며, 이때는
+ * 만료된 항목을 조회하는 쓰레드가 직접 다시 조회한다.
+ *
+ * 이벤트 루프 쓰레드처럼 블록되면 안되는 곳에서는 resolv_lookup_cached() 로
+ * 캐시만 보고, 없으면 resolv_lookup_async() 로 같은 쓰레드에 조회를 넘긴다.
+ *
+ * 캐시는 getaddrinfo() 를 그대로 쓰므로 /etc/hosts 만 있는 환경에서도 동작한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvresolv.h"
+
+/**
+ * 캐시에 보관하는 주소
+ */
+typedef struct resolv_addr_s
+{
+    int family;
+    int socktype;
+    int protocol;
+    socklen_t addrlen;
+    struct sockaddr_storage addr;
+} resolv_addr_t;
+
+/**
+ * 캐시 항목
+ */
+typedef struct resolv_entry_s
+{
+    char *host;			/**< 호스트명 */
+    char *service;		/**< 서비스명 또는 포트 */
+    int error;			/**< getaddrinfo() 에러 (0 이면 성공) */
+    int naddrs;			/**< 주소 수 */
+    resolv_addr_t addrs[RESOLV_MAX_ADDRS];
+    time_t expire;		/**< 만료 시각 */
+    time_t last_used;		/**< 마지막 조회 시각 */
+    time_t resolved;		/**< 마지막으로 조회에 성공한 시각 */
+    int refreshing;		/**< 백그라운드 재조회 중이면 1 */
+    int dead;			/**< 재조회 중에 목록에서 빠짐 (재조회가 끝나면 해제) */
+    struct resolv_entry_s *next;
+} resolv_entry_t;
+
+/**
+ * resolv_lookup_async() 요청
+ */
+typedef struct resolv_req_s
+{
+    char *host;			/**< 호스트명 */
+    char *service;		/**< 서비스명 또는 포트 (NULL 가능) */
+    resolv_cb cb;		/**< 결과 콜백 */
+    void *arg;			/**< 콜백 인자 */
+    struct resolv_req_s *next;
+} resolv_req_t;
+
+static pthread_mutex_t resolv_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolv_cond = PTHREAD_COND_INITIALIZER;
+static resolv_entry_t *resolv_table[RESOLV_HASH_SIZE];
+static int resolv_ttl = RESOLV_TTL;
+static int resolv_neg_ttl = RESOLV_NEG_TTL;
+static int resolv_stale_max = RESOLV_STALE_MAX;
+static resolv_req_t *resolv_req_head = NULL;	/* 비동기 조회 요청 (FIFO) */
+static resolv_req_t *resolv_req_tail = NULL;
+static pthread_t resolv_tid;
+static int resolv_running = 0;
+
+static unsigned int hash_key(const char *host, const char *service);
+static resolv_entry_t *find_entry(unsigned int h, const char *host, const char *service);
+static void free_req(resolv_req_t *req);
+static int start_thread(void);
+static void resolve(resolv_entry_t *entry, const char *host, const char *service);
+static struct addrinfo *copy_result(const resolv_entry_t *entry);
+static void *refresh_main(void *arg);
+
+
+/**
+ * @brief host, service 해시
+ */
+static unsigned int
+hash_key(const char *host, const char *service)
+{
+    unsigned int h = 5381;
+
+    while (*host) {
+	h = h * 33 + (unsigned char) *host++;
+    }
+    h = h * 33 + ':';
+    while (service && *service) {
+	h = h * 33 + (unsigned char) *service++;
+    }
+
+    return h % RESOLV_HASH_SIZE;
+}
+
+
+/**
+ * @brief 캐시 항목 찾기 (잠금 상태에서 호출)
+ * @return
+ *  있으면 항목,\n
+ *  없으면 NULL
+ */
+static resolv_entry_t *
+find_entry(unsigned int h, const char *host, const char *service)
+{
+    resolv_entry_t *entry = NULL;
+
+    for (entry = resolv_table[h]; entry; entry = entry->next) {
+	if (strcmp(entry->host, host) == 0 &&
+		strcmp(entry->service, service ? service : "") == 0) {
+	    break;
+	}
+    }
+
+    return entry;
+}
+
+
+/**
+ * @brief getaddrinfo() 로 조회하여 \a entry 에 결과 저장 (잠금 없이 호출)
+ * @param entry - (OUT) 결과를 저장할 항목
+ * @param host - 호스트명
+ * @param service - 서비스명 또는 포트
+ * @return 없음
+ *
+ * error, naddrs, addrs, expire 만 채운다.
+ */
+static void
+resolve(resolv_entry_t *entry, const char *host, const char *service)
+{
+    struct addrinfo hints, *res = NULL, *ai = NULL;
+    int n = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    entry->error = getaddrinfo(host, service, &hints, &res);
+    if (entry->error == 0) {
+	for (ai = res; ai && n < RESOLV_MAX_ADDRS; ai = ai->ai_next) {
+	    if (ai->ai_addrlen > sizeof(struct sockaddr_storage)) {
+		continue;
+	    }
+	    entry->addrs[n].family = ai->ai_family;
+	    entry->addrs[n].socktype = ai->ai_socktype;
+	    entry->addrs[n].protocol = ai->ai_protocol;
+	    entry->addrs[n].addrlen = ai->ai_addrlen;
+	    memcpy(&entry->addrs[n].addr, ai->ai_addr, ai->ai_addrlen);
+	    n++;
+	}
+	freeaddrinfo(res);
+	if (n == 0) {
+	    entry->error = EAI_NONAME;
+	}
+    }
+
+    entry->naddrs = n;
+    entry->expire = time(NULL) + (entry->error ? resolv_neg_ttl : resolv_ttl);
+}
+
+
+/**
+ * @brief 캐시 항목을 addrinfo 리스트로 복사 (잠금 상태에서 호출)
+ * @param entry - 캐시 항목
+ * @return
+ *  성공 시 addrinfo 리스트 (resolv_free() 로 해제),\n
+ *  실패 시 NULL
+ *
+ * 리스트와 주소를 한번에 할당하므로 free 한번으로 해제된다.
+ */
+static struct addrinfo *
+copy_result(const resolv_entry_t *entry)
+{
+    struct addrinfo *ai = NULL;
+    struct sockaddr_storage *ss = NULL;
+    int i;
+
+    ai = calloc(1, entry->naddrs * (sizeof(struct addrinfo) + sizeof(struct sockaddr_storage)));
+    if (!ai) {
+	return NULL;
+    }
+    ss = (struct sockaddr_storage *) (ai + entry->naddrs);
+
+    for (i = 0; i < entry->naddrs; i++) {
+	ai[i].ai_family = entry->addrs[i].family;
+	ai[i].ai_socktype = entry->addrs[i].socktype;
+	ai[i].ai_protocol = entry->addrs[i].protocol;
+	ai[i].ai_addrlen = entry->addrs[i].addrlen;
+	memcpy(&ss[i], &entry->addrs[i].addr, entry->addrs[i].addrlen);
+	ai[i].ai_addr = (struct sockaddr *) &ss[i];
+	ai[i].ai_next = (i + 1 < entry->naddrs) ? &ai[i + 1] : NULL;
+    }
+
+    return ai;
+}
+
+
+/**
+ * @brief 캐시를 사용하는 getaddrinfo()
+ * @param host - 호스트명 또는 IP
+ * @param service - 서비스명 또는 포트
+ * @param res - (OUT) 주소 리스트 (사용 후 resolv_free(), freeaddrinfo() 사용 금지)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 getaddrinfo() 에러 코드 (EAI_*)
+ *
+ * SOCK_STREAM 주소만 조회한다. 만료된 항목은 호출한 쓰레드가 다시 조회하며,
+ * 그동안 같은 항목의 다른 조회는 블록되지 않고 각자 조회한다.
+ */
+int
+resolv_lookup(const char *host, const char *service, struct addrinfo **res)
+{
+    resolv_entry_t *entry = NULL, fresh;
+    unsigned int h;
+    time_t now;
+    int error;
+
+    ASSERT(host != NULL && res != NULL);
+
+    *res = NULL;
+    h = hash_key(host, service);
+    now = time(NULL);
+
+    pthread_mutex_lock(&resolv_lock);
+    entry = find_entry(h, host, service);
+    if (entry && entry->expire > now) {
+	entry->last_used = now;
+	if ((error = entry->error) == 0 && (*res = copy_result(entry)) == NULL) {
+	    error = EAI_MEMORY;
+	}
+	pthread_mutex_unlock(&resolv_lock);
+	return error;
+    }
+    pthread_mutex_unlock(&resolv_lock);
+
+    /* 캐시에 없거나 만료됨: 잠금 없이 조회 */
+    memset(&fresh, 0, sizeof(fresh));
+    resolve(&fresh, host, service);
+
+    pthread_mutex_lock(&resolv_lock);
+    entry = find_entry(h, host, service);
+    if (!entry && (entry = calloc(1, sizeof(resolv_entry_t))) != NULL) {
+	entry->host = strdup(host);
+	entry->service = strdup(service ? service : "");
+	if (!entry->host || !entry->service) {
+	    free(entry->host);
+	    free(entry->service);
+	    free(entry);
+	    entry = NULL;
+	}
+	else {
+	    entry->next = resolv_table[h];
+	    resolv_table[h] = entry;
+	}
+    }
+    if (entry) {
+	entry->error = fresh.error;
+	entry->naddrs = fresh.naddrs;
+	memcpy(entry->addrs, fresh.addrs, sizeof(resolv_addr_t) * fresh.naddrs);
+	entry->expire = fresh.expire;
+	entry->last_used = now;
+	if (fresh.error == 0) {
+	    entry->resolved = now;
+	}
+    }
+    if ((error = fresh.error) == 0 && (*res = copy_result(&fresh)) == NULL) {
+	error = EAI_MEMORY;
+    }
+    pthread_mutex_unlock(&resolv_lock);
+
+    return error;
+}
+
+
+/**
+ * @brief 캐시만 조회 (블록되지 않음)
+ * @param host - 호스트명 또는 IP
+ * @param service - 서비스명 또는 포트
+ * @param res - (OUT) 주소 리스트 (사용 후 resolv_free())
+ * @return
+ *  캐시에 있으면 resolv_lookup() 과 같음,\n
+ *  없거나 만료되었으면 EAI_AGAIN
+ *
+ * EAI_AGAIN 이면 resolv_lookup_async() 로 조회한다. 실패 결과로 캐시된
+ * EAI_AGAIN 과 구별되지 않지만, 그때도 비동기 조회는 캐시에서 바로 끝난다.
+ */
+int
+resolv_lookup_cached(const char *host, const char *service, struct addrinfo **res)
+{
+    resolv_entry_t *entry = NULL;
+    time_t now;
+    int error = EAI_AGAIN;
+
+    ASSERT(host != NULL && res != NULL);
+
+    *res = NULL;
+    now = time(NULL);
+
+    pthread_mutex_lock(&resolv_lock);
+    entry = find_entry(hash_key(host, service), host, service);
+    if (entry && entry->expire > now) {
+	entry->last_used = now;
+	if ((error = entry->error) == 0 && (*res = copy_result(entry)) == NULL) {
+	    error = EAI_MEMORY;
+	}
+    }
+    pthread_mutex_unlock(&resolv_lock);
+
+    return error;
+}
+
+
+/**
+ * @brief 재조회 쓰레드에서 resolv_lookup() 후 콜백 호출
+ * @param host - 호스트명 또는 IP
+ * @param service - 서비스명 또는 포트
+ * @param cb - 결과 콜백 (재조회 쓰레드에서 호출)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (\a cb 는 호출되지 않음)
+ *
+ * 재조회 쓰레드가 없으면 기본 설정으로 시작한다. 요청은 순서대로 하나씩
+ * 처리되며, resolv_shutdown() 까지 처리되지 못한 요청은 EAI_AGAIN 으로
+ * resolv_shutdown() 을 호출한 쓰레드에서 콜백된다.
+ */
+int
+resolv_lookup_async(const char *host, const char *service, resolv_cb cb, void *arg)
+{
+    resolv_req_t *req = NULL;
+
+    ASSERT(host != NULL && cb != NULL);
+
+    if ((req = calloc(1, sizeof(resolv_req_t))) == NULL ||
+	    (req->host = strdup(host)) == NULL ||
+	    (service && (req->service = strdup(service)) == NULL)) {
+	Log(ERROR, "resolv: malloc() failed: %s", strerror(errno));
+	free_req(req);
+	return -1;
+    }
+    req->cb = cb;
+    req->arg = arg;
+
+    pthread_mutex_lock(&resolv_lock);
+    if (start_thread() < 0) {
+	pthread_mutex_unlock(&resolv_lock);
+	free_req(req);
+	return -1;
+    }
+    if (resolv_req_tail) {
+	resolv_req_tail->next = req;
+    }
+    else {
+	resolv_req_head = req;
+    }
+    resolv_req_tail = req;
+    pthread_cond_signal(&resolv_cond);
+    pthread_mutex_unlock(&resolv_lock);
+
+    return 0;
+}
+
+
+/**
+ * @brief 비동기 조회 요청 해제
+ */
+static void
+free_req(resolv_req_t *req)
+{
+    if (req) {
+	free(req->host);
+	free(req->service);
+	free(req);
+    }
+}
+
+
+/**
+ * @brief resolv_lookup() 결과 해제
+ * @param res - resolv_lookup() 이 반환한 주소 리스트
+ * @return 없음
+ */
+void
+resolv_free(struct addrinfo *res)
+{
+    free(res);
+}
+
+
+/**
+ * @brief 캐시 전체 삭제
+ * @param 없음
+ * @return 없음
+ */
+void
+resolv_flush(void)
+{
+    resolv_entry_t *entry = NULL, *next = NULL;
+    int i;
+
+    pthread_mutex_lock(&resolv_lock);
+    for (i = 0; i < RESOLV_HASH_SIZE; i++) {
+	for (entry = resolv_table[i]; entry; entry = next) {
+	    next = entry->next;
+	    if (entry->refreshing) {
+		/* 재조회중인 항목은 쓰레드가 참조하므로 쓰레드가 해제한다 */
+		entry->dead = 1;
+		entry->next = NULL;
+		continue;
+	    }
+	    free(entry->host);
+	    free(entry->service);
+	    free(entry);
+	}
+	resolv_table[i] = NULL;
+    }
+    pthread_mutex_unlock(&resolv_lock);
+}
+
+
+/**
+ * @brief 백그라운드 재조회 쓰레드
+ *
+ * resolv_lookup_async() 요청을 먼저 처리하고, 1초마다 만료까지 TTL 의 1/5 이하로 남은 항목 중 마지막 TTL 동안 사용된
+ * 것을 다시 조회한다. 사용되지 않는 항목은 만료 후 TTL 이 더 지나면 삭제한다.
+ */
+static void *
+refresh_main(void *arg)
+{
+    resolv_entry_t *entry = NULL, **pp = NULL, fresh;
+    resolv_req_t *req = NULL;
+    struct addrinfo *res = NULL;
+    struct timespec ts;
+    char *host = NULL, *service = NULL;
+    time_t now;
+    int i, found, error;
+
+    (void) arg;
+
+    pthread_mutex_lock(&resolv_lock);
+    while (resolv_running) {
+	if ((req = resolv_req_head) != NULL) {
+	    if ((resolv_req_head = req->next) == NULL) {
+		resolv_req_tail = NULL;
+	    }
+	    pthread_mutex_unlock(&resolv_lock);
+
+	    error = resolv_lookup(req->host, req->service, &res);
+	    req->cb(error, res, req->arg);
+	    free_req(req);
+
+	    pthread_mutex_lock(&resolv_lock);
+	    continue;
+	}
+
+	now = time(NULL);
+	found = 0;
+	for (i = 0; i < RESOLV_HASH_SIZE && !found; i++) {
+	    pp = &resolv_table[i];
+	    while ((entry = *pp) != NULL) {
+		/* 오래 사용되지 않은 항목 삭제 */
+		if (!entry->refreshing && entry->expire + resolv_ttl <= now &&
+			entry->last_used + resolv_ttl <= now) {
+		    *pp = entry->next;
+		    free(entry->host);
+		    free(entry->service);
+		    free(entry);
+		    continue;
+		}
+		if (!entry->refreshing && entry->error == 0 &&
+			entry->expire - now <= resolv_ttl / 5 &&
+			now - entry->last_used < resolv_ttl) {
+		    found = 1;
+		    break;
+		}
+		pp = &entry->next;
+	    }
+	}
+
+	if (!found) {
+	    ts.tv_sec = now + 1;
+	    ts.tv_nsec = 0;
+	    pthread_cond_timedwait(&resolv_cond, &resolv_lock, &ts);
+	    continue;
+	}
+
+	/* 잠금을 풀고 조회 */
+	entry->refreshing = 1;
+	host = strdup(entry->host);
+	service = strdup(entry->service);
+	pthread_mutex_unlock(&resolv_lock);
+
+	memset(&fresh, 0, sizeof(fresh));
+	if (host && service) {
+	    resolve(&fresh, host, service[0] ? service : NULL);
+	}
+	free(host);
+	free(service);
+
+	pthread_mutex_lock(&resolv_lock);
+	entry->refreshing = 0;
+	if (entry->dead) {
+	    /* 조회하는 동안 resolv_flush() 됨 */
+	    free(entry->host);
+	    free(entry->service);
+	    free(entry);
+	    continue;
+	}
+	if (fresh.error == 0 && fresh.naddrs > 0) {
+	    entry->error = 0;
+	    entry->naddrs = fresh.naddrs;
+	    memcpy(entry->addrs, fresh.addrs, sizeof(resolv_addr_t) * fresh.naddrs);
+	    entry->expire = fresh.expire;
+	    entry->resolved = time(NULL);
+	}
+	else if (time(NULL) - entry->resolved >= resolv_stale_max) {
+	    /* 계속 실패: 이전 주소를 버리고 호출자에게 에러를 돌려줌 */
+	    Log(WARN, "resolv: refresh of %s failed: %s, stale addresses dropped",
+		    entry->host, gai_strerror(fresh.error ? fresh.error : EAI_NONAME));
+	    entry->error = fresh.error ? fresh.error : EAI_NONAME;
+	    entry->naddrs = 0;
+	    entry->expire = time(NULL) + resolv_neg_ttl;
+	}
+	else {
+	    /* 일시적인 조회 실패: 기존 주소를 음수 TTL 동안 더 사용 */
+	    Log(WARN, "resolv: refresh of %s failed: %s", entry->host, gai_strerror(fresh.error));
+	    entry->expire = time(NULL) + resolv_neg_ttl;
+	}
+    }
+    pthread_mutex_unlock(&resolv_lock);
+
+    return NULL;
+}
+
+
+/**
+ * @brief 재조회 쓰레드가 없으면 시작 (잠금 상태에서 호출)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+static int
+start_thread(void)
+{
+    int result;
+
+    if (resolv_running) {
+	return 0;
+    }
+    if ((result = pthread_create(&resolv_tid, NULL, refresh_main, NULL)) != 0) {
+	Log(ERROR, "resolv: pthread_create() failed: %s", strerror(result));
+	errno = result;
+	return -1;
+    }
+    resolv_running = 1;
+
+    return 0;
+}
+
+
+/**
+ * @brief 캐시 설정 및 백그라운드 재조회 쓰레드 시작
+ * @param ttl - 캐시 유효시간(초, 0 이면 기본값)
+ * @param neg_ttl - 실패 결과 캐시 유효시간(초, 0 이면 기본값)
+ * @param stale_max - 재조회가 실패할 때 이전 주소를 쓰는 최대 시간
+ *  (초, 마지막 성공부터, 0 이면 기본값)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+resolv_init(int ttl, int neg_ttl, int stale_max)
+{
+    int result;
+
+    pthread_mutex_lock(&resolv_lock);
+    resolv_ttl = ttl > 0 ? ttl : RESOLV_TTL;
+    resolv_neg_ttl = neg_ttl > 0 ? neg_ttl : RESOLV_NEG_TTL;
+    resolv_stale_max = stale_max > 0 ? stale_max : RESOLV_STALE_MAX;
+    result = start_thread();
+    pthread_mutex_unlock(&resolv_lock);
+
+    return result;
+}
+
+
+/**
+ * @brief 백그라운드 재조회 쓰레드 종료 및 캐시 삭제
+ * @param 없음
+ * @return 없음
+ */
+void
+resolv_shutdown(void)
+{
+    resolv_req_t *req = NULL, *next = NULL;
+    pthread_t tid;
+    int running;
+
+    pthread_mutex_lock(&resolv_lock);
+    running = resolv_running;
+    resolv_running = 0;
+    tid = resolv_tid;
+    pthread_cond_signal(&resolv_cond);
+    pthread_mutex_unlock(&resolv_lock);
+
+    if (running) {
+	pthread_join(tid, NULL);
+    }
+
+    /* 처리되지 못한 비동기 조회는 실패로 알림 (기다리는 쪽이 멈추지 않도록) */
+    pthread_mutex_lock(&resolv_lock);
+    req = resolv_req_head;
+    resolv_req_head = resolv_req_tail = NULL;
+    pthread_mutex_unlock(&resolv_lock);
+    for (; req; req = next) {
+	next = req->next;
+	req->cb(EAI_AGAIN, NULL, req->arg);
+	free_req(req);
+    }
+
+    resolv_flush();
+}
@@ -0,0 +1,44 @@
+/**
+ * @file onvresolv.h
+ * @brief 호스트명 해석 캐시 헤더
+ */
+
+/*
+ * 호스트명 해석 캐시 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_RESOLV_H
+#define ONV_RESOLV_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <netdb.h>
+
+#define RESOLV_TTL		60	/**< 기본 캐시 유효시간(초) */
+#define RESOLV_NEG_TTL		5	/**< 기본 실패 결과 캐시 유효시간(초) */
+#define RESOLV_STALE_MAX	300	/**< 재조회 실패 시 이전 주소를 쓰는 최대 시간(초, 마지막 성공부터) */
+#define RESOLV_MAX_ADDRS	16	/**< 항목당 보관하는 최대 주소 수 */
+#define RESOLV_HASH_SIZE	256	/**< 해시 버킷 수 */
+
+/**
+ * resolv_lookup_async() 결과 콜백 (재조회 쓰레드에서 호출)
+ * \a error 는 resolv_lookup() 반환값, \a res 는 콜백이 resolv_free() 한다.
+ */
+typedef void (*resolv_cb)(int error, struct addrinfo *res, void *arg);
+
+int resolv_init(int ttl, int neg_ttl, int stale_max);
+void resolv_shutdown(void);
+int resolv_lookup(const char *host, const char *service, struct addrinfo **res);
+int resolv_lookup_cached(const char *host, const char *service, struct addrinfo **res);
+int resolv_lookup_async(const char *host, const char *service, resolv_cb cb, void *arg);
+void resolv_free(struct addrinfo *res);
+void resolv_flush(void);
+
+#endif
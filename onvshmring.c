@@ -0,0 +1,622 @@
+/**
+ * @file onvshmring.c
+ * @brief 프로세스간 공유메모리 메시지 링 (SPSC/MPSC)
+ */
+
+/*
+ * 프로세스간 공유메모리 메시지 링 (SPSC/MPSC)
+ *
+ * daemonize()/prefork 로 나뉜 프로세스 사이에서 Unix 소켓을 쓰면 메시지마다
+ * 시스템콜과 복사가 생긴다. 이 링은 memfd (또는 shm_open) 공유메모리에
+ * 가변길이 메시지를 lock-free 로 쌓고, 소비자가 대기중일 때만 futex/eventfd
+ * 로 깨운다. 소비자가 바쁘게 처리하는 동안에는 시스템콜이 없다.
+ *
+ * 메시지는 8 바이트 헤더(길이 + commit 비트) 뒤에 8 바이트 정렬로 놓이며
+ * 링 끝에서 잘리지 않도록 필요하면 padding 레코드를 넣는다.
+ *  - 생산자: shmring_reserve() 로 자리를 잡아 직접 쓰고 shmring_commit().
+ *    SHMRING_MPSC 이면 head 를 CAS 로 예약하므로 여러 프로세스가 동시에
+ *    쓸 수 있다. 공간이 없으면 기다리지 않고 EAGAIN 으로 실패한다.
+ *  - 소비자(하나): shmring_peek() 로 링 안의 메시지를 복사 없이 보고
+ *    shmring_release(). 해제한 영역은 0 으로 지워서 다음 바퀴의 생산자가
+ *    commit 하기 전에는 비어있는 것으로 보이게 한다.
+ *  - 대기: shmring_wait() 는 futex 로 잠든다. 이벤트 루프에서는
+ *    shmring_eventfd() 를 event_add() 하고, 콜백에서 비울 때까지 처리한 뒤
+ *    shmring_arm() 이 0 을 반환하면 다시 기다린다.
+ *
+ * memfd 링은 fork() 로 상속하거나 onvunix 의 unix_send_fds() 로 fd 와
+ * eventfd 를 넘겨서 shmring_attach_fd() 로 붙는다. 이름으로 붙은
+ * (shmring_attach()) 생산자는 eventfd 가 없으므로 futex 로만 깨운다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvshmring.h"
+
+#define SHMRING_MAGIC	0x4f4e5652	/* "ONVR" */
+#define SHMRING_LINE	64		/* cache line */
+#define SHMRING_SPIN	256		/* futex 로 잠들기 전 확인 횟수 */
+
+#define REC_HDR		sizeof(uint64_t)
+#define REC_COMMIT	((uint64_t) 1 << 32)
+#define REC_PAD		((uint64_t) 1 << 33)
+#define REC_LEN(w)	((size_t) ((w) & 0xffffffffULL))
+#define REC_ALIGN(n)	(((n) + 7) & ~((uint64_t) 7))
+
+/**
+ * 공유메모리 앞부분의 링 헤더 (생산자/소비자 변수는 각자 cache line)
+ */
+typedef struct shmring_hdr_s
+{
+    uint32_t magic;
+    uint32_t flags;			/**< SHMRING_SPSC, SHMRING_MPSC */
+    uint64_t size;			/**< 데이터 영역 크기 (2의 거듭제곱) */
+    char pad0[SHMRING_LINE - 16];
+    uint64_t head;			/**< 생산자 예약 위치 */
+    char pad1[SHMRING_LINE - 8];
+    uint64_t tail;			/**< 소비자 위치 */
+    char pad2[SHMRING_LINE - 8];
+    uint32_t waiting;			/**< 소비자가 대기중 */
+    uint32_t wakeup;			/**< futex 워드 */
+    char pad3[SHMRING_LINE - 8];
+} shmring_hdr_t;
+
+struct shmring_s
+{
+    shmring_hdr_t *hdr;
+    char *data;			/**< 데이터 영역 */
+    size_t mapsize;
+    uint64_t mask;
+    int fd;			/**< memfd 또는 shm fd */
+    int efd;			/**< eventfd (없으면 -1) */
+    size_t cur;			/**< 소비자가 peek 한 레코드 크기 */
+};
+
+static shmring_t *ring_map(int fd, int efd, size_t size, int init, int flags);
+static int ring_empty(shmring_t *r);
+static void ring_notify(shmring_t *r);
+static int futex_wait(uint32_t *addr, uint32_t val, int msec);
+static int futex_wake(uint32_t *addr);
+
+
+static int
+futex_wait(uint32_t *addr, uint32_t val, int msec)
+{
+    struct timespec ts, *tp = NULL;
+
+    if (msec >= 0) {
+	ts.tv_sec = msec / 1000;
+	ts.tv_nsec = (long) (msec % 1000) * 1000000L;
+	tp = &ts;
+    }
+
+    /* 프로세스간 공유이므로 FUTEX_PRIVATE_FLAG 를 쓰지 않음 */
+    return (int) syscall(SYS_futex, addr, FUTEX_WAIT, val, tp, NULL, 0);
+}
+
+
+static int
+futex_wake(uint32_t *addr)
+{
+    return (int) syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+
+/**
+ * @brief 공유메모리를 매핑하고 핸들 생성
+ * @param init - 1 이면 헤더 초기화 (생성), 0 이면 검증 (attach)
+ */
+static shmring_t *
+ring_map(int fd, int efd, size_t size, int init, int flags)
+{
+    shmring_t *r = NULL;
+    void *p = NULL;
+    size_t mapsize = sizeof(shmring_hdr_t) + size;
+
+    if ((p = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+	Log(ERROR, "shmring mmap(%zu): %s", mapsize, strerror(errno));
+	return NULL;
+    }
+
+    if ((r = calloc(1, sizeof(shmring_t))) == NULL) {
+	munmap(p, mapsize);
+	return NULL;
+    }
+
+    r->hdr = (shmring_hdr_t *) p;
+    r->data = (char *) p + sizeof(shmring_hdr_t);
+    r->mapsize = mapsize;
+    r->mask = size - 1;
+    r->fd = fd;
+    r->efd = efd;
+
+    if (init) {
+	r->hdr->flags = (uint32_t) flags;
+	r->hdr->size = size;
+	__atomic_store_n(&r->hdr->magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+    }
+    else if (__atomic_load_n(&r->hdr->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC ||
+	    r->hdr->size != size) {
+	Log(ERROR, "shmring: invalid ring header");
+	munmap(p, mapsize);
+	free(r);
+	errno = EINVAL;
+	return NULL;
+    }
+
+    return r;
+}
+
+
+/**
+ * @brief 공유메모리 링 생성
+ * @param name - shm_open() 이름 ("/name"), NULL 이면 익명 memfd
+ * @param size - 데이터 영역 크기 (2의 거듭제곱으로 올림)
+ * @param flags - SHMRING_SPSC 또는 SHMRING_MPSC
+ * @return
+ *  성공 시 링 핸들,\n
+ *  실패 시 NULL
+ *
+ * 같은 이름의 이전 링은 지우고 새로 만든다. 이름은 상대가 붙은 뒤
+ * shm_unlink() 로 지워도 된다.
+ */
+shmring_t *
+shmring_create(const char *name, size_t size, int flags)
+{
+    shmring_t *r = NULL;
+    size_t n = SHMRING_MIN_SIZE;
+    int fd, efd, err;
+
+    while (n < size && n < ((size_t) 1 << 31)) {
+	n <<= 1;
+    }
+
+    if (name) {
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    }
+    else {
+	fd = memfd_create("shmring", MFD_CLOEXEC);
+    }
+    if (fd < 0) {
+	Log(ERROR, "shmring %s: %s", name ? name : "memfd", strerror(errno));
+	return NULL;
+    }
+
+    if (ftruncate(fd, (off_t) (sizeof(shmring_hdr_t) + n)) < 0 ||
+	    (efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+	err = errno;
+	close(fd);
+	errno = err;
+	return NULL;
+    }
+
+    if ((r = ring_map(fd, efd, n, 1, flags)) == NULL) {
+	close(efd);
+	close(fd);
+	return NULL;
+    }
+
+    return r;
+}
+
+
+/**
+ * @brief 이름으로 만든 링에 붙음
+ * @param name - shmring_create() 에 준 이름
+ * @return
+ *  성공 시 링 핸들,\n
+ *  실패 시 NULL
+ */
+shmring_t *
+shmring_attach(const char *name)
+{
+    shmring_t *r = NULL;
+    int fd;
+
+    ASSERT(name != NULL);
+
+    if ((fd = shm_open(name, O_RDWR | O_CLOEXEC, 0)) < 0) {
+	return NULL;
+    }
+    if ((r = shmring_attach_fd(fd, -1)) == NULL) {
+	close(fd);
+    }
+
+    return r;
+}
+
+
+/**
+ * @brief 넘겨받은 fd 로 링에 붙음
+ * @param fd - shmring_fd() (unix_recv_fds() 등으로 받은 것)
+ * @param efd - shmring_eventfd(), 없으면 -1
+ * @return
+ *  성공 시 링 핸들 (\a fd, \a efd 는 핸들이 소유),\n
+ *  실패 시 NULL
+ */
+shmring_t *
+shmring_attach_fd(int fd, int efd)
+{
+    struct stat st;
+    size_t size;
+
+    if (fstat(fd, &st) < 0) {
+	return NULL;
+    }
+    if ((size_t) st.st_size <= sizeof(shmring_hdr_t)) {
+	errno = EINVAL;
+	return NULL;
+    }
+    size = (size_t) st.st_size - sizeof(shmring_hdr_t);
+    if (size < SHMRING_MIN_SIZE || (size & (size - 1)) != 0) {
+	errno = EINVAL;
+	return NULL;
+    }
+
+    return ring_map(fd, efd, size, 0, 0);
+}
+
+
+/**
+ * @brief 링 핸들 닫기 (공유메모리는 마지막 사용자가 닫을 때 해제)
+ * @param r - 링 핸들
+ * @return 없음
+ */
+void
+shmring_close(shmring_t *r)
+{
+    if (r == NULL) {
+	return;
+    }
+
+    munmap(r->hdr, r->mapsize);
+    close(r->fd);
+    if (r->efd >= 0) {
+	close(r->efd);
+    }
+    free(r);
+}
+
+
+/**
+ * @brief 공유메모리 fd (다른 프로세스에 넘길 때)
+ */
+int
+shmring_fd(const shmring_t *r)
+{
+    return r->fd;
+}
+
+
+/**
+ * @brief 소비자 깨우기용 eventfd (없으면 -1)
+ */
+int
+shmring_eventfd(const shmring_t *r)
+{
+    return r->efd;
+}
+
+
+/**
+ * @brief 보낼 수 있는 최대 메시지 크기
+ */
+size_t
+shmring_max_msg(const shmring_t *r)
+{
+    return (size_t) (r->hdr->size / 2 - REC_HDR);
+}
+
+
+/**
+ * @brief 메시지 자리 예약 (생산자)
+ * @param r - 링 핸들
+ * @param len - 메시지 길이
+ * @return
+ *  성공 시 메시지를 쓸 위치 (shmring_commit() 해야 소비자에게 보임),\n
+ *  실패 시 NULL (공간 부족 EAGAIN, 너무 큰 메시지 EMSGSIZE)
+ */
+void *
+shmring_reserve(shmring_t *r, size_t len)
+{
+    shmring_hdr_t *h = r->hdr;
+    uint64_t head, tail, off, pad, need;
+    uint64_t *rec = NULL;
+
+    if (len == 0 || len > shmring_max_msg(r)) {
+	errno = EMSGSIZE;
+	return NULL;
+    }
+
+    need = REC_ALIGN(REC_HDR + len);
+    head = __atomic_load_n(&h->head, __ATOMIC_RELAXED);
+    while (1) {
+	tail = __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+	off = head & r->mask;
+	/* 링 끝에서 잘리면 남은 부분을 padding 으로 채우고 처음부터 */
+	pad = (h->size - off < need) ? h->size - off : 0;
+	if (head + pad + need - tail > h->size) {
+	    errno = EAGAIN;
+	    return NULL;
+	}
+	if (!(h->flags & SHMRING_MPSC)) {
+	    __atomic_store_n(&h->head, head + pad + need, __ATOMIC_RELAXED);
+	    break;
+	}
+	if (__atomic_compare_exchange_n(&h->head, &head, head + pad + need, 1,
+		    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	    break;
+	}
+    }
+
+    if (pad) {
+	rec = (uint64_t *) (r->data + off);
+	__atomic_store_n(rec, REC_COMMIT | REC_PAD | pad, __ATOMIC_RELEASE);
+	head += pad;
+    }
+
+    rec = (uint64_t *) (r->data + (head & r->mask));
+    __atomic_store_n(rec, (uint64_t) len, __ATOMIC_RELAXED);
+
+    return rec + 1;
+}
+
+
+/**
+ * @brief 소비자가 대기중이면 깨움
+ */
+static void
+ring_notify(shmring_t *r)
+{
+    shmring_hdr_t *h = r->hdr;
+    uint64_t one = 1;
+
+    /* commit 저장과 waiting 읽기 사이의 순서 보장 (shmring_arm() 과 짝) */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&h->waiting, __ATOMIC_RELAXED) == 0 ||
+	    __atomic_exchange_n(&h->waiting, 0, __ATOMIC_SEQ_CST) == 0) {
+	return;
+    }
+
+    __atomic_add_fetch(&h->wakeup, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&h->wakeup);
+    if (r->efd >= 0 && write(r->efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+	Log(WARN, "shmring eventfd write: %s", strerror(errno));
+    }
+}
+
+
+/**
+ * @brief 예약한 메시지를 소비자에게 공개 (생산자)
+ * @param r - 링 핸들
+ * @param p - shmring_reserve() 가 반환한 위치
+ * @return 없음
+ */
+void
+shmring_commit(shmring_t *r, void *p)
+{
+    uint64_t *rec = (uint64_t *) p - 1;
+
+    __atomic_store_n(rec, __atomic_load_n(rec, __ATOMIC_RELAXED) | REC_COMMIT, __ATOMIC_RELEASE);
+    ring_notify(r);
+}
+
+
+/**
+ * @brief 메시지 복사해서 보내기 (생산자)
+ * @param r - 링 핸들
+ * @param data - 메시지
+ * @param len - 메시지 길이
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (EAGAIN, EMSGSIZE)
+ */
+int
+shmring_send(shmring_t *r, const void *data, size_t len)
+{
+    void *p = NULL;
+
+    if ((p = shmring_reserve(r, len)) == NULL) {
+	return -1;
+    }
+    memcpy(p, data, len);
+    shmring_commit(r, p);
+
+    return 0;
+}
+
+
+static int
+ring_empty(shmring_t *r)
+{
+    uint64_t tail = __atomic_load_n(&r->hdr->tail, __ATOMIC_RELAXED);
+    uint64_t *rec = (uint64_t *) (r->data + (tail & r->mask));
+
+    return (__atomic_load_n(rec, __ATOMIC_ACQUIRE) & REC_COMMIT) == 0;
+}
+
+
+/**
+ * @brief 다음 메시지 보기 (소비자, 복사 없음)
+ * @param r - 링 핸들
+ * @param len - (OUT) 메시지 길이
+ * @return
+ *  메시지가 있으면 링 안의 메시지 위치 (shmring_release() 전까지 유효),\n
+ *  없으면 NULL
+ */
+void *
+shmring_peek(shmring_t *r, size_t *len)
+{
+    shmring_hdr_t *h = r->hdr;
+    uint64_t tail, w;
+    uint64_t *rec = NULL;
+
+    ASSERT(len != NULL);
+
+    while (1) {
+	tail = __atomic_load_n(&h->tail, __ATOMIC_RELAXED);
+	rec = (uint64_t *) (r->data + (tail & r->mask));
+	w = __atomic_load_n(rec, __ATOMIC_ACQUIRE);
+	if ((w & REC_COMMIT) == 0) {
+	    return NULL;
+	}
+	if ((w & REC_PAD) == 0) {
+	    break;
+	}
+	memset(rec, 0, REC_LEN(w));
+	__atomic_store_n(&h->tail, tail + REC_LEN(w), __ATOMIC_RELEASE);
+    }
+
+    *len = REC_LEN(w);
+    r->cur = (size_t) REC_ALIGN(REC_HDR + REC_LEN(w));
+
+    return rec + 1;
+}
+
+
+/**
+ * @brief shmring_peek() 한 메시지 해제 (소비자)
+ * @param r - 링 핸들
+ * @return 없음
+ */
+void
+shmring_release(shmring_t *r)
+{
+    shmring_hdr_t *h = r->hdr;
+    uint64_t tail = __atomic_load_n(&h->tail, __ATOMIC_RELAXED);
+
+    if (r->cur == 0) {
+	return;
+    }
+
+    memset(r->data + (tail & r->mask), 0, r->cur);
+    __atomic_store_n(&h->tail, tail + r->cur, __ATOMIC_RELEASE);
+    r->cur = 0;
+}
+
+
+/**
+ * @brief 메시지 복사해서 받기 (소비자)
+ * @param r - 링 핸들
+ * @param buf - (OUT) 버퍼
+ * @param size - 버퍼 크기
+ * @return
+ *  성공 시 메시지 길이,\n
+ *  실패 시 -1 (메시지 없음 EAGAIN, 버퍼가 작으면 EMSGSIZE 이며 메시지는 남음)
+ */
+ssize_t
+shmring_recv(shmring_t *r, void *buf, size_t size)
+{
+    void *p = NULL;
+    size_t len;
+
+    if ((p = shmring_peek(r, &len)) == NULL) {
+	errno = EAGAIN;
+	return -1;
+    }
+    if (len > size) {
+	r->cur = 0;
+	errno = EMSGSIZE;
+	return -1;
+    }
+
+    memcpy(buf, p, len);
+    shmring_release(r);
+
+    return (ssize_t) len;
+}
+
+
+/**
+ * @brief 대기 상태로 전환 (소비자, 이벤트 루프용)
+ * @param r - 링 핸들
+ * @return
+ *  메시지가 없어서 대기 상태가 되었으면 0 (eventfd 를 기다림),\n
+ *  그 사이 메시지가 들어왔으면 1 (계속 처리)
+ *
+ * eventfd 를 비운 뒤 waiting 을 설정하므로 이후의 commit 은 eventfd 를
+ * 깨운다.
+ */
+int
+shmring_arm(shmring_t *r)
+{
+    uint64_t v;
+
+    if (r->efd >= 0) {
+	while (read(r->efd, &v, sizeof(v)) > 0) {
+	    ;
+	}
+    }
+
+    __atomic_store_n(&r->hdr->waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ring_empty(r)) {
+	return 0;
+    }
+    __atomic_store_n(&r->hdr->waiting, 0, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+
+/**
+ * @brief 메시지가 들어올 때까지 대기 (소비자, futex)
+ * @param r - 링 핸들
+ * @param msec - 최대 대기시간 (-1 이면 무한)
+ * @return
+ *  메시지가 있으면 1,\n
+ *  Timeout 또는 시그널이면 0
+ */
+int
+shmring_wait(shmring_t *r, int msec)
+{
+    shmring_hdr_t *h = r->hdr;
+    uint32_t seq;
+    int i;
+
+    /* 생산자가 곧 쓸 것이면 잠들고 깨우는 시스템콜 두번을 아낌 */
+    for (i = 0; i < SHMRING_SPIN; i++) {
+	if (!ring_empty(r)) {
+	    return 1;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+    }
+
+    seq = __atomic_load_n(&h->wakeup, __ATOMIC_ACQUIRE);
+    if (shmring_arm(r)) {
+	return 1;
+    }
+    futex_wait(&h->wakeup, seq, msec);
+    __atomic_store_n(&h->waiting, 0, __ATOMIC_RELAXED);
+
+    return !ring_empty(r);
+}
@@ -0,0 +1,49 @@
+/**
+ * @file onvshmring.h
+ * @brief 프로세스간 공유메모리 메시지 링 (SPSC/MPSC) 헤더
+ */
+
+/*
+ * 프로세스간 공유메모리 메시지 링 (SPSC/MPSC) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_SHMRING_H
+#define ONV_SHMRING_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define SHMRING_SPSC		0x00	/**< 생산자 하나, 소비자 하나 */
+#define SHMRING_MPSC		0x01	/**< 생산자 여럿, 소비자 하나 */
+
+#define SHMRING_MIN_SIZE	4096	/**< 최소 데이터 영역 크기 */
+
+typedef struct shmring_s shmring_t;
+
+shmring_t *shmring_create(const char *name, size_t size, int flags);
+shmring_t *shmring_attach(const char *name);
+shmring_t *shmring_attach_fd(int fd, int efd);
+void shmring_close(shmring_t *r);
+int shmring_fd(const shmring_t *r);
+int shmring_eventfd(const shmring_t *r);
+size_t shmring_max_msg(const shmring_t *r);
+
+void *shmring_reserve(shmring_t *r, size_t len);
+void shmring_commit(shmring_t *r, void *p);
+int shmring_send(shmring_t *r, const void *data, size_t len);
+
+void *shmring_peek(shmring_t *r, size_t *len);
+void shmring_release(shmring_t *r);
+ssize_t shmring_recv(shmring_t *r, void *buf, size_t size);
+int shmring_arm(shmring_t *r);
+int shmring_wait(shmring_t *r, int msec);
+
+#endif
@@ -10,10 +10,15 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <ctype.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include "log.h"
 #include "onvsock.h"
-static int wait_packet(int fd,int nsec);
-static int connect_nonb(int sockfd, const struct sockaddr *saptr, int salen, int nsec);
+#include "onvresolv.h"
+#include "onvwait.h"
+#include "onvsockopt.h"
+#include "misclib.h"
+static int connect_nonb(int sockfd, const struct sockaddr *saptr, int salen, long deadline);
 /**
  * @brief TCP 연결 함수 
  * @param ip ip주소 
@@ -33,36 +38,178 @@ int onvTCPconnect(char* ip , int port){
  */
 int onvTCPconnectNonBlock(const char *hostname, const char *service,int nsec)
 {
-    struct addrinfo hints, *res, *ressave;
+    struct addrinfo *res, *ressave;
+    sockopt_t opt;
     int  sock,n;
+    long deadline;
 
-    bzero(&hints, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    if( (n=getaddrinfo(hostname,service,&hints,&res)) != 0){
-        Log(ERROR,"getaddrinfo function error");
+    /* getaddrinfo() 대신 캐시 사용 (SOCK_STREAM) */
+    if( (n=resolv_lookup(hostname,service,&res)) != 0){
+        Log(ERROR,"resolv_lookup function error: %s", gai_strerror(n));
         return -1;
     }
     ressave = res;
+    (void) sockopt_profile(SOCKOPT_DEFAULT, &opt);
+    /* nsec 는 각 주소가 아닌 전체 접속 시간 */
+    deadline = nsec ? wait_deadline(nsec * 1000) : WAIT_FOREVER;
     do {
-        struct  sockaddr_in *ts;
         sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
         if(sock < 0)
             continue;
+        (void) sockopt_apply_connect(sock, &opt);
 
-        ts = (struct sockaddr_in *) res->ai_addr;
-
-        if(connect_nonb(sock, (struct sockaddr *)res->ai_addr, res->ai_addrlen,nsec) == 0) 
+        if(connect_nonb(sock, (struct sockaddr *)res->ai_addr, res->ai_addrlen,deadline) == 0) 
             break;
 
         close(sock);
     }while( (res=res->ai_next) !=NULL);
     if( res == NULL){
         Log(ERROR,"connet_nonb function error");
+        resolv_free(ressave);
         return -1;
     }
-    freeaddrinfo(ressave);
+    resolv_free(ressave);
+    return sock;
+}
+
+/**
+ * @brief 해석된 주소들에 병렬로 connect ("happy eyeballs")
+ * @param hostname     호스트 이름 
+ * @param service      포트 번호
+ * @param nsec         전체 타임아웃 시간 (0 이면 무제한)
+ * @param stagger_msec 다음 주소로 시도를 시작하기까지 간격 (0 이면 기본값)
+ * @return 성공 시 소켓 구분자 
+ * @return 실패 시 -1
+ *
+ * 주소 목록을 IPv6/IPv4 교대로 정렬한 뒤 stagger_msec 간격으로 시도를 추가로
+ * 시작하고, 가장 먼저 성공한 소켓을 반환하며 나머지는 닫는다. 진행중인 시도가
+ * 실패하면 간격을 기다리지 않고 다음 주소를 바로 시도한다.
+ * nsec 는 각 시도가 아니라 전체 작업에 적용된다.
+ */
+int onvTCPconnectParallel(const char *hostname, const char *service,int nsec,int stagger_msec)
+{
+    struct addrinfo *res, *ressave, *ai;
+    struct addrinfo *addrs[RESOLV_MAX_ADDRS], *v6[RESOLV_MAX_ADDRS], *v4[RESOLV_MAX_ADDRS];
+    struct pollfd pfds[RESOLV_MAX_ADDRS];
+    sockopt_t opt;
+    int  naddrs = 0, n6 = 0, n4 = 0, npfds = 0, next = 0;
+    int  sock = -1, n, i, error, last_error = ETIMEDOUT, timeout;
+    long now, deadline, next_start;
+    socklen_t len;
+
+    if( (n=resolv_lookup(hostname,service,&res)) != 0){
+        Log(ERROR,"resolv_lookup function error: %s", gai_strerror(n));
+        return -1;
+    }
+    ressave = res;
+
+    /* IPv6, IPv4 교대로 정렬 */
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        if (ai->ai_family == AF_INET6)
+            v6[n6++] = ai;
+        else
+            v4[n4++] = ai;
+    }
+    for (i = 0; i < n6 || i < n4; i++) {
+        if (i < n6)
+            addrs[naddrs++] = v6[i];
+        if (i < n4)
+            addrs[naddrs++] = v4[i];
+    }
+
+    (void) sockopt_profile(SOCKOPT_DEFAULT, &opt);
+    if (stagger_msec <= 0)
+        stagger_msec = ONV_CONNECT_STAGGER;
+    now = wait_now();
+    deadline = nsec > 0 ? now + nsec * 1000L : -1;
+    next_start = now;
+
+    while (sock < 0) {
+        /* 새 시도 시작 */
+        if (next < naddrs && (now >= next_start || npfds == 0)) {
+            ai = addrs[next++];
+            n = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK, ai->ai_protocol);
+            if (n < 0) {
+                last_error = errno;
+                continue;
+            }
+            (void) sockopt_apply_connect(n, &opt);
+            if (connect(n, ai->ai_addr, ai->ai_addrlen) == 0) {
+                sock = n;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                last_error = errno;
+                close(n);
+                continue;
+            }
+            pfds[npfds].fd = n;
+            pfds[npfds].events = POLLOUT;
+            pfds[npfds].revents = 0;
+            npfds++;
+            next_start = now + stagger_msec;
+        }
+
+        if (npfds == 0) {
+            break;      /* 모든 주소 실패 */
+        }
+
+        /* 다음 시도 시작 시각 또는 전체 타임아웃까지 대기 */
+        timeout = -1;
+        if (deadline >= 0) {
+            timeout = deadline > now ? (int) (deadline - now) : 0;
+        }
+        if (next < naddrs && (timeout < 0 || next_start - now < timeout)) {
+            timeout = next_start > now ? (int) (next_start - now) : 0;
+        }
+
+        n = poll(pfds, npfds, timeout);
+        if (n < 0 && errno != EINTR) {
+            last_error = errno;
+            Log(ERROR,"poll() function failed: %s", strerror(errno));
+            break;
+        }
+        now = wait_now();
+
+        for (i = 0; n > 0 && i < npfds; i++) {
+            if (pfds[i].revents == 0)
+                continue;
+            error = 0;
+            len = sizeof(error);
+            if (getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+                error = errno;
+            if (error == 0) {
+                sock = pfds[i].fd;
+                pfds[i] = pfds[--npfds];
+                break;
+            }
+            /* 실패한 시도는 닫고 다음 주소를 바로 시도 */
+            last_error = error;
+            close(pfds[i].fd);
+            pfds[i--] = pfds[--npfds];
+            next_start = now;
+        }
+
+        if (sock < 0 && deadline >= 0 && now >= deadline) {
+            last_error = ETIMEDOUT;
+            break;
+        }
+    }
+
+    /* 나머지 시도 취소 */
+    for (i = 0; i < npfds; i++) {
+        close(pfds[i].fd);
+    }
+    resolv_free(ressave);
+
+    if (sock < 0) {
+        Log(ERROR,"connect to %s:%s failed: %s", hostname, service, strerror(last_error));
+        errno = last_error;
+        return -1;
+    }
+
+    /* onvTCPconnectNonBlock() 과 같이 blocking 소켓으로 반환 */
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
     return sock;
 }
 
@@ -71,16 +218,14 @@ int onvTCPconnectNonBlock(const char *hostname, const char *service,int nsec)
  * @param sockfd       소켓 구분자 
  * @param sapter       소켓 주소 구조체 
  * @param salen        소켓 주소 구조체  길이 
- * @param nsec         타임아웃 시간 
+ * @param deadline     완료 시각 (wait_deadline(), WAIT_FOREVER 면 무제한)
  * @return 성공 시 0 
  * @return 실패 시 -1
  */
-static int connect_nonb(int sockfd, const struct sockaddr *saptr, int salen, int nsec)
+static int connect_nonb(int sockfd, const struct sockaddr *saptr, int salen, long deadline)
 {
     int             flags, n, error;
     socklen_t       len;
-    fd_set          rset, wset;
-    struct timeval  tval;
 
     flags = fcntl(sockfd, F_GETFL, 0);
     fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
@@ -96,74 +241,30 @@ static int connect_nonb(int sockfd, const struct sockaddr *saptr, int salen, int
     /* Do whatever we want while the connect is taking place. */
 
     if (n != 0){
-
-        FD_ZERO(&rset);
-        FD_SET(sockfd, &rset);
-        wset = rset;
-        tval.tv_sec = nsec;
-        tval.tv_usec = 0;
-
-        if ( (n = select(sockfd+1, &rset, &wset, NULL,
-                         nsec ? &tval : NULL)) == 0) {
-            close(sockfd);      /* timeout */
-            errno = ETIMEDOUT;
-
+        if ( (n = wait_fd(sockfd, WAIT_WRITE, deadline)) == 0) {
+            /* timeout, close 는 호출자가 한다 (errno = ETIMEDOUT) */
             Log(ERROR,"connet timeout error");
+            errno = ETIMEDOUT;
+            return(-1);
+        }
+        if (n < 0) {
             return(-1);
         }
 
-        if (FD_ISSET(sockfd, &rset) || FD_ISSET(sockfd, &wset)) {
-            len = sizeof(error);
-            if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len) < 0){
-                Log(ERROR,"getsockopt function error");
-                return(-1);         /* Solaris pending error */
-            }
-        } else{
-            Log(ERROR,"select error: sockfd not set\n");
+        len = sizeof(error);
+        if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len) < 0){
+            Log(ERROR,"getsockopt function error");
+            return(-1);         /* Solaris pending error */
         }
     }
     fcntl(sockfd, F_SETFL, flags);  /* restore file status flags */
     if (error) {
-        close(sockfd);      /* just in case */
         errno = error;
         Log(ERROR,"fcntl function error");
         return(-1);
     }
     return(0);
 }
-/**
-* wait_packet - 패킷 수신대기
-*
-* @param fd: 소켓 디스크립터
-* @param nsec: 패킷 대기시간
-* @return: 성공 시 0, 실패(Timeout or Error) 시 -1
-*/
-static int wait_packet(int fd,int nsec) {
-    int result;
-    fd_set rset;
-    struct timeval tm;
-    // 입력 시간이 잘못되었다면 실패
-    if(nsec <0){
-        Log(DEBUG,"timeout value error = [%d]",nsec);
-        return -1;
-    }
-    FD_ZERO(&rset);
-    FD_SET(fd, &rset);
-    tm.tv_sec = nsec;
-    tm.tv_usec = 0;
-    result = select(fd + 1, &rset, NULL, NULL, &tm);
-    if (result <= 0) {
-        if (result == 0 || errno == EINTR){
-            /* Timeout or Interrupt */
-            return -1;
-        } else {
-            /* Error */
-            Log(ERROR,"select() function failed: %s", strerror(errno));
-            return -1;
-        }
-    }
-    return 0;
-}
 /**
  * @brief 소켓에서 data를 읽어 반환하는 함수
  * @param sock 소켓
@@ -201,30 +302,17 @@ int onvRead(int sock,char * data,int datalen){
  * @param sock 소켓
  * @param data 읽어드린 데이터를 저장하는 포인터
  * @param datalen 읽어야 할 데이터 길이 
- * @param timewait
- * @return 성공 시 read data length, 실패 시 -1 
+ * @param timewait 전체 읽기 제한시간(초, 0 이면 무제한)
+ * @return 성공 시 read data length, 실패(timeout, 연결종료 포함) 시 -1 
  */
 int onvReadNonBlock(int sock,char * data,int datalen,int timewait){
-    size_t nleft;
     ssize_t nread;
-    char *ptr = NULL;
 
-    ptr = data;
-    nleft = datalen;
-    while(nleft > 0) {
-        wait_packet(sock,timewait);
-        if((nread = read(sock, ptr, nleft)) < 0) {
-            if(errno == EINTR) {
-                nread = 0;
-            }
-            else {
-                return -1;
-            }
-        }
-        nleft -= nread;
-        ptr += nread;
-    }
-    return (ssize_t) (datalen - nleft);
+    nread = readn_deadline(sock, data, datalen,
+            timewait ? wait_deadline(timewait * 1000) : WAIT_FOREVER);
+    if (nread != datalen)
+        return -1;
+    return (int) nread;
 }
 int onvWrite(int sock, char * data,int datalen){
     int nwrite, twrite = 0, len = (int) datalen;
@@ -243,3 +331,13 @@ int onvWrite(int sock, char * data,int datalen){
     }
     return (ssize_t) ((twrite == datalen) ? twrite : -1);
 }
+/**
+ * @brief iovec 배열의 데이터를 한번에 소켓에 쓰는 함수 (헤더+본문 등)
+ * @param sock 소켓
+ * @param iov 전송할 데이터 배열
+ * @param iovcnt iov 개수
+ * @return 성공 시 write data length, 실패 시 -1 
+ */
+int onvWritev(int sock, const struct iovec *iov, int iovcnt){
+    return (int) writenv(sock, iov, iovcnt);
+}
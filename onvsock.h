@@ -1,9 +1,16 @@
 #ifndef ONV_SOCK_H
 #define ONV_SOCK_H
+
+#include <sys/uio.h>
+
+#define ONV_CONNECT_STAGGER 250  /* 병렬 connect 시도 간격 기본값(msec) */
+
 int onvTCPconnect(char* ip , int port);
 int onvTCPconnectNonBlock(const char *hostname, const char *service,int nsec);
+int onvTCPconnectParallel(const char *hostname, const char *service,int nsec,int stagger_msec);
 int onvRead(int sock,char * data,int datalen);
 int onvReadNonBlock(int sock,char * data,int datalen,int timewait);
 int onvWrite(int sock, char * data,int datalen);
+int onvWritev(int sock, const struct iovec *iov, int iovcnt);
 #endif
 
@@ -0,0 +1,467 @@
+/**
+ * @file onvsockopt.c
+ * @brief 소켓 옵션 설정
+ */
+
+/*
+ * 소켓 옵션 설정
+ *
+ * 서비스마다 setsockopt() 코드를 따로 두지 않도록 이름 붙인 옵션
+ * 프로파일을 제공한다. 기본 제공 프로파일(SOCKOPT_LOWLATENCY, SOCKOPT_BULK)
+ * 외에 설정파일에서 "sockopt.<프로파일>.<옵션> = 값" 으로 정의하거나 기존
+ * 프로파일의 값을 바꿀 수 있다 (sockopt_profile_load()).
+ *
+ *     sockopt.default.nodelay = 1
+ *     sockopt.rpc.user_timeout = 5000
+ *     sockopt.bulk.sndbuf = 8m
+ *
+ * SOCKOPT_DEFAULT 프로파일은 socket_listen(), tcp_Connect(),
+ * onvTCPconnectNonBlock() 등 옵션 인자가 없는 함수에 적용된다 (기본은 비어
+ * 있음). 리슨 소켓의 옵션은 accept 한 소켓에 상속된다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <strings.h>
+#include <pthread.h>
+#include "log.h"
+#include "misclib.h"
+#include "config_parser.h"
+#include "onvsockopt.h"
+
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT	30
+#endif
+
+#define SOCKOPT_CONFIG_PREFIX	"sockopt."	/**< 설정파일 파라메터 접두어 */
+
+/**
+ * 이름 붙인 옵션 프로파일
+ */
+typedef struct sockopt_profile_s
+{
+    char name[SOCKOPT_NAME_MAX];
+    sockopt_t opt;
+} sockopt_profile_t;
+
+/**
+ * 설정파일 옵션 이름과 sockopt_t 항목 위치
+ */
+static const struct
+{
+    const char *name;
+    size_t offset;
+} sockopt_fields[] = {
+    { "nodelay",	offsetof(sockopt_t, nodelay) },
+    { "sndbuf",		offsetof(sockopt_t, sndbuf) },
+    { "rcvbuf",		offsetof(sockopt_t, rcvbuf) },
+    { "keepalive",	offsetof(sockopt_t, keepalive) },
+    { "keepidle",	offsetof(sockopt_t, keepidle) },
+    { "keepintvl",	offsetof(sockopt_t, keepintvl) },
+    { "keepcnt",	offsetof(sockopt_t, keepcnt) },
+    { "user_timeout",	offsetof(sockopt_t, user_timeout) },
+    { "busy_poll",	offsetof(sockopt_t, busy_poll) },
+    { "fastopen",	offsetof(sockopt_t, fastopen) },
+    { "defer_accept",	offsetof(sockopt_t, defer_accept) },
+    { "backlog",	offsetof(sockopt_t, backlog) },
+};
+
+/* 기본 제공 프로파일 (설정파일에서 값을 바꿀 수 있음) */
+static sockopt_profile_t profiles[SOCKOPT_PROFILE_MAX] = {
+    { SOCKOPT_DEFAULT, { 0 } },
+    { SOCKOPT_LOWLATENCY, { .nodelay = 1, .keepalive = 1, .keepidle = 30, .keepintvl = 5,
+	.keepcnt = 3, .user_timeout = 10000 } },
+    { SOCKOPT_BULK, { .sndbuf = 4 * 1024 * 1024, .rcvbuf = 4 * 1024 * 1024, .keepalive = 1,
+	.keepidle = 60, .keepintvl = 10, .keepcnt = 6, .user_timeout = 60000 } },
+};
+static int nprofiles = 3;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int set_int(int fd, int level, int name, int value, const char *label);
+static int apply_common(int fd, const sockopt_t *opt);
+static sockopt_profile_t *profile_find(const char *name, size_t len);
+static int parse_value(const char *value, int *out);
+
+
+/**
+ * @brief 정수형 소켓 옵션 설정
+ * @param fd - Socket descriptor
+ * @param level - 옵션 레벨
+ * @param name - 옵션 이름
+ * @param value - 설정값
+ * @param label - 에러 로그에 남길 옵션 이름
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+static int
+set_int(int fd, int level, int name, int value, const char *label)
+{
+    if (setsockopt(fd, level, name, &value, (socklen_t) sizeof(value)) < 0) {
+	Log(WARN, "setsockopt(%s=%d) failed: %s", label, value, strerror(errno));
+	return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 리슨/접속/accept 소켓에 공통으로 적용하는 옵션
+ * @return
+ *  모두 성공 시 0,\n
+ *  하나라도 실패 시 -1 (나머지 옵션은 계속 적용)
+ */
+static int
+apply_common(int fd, const sockopt_t *opt)
+{
+    int result = 0;
+
+    if (opt->nodelay > 0) {
+	result |= set_int(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+    if (opt->sndbuf > 0) {
+	result |= set_int(fd, SOL_SOCKET, SO_SNDBUF, opt->sndbuf, "SO_SNDBUF");
+    }
+    if (opt->rcvbuf > 0) {
+	result |= set_int(fd, SOL_SOCKET, SO_RCVBUF, opt->rcvbuf, "SO_RCVBUF");
+    }
+    if (opt->keepalive > 0) {
+	result |= set_int(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+	if (opt->keepidle > 0) {
+	    result |= set_int(fd, IPPROTO_TCP, TCP_KEEPIDLE, opt->keepidle, "TCP_KEEPIDLE");
+	}
+	if (opt->keepintvl > 0) {
+	    result |= set_int(fd, IPPROTO_TCP, TCP_KEEPINTVL, opt->keepintvl, "TCP_KEEPINTVL");
+	}
+	if (opt->keepcnt > 0) {
+	    result |= set_int(fd, IPPROTO_TCP, TCP_KEEPCNT, opt->keepcnt, "TCP_KEEPCNT");
+	}
+    }
+    if (opt->user_timeout > 0) {
+	result |= set_int(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, opt->user_timeout, "TCP_USER_TIMEOUT");
+    }
+    if (opt->busy_poll > 0) {
+	result |= set_int(fd, SOL_SOCKET, SO_BUSY_POLL, opt->busy_poll, "SO_BUSY_POLL");
+    }
+
+    return result ? -1 : 0;
+}
+
+
+/**
+ * @brief 연결된(accept 한) 소켓에 옵션 적용
+ * @param fd - Socket descriptor
+ * @param opt - 적용할 옵션 (NULL 이면 아무것도 하지 않음)
+ * @return
+ *  모두 성공 시 0,\n
+ *  하나라도 실패 시 -1 (나머지 옵션은 계속 적용)
+ *
+ * 리슨 전용 항목(fastopen, defer_accept, backlog)은 무시한다.
+ */
+int
+sockopt_apply(int fd, const sockopt_t *opt)
+{
+    if (!opt) {
+	return 0;
+    }
+
+    return apply_common(fd, opt);
+}
+
+
+/**
+ * @brief 리슨 소켓에 옵션 적용 (listen() 전에 호출)
+ * @param fd - Socket descriptor
+ * @param opt - 적용할 옵션 (NULL 이면 아무것도 하지 않음)
+ * @return
+ *  모두 성공 시 0,\n
+ *  하나라도 실패 시 -1 (나머지 옵션은 계속 적용)
+ *
+ * 버퍼 크기 등은 window scale 이 정해지기 전에 설정해야 하므로 listen() 전에
+ * 적용하며, accept 한 소켓에 상속된다. backlog 는 호출자가 listen() 에 넘긴다.
+ */
+int
+sockopt_apply_listen(int fd, const sockopt_t *opt)
+{
+    int result = 0;
+
+    if (!opt) {
+	return 0;
+    }
+
+    result |= apply_common(fd, opt);
+    if (opt->fastopen > 0) {
+	result |= set_int(fd, IPPROTO_TCP, TCP_FASTOPEN, opt->fastopen, "TCP_FASTOPEN");
+    }
+    if (opt->defer_accept > 0) {
+	result |= set_int(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, opt->defer_accept, "TCP_DEFER_ACCEPT");
+    }
+
+    return result ? -1 : 0;
+}
+
+
+/**
+ * @brief 접속할 소켓에 옵션 적용 (connect() 전에 호출)
+ * @param fd - Socket descriptor
+ * @param opt - 적용할 옵션 (NULL 이면 아무것도 하지 않음)
+ * @return
+ *  모두 성공 시 0,\n
+ *  하나라도 실패 시 -1 (나머지 옵션은 계속 적용)
+ *
+ * fastopen 을 설정하면 SYN 은 첫 write 때 데이터와 함께 나가므로 (connect()
+ * 는 바로 성공) 클라이언트가 먼저 보내는 프로토콜에만 사용한다.
+ */
+int
+sockopt_apply_connect(int fd, const sockopt_t *opt)
+{
+    int result = 0;
+
+    if (!opt) {
+	return 0;
+    }
+
+    result |= apply_common(fd, opt);
+    if (opt->fastopen > 0) {
+	result |= set_int(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT");
+    }
+
+    return result ? -1 : 0;
+}
+
+
+/**
+ * @brief 이름으로 프로파일 검색 (profile_lock 을 잡고 호출)
+ */
+static sockopt_profile_t *
+profile_find(const char *name, size_t len)
+{
+    int i;
+
+    for (i = 0; i < nprofiles; i++) {
+	if (strlen(profiles[i].name) == len && strncasecmp(profiles[i].name, name, len) == 0) {
+	    return &profiles[i];
+	}
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief 이름 붙인 프로파일의 옵션 복사
+ * @param name - 프로파일 이름 (SOCKOPT_DEFAULT 등)
+ * @param opt - (OUT) 옵션 (없는 프로파일이면 모두 0)
+ * @return
+ *  성공 시 0,\n
+ *  없는 프로파일이면 -1
+ */
+int
+sockopt_profile(const char *name, sockopt_t *opt)
+{
+    sockopt_profile_t *p = NULL;
+
+    ASSERT(name != NULL && opt != NULL);
+
+    pthread_mutex_lock(&profile_lock);
+    if ((p = profile_find(name, strlen(name))) != NULL) {
+	*opt = p->opt;
+    }
+    else {
+	memset(opt, 0, sizeof(sockopt_t));
+    }
+    pthread_mutex_unlock(&profile_lock);
+
+    return p ? 0 : -1;
+}
+
+
+/**
+ * @brief 프로파일 등록 (같은 이름이 있으면 교체)
+ * @param name - 프로파일 이름 (SOCKOPT_NAME_MAX 미만)
+ * @param opt - 옵션
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+sockopt_profile_set(const char *name, const sockopt_t *opt)
+{
+    sockopt_profile_t *p = NULL;
+    size_t len;
+
+    ASSERT(name != NULL && opt != NULL);
+
+    if ((len = strlen(name)) == 0 || len >= SOCKOPT_NAME_MAX) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    pthread_mutex_lock(&profile_lock);
+    if ((p = profile_find(name, len)) == NULL && nprofiles < SOCKOPT_PROFILE_MAX) {
+	p = &profiles[nprofiles++];
+	memcpy(p->name, name, len + 1);
+    }
+    if (p) {
+	p->opt = *opt;
+    }
+    pthread_mutex_unlock(&profile_lock);
+
+    if (!p) {
+	Log(ERROR, "too many socket option profiles (max %d)", SOCKOPT_PROFILE_MAX);
+	errno = ENOSPC;
+	return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 설정파일(config_read())의 "sockopt.<프로파일>.<옵션>" 항목으로 프로파일 갱신
+ * @param 없음
+ * @return
+ *  성공 시 적용한 항목 수,\n
+ *  잘못된 항목이 있으면 -1 (나머지 항목은 적용)
+ *
+ * 기존 프로파일은 지정한 옵션만 바뀌고, 새 이름이면 0 에서 시작한다.
+ * 값은 정수이며 k, m 접미어를 쓸 수 있다 (버퍼 크기).
+ */
+int
+sockopt_profile_load(void)
+{
+    config_list_t *list = NULL;
+    sockopt_profile_t *p = NULL;
+    arena_t *a = NULL;
+    const char *name = NULL, *field = NULL;
+    size_t plen = strlen(SOCKOPT_CONFIG_PREFIX);
+    int i, j, value, count = 0, bad = 0;
+
+    if ((a = arena_create(0)) == NULL) {
+	return -1;
+    }
+    if ((list = config_get_list_arena(a)) == NULL) {
+	arena_destroy(a);
+	return -1;
+    }
+
+    pthread_mutex_lock(&profile_lock);
+    for (i = 0; list[i].parameter; i++) {
+	if (strncasecmp(list[i].parameter, SOCKOPT_CONFIG_PREFIX, plen) != 0) {
+	    continue;
+	}
+	name = list[i].parameter + plen;
+	if ((field = strrchr(name, '.')) == NULL || field == name ||
+		(size_t) (field - name) >= SOCKOPT_NAME_MAX) {
+	    Log(ERROR, "bad socket option parameter: %s", list[i].parameter);
+	    bad = 1;
+	    continue;
+	}
+	field++;
+
+	for (j = 0; j < (int) (sizeof(sockopt_fields) / sizeof(sockopt_fields[0])); j++) {
+	    if (strcasecmp(sockopt_fields[j].name, field) == 0) {
+		break;
+	    }
+	}
+	if (j == (int) (sizeof(sockopt_fields) / sizeof(sockopt_fields[0])) ||
+		parse_value(list[i].value, &value) < 0) {
+	    Log(ERROR, "bad socket option: %s = %s", list[i].parameter,
+		    list[i].value ? list[i].value : "");
+	    bad = 1;
+	    continue;
+	}
+
+	if ((p = profile_find(name, field - name - 1)) == NULL) {
+	    if (nprofiles == SOCKOPT_PROFILE_MAX) {
+		Log(ERROR, "too many socket option profiles (max %d)", SOCKOPT_PROFILE_MAX);
+		bad = 1;
+		continue;
+	    }
+	    p = &profiles[nprofiles++];
+	    memset(p, 0, sizeof(sockopt_profile_t));
+	    memcpy(p->name, name, field - name - 1);
+	}
+	*(int *) ((char *) &p->opt + sockopt_fields[j].offset) = value;
+	count++;
+    }
+    pthread_mutex_unlock(&profile_lock);
+
+    arena_destroy(a);
+
+    return bad ? -1 : count;
+}
+
+
+/**
+ * @brief 옵션 값 해석 (정수, k/m 접미어)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+static int
+parse_value(const char *value, int *out)
+{
+    char *end = NULL;
+    long v;
+
+    if (value == NULL || *value == '\0') {
+	return -1;
+    }
+
+    errno = 0;
+    v = strtol(value, &end, 10);
+    if (errno || end == value) {
+	return -1;
+    }
+    if (*end == 'k' || *end == 'K') {
+	v *= 1024;
+	end++;
+    }
+    else if (*end == 'm' || *end == 'M') {
+	v *= 1024 * 1024;
+	end++;
+    }
+    if (*end != '\0' || v < 0 || v > 0x7fffffffL) {
+	return -1;
+    }
+
+    *out = (int) v;
+    return 0;
+}
+
+
+/**
+ * @brief TCP_CORK 설정/해제
+ * @param fd - Socket descriptor
+ * @param on - 1 이면 cork (꽉 찬 세그먼트만 전송), 0 이면 해제 (남은 데이터 즉시 전송)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 한 응답을 writen() 등으로 여러번 나누어 쓰는 경우 앞뒤로 호출하면 작은
+ * 세그먼트 여러개 대신 꽉 찬 세그먼트로 묶여서 전송된다. 해제하는 시점에
+ * 바로 전송되므로 지연은 없다.
+ */
+int
+sockopt_cork(int fd, int on)
+{
+    return set_int(fd, IPPROTO_TCP, TCP_CORK, on ? 1 : 0, "TCP_CORK");
+}
@@ -0,0 +1,57 @@
+/**
+ * @file onvsockopt.h
+ * @brief 소켓 옵션 설정 헤더
+ */
+
+/*
+ * 소켓 옵션 설정 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_SOCKOPT_H
+#define ONV_SOCKOPT_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define SOCKOPT_DEFAULT		"default"	/**< socket_listen(), tcp_Connect() 등에 적용되는 프로파일 */
+#define SOCKOPT_LOWLATENCY	"lowlatency"	/**< 기본 제공: 저지연 RPC */
+#define SOCKOPT_BULK		"bulk"		/**< 기본 제공: 대용량 전송 */
+#define SOCKOPT_PROFILE_MAX	32		/**< 최대 프로파일 수 */
+#define SOCKOPT_NAME_MAX	32		/**< 프로파일 이름 최대 길이 */
+#define SOCKOPT_BACKLOG		1024		/**< 기본 listen backlog */
+
+/**
+ * 소켓 옵션 구조체
+ * 0 인 항목은 설정하지 않는다(커널 기본값 사용).
+ */
+typedef struct sockopt_s
+{
+    int nodelay;		/**< TCP_NODELAY */
+    int sndbuf;			/**< SO_SNDBUF (바이트) */
+    int rcvbuf;			/**< SO_RCVBUF (바이트) */
+    int keepalive;		/**< SO_KEEPALIVE */
+    int keepidle;		/**< TCP_KEEPIDLE (초) */
+    int keepintvl;		/**< TCP_KEEPINTVL (초) */
+    int keepcnt;		/**< TCP_KEEPCNT */
+    int user_timeout;		/**< TCP_USER_TIMEOUT (msec, 응답 없는 연결을 끊는 시간) */
+    int busy_poll;		/**< SO_BUSY_POLL (usec) */
+    int fastopen;		/**< 리슨: TCP_FASTOPEN 큐 길이, 접속: TCP_FASTOPEN_CONNECT */
+    int defer_accept;		/**< 리슨: TCP_DEFER_ACCEPT (초, 데이터가 올 때까지 accept 지연) */
+    int backlog;		/**< 리슨: listen() backlog (0 이면 SOCKOPT_BACKLOG) */
+} sockopt_t;
+
+int sockopt_apply(int fd, const sockopt_t *opt);
+int sockopt_apply_listen(int fd, const sockopt_t *opt);
+int sockopt_apply_connect(int fd, const sockopt_t *opt);
+int sockopt_profile(const char *name, sockopt_t *opt);
+int sockopt_profile_set(const char *name, const sockopt_t *opt);
+int sockopt_profile_load(void);
+int sockopt_cork(int fd, int on);
+
+#endif
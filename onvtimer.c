@@ -0,0 +1,414 @@
+/**
+ * @file onvtimer.c
+ * @brief 계층 타이머 휠
+ */
+
+/*
+ * 계층 타이머 휠
+ *
+ * 수만개 연결의 idle timeout, 요청 deadline, 주기 작업을 관리하기 위한
+ * 타이머. 등록, 취소, 재등록이 모두 O(1) 이고 메모리 할당이 없다
+ * (wheel_timer_t 를 연결 구조체 등에 포함해서 사용).
+ *
+ * 첫 단계는 256 개 슬롯에 tick 단위로, 상위 4 단계는 각 64 개 슬롯에
+ * 점점 큰 단위로 타이머를 넣는다. 첫 단계가 한바퀴 돌 때마다 상위 단계의
+ * 해당 슬롯을 아래로 내린다(cascade). tick 이 1msec 이면 약 49 일까지
+ * 표현하며, 그보다 먼 타이머는 최대값으로 잘린다.
+ *
+ * 시각은 CLOCK_MONOTONIC (wait_now()) 을 사용한다. 루프에서는 wheel_next()
+ * 만큼 대기한 뒤 wheel_run() 을 호출한다 (onvevent 가 이렇게 사용한다).
+ * 한 쓰레드에서만 사용해야 한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvwait.h"
+#include "onvtimer.h"
+
+#define WHEEL_ROOT_SIZE		(1 << WHEEL_ROOT_BITS)
+#define WHEEL_ROOT_MASK		(WHEEL_ROOT_SIZE - 1)
+#define WHEEL_LEVEL_SIZE	(1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVEL_MASK	(WHEEL_LEVEL_SIZE - 1)
+#define WHEEL_MAX_DELTA		((1LL << (WHEEL_ROOT_BITS + WHEEL_LEVELS * WHEEL_LEVEL_BITS)) - 1)
+
+struct wheel_s
+{
+    int tick;					/**< tick 크기(msec) */
+    int count;					/**< 등록된 타이머 수 */
+    long long cur;				/**< 다음에 처리할 tick */
+    wheel_timer_t *root[WHEEL_ROOT_SIZE];	/**< 첫 단계 */
+    wheel_timer_t *level[WHEEL_LEVELS][WHEEL_LEVEL_SIZE];	/**< 상위 단계 */
+};
+
+static void timer_link(wheel_timer_t **head, wheel_timer_t *t);
+static void timer_unlink(wheel_timer_t *t);
+static void timer_place(wheel_t *w, wheel_timer_t *t);
+static void cascade(wheel_t *w, int level, int idx);
+
+
+/**
+ * @brief 타이머 휠 생성
+ * @param tick_msec - tick 크기(msec, 0 이하이면 WHEEL_TICK)
+ * @return
+ *  성공 시 타이머 휠,\n
+ *  실패 시 NULL
+ */
+wheel_t *
+wheel_create(int tick_msec)
+{
+    wheel_t *w = NULL;
+
+    if ((w = calloc(1, sizeof(wheel_t))) == NULL) {
+	Log(ERROR, "calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    w->tick = tick_msec > 0 ? tick_msec : WHEEL_TICK;
+    w->cur = wait_now() / w->tick;
+
+    return w;
+}
+
+
+/**
+ * @brief 타이머 휠 해제 (등록된 타이머는 등록되지 않은 상태가 됨)
+ * @param w - 타이머 휠
+ * @return 없음
+ */
+void
+wheel_destroy(wheel_t *w)
+{
+    int i, j;
+
+    if (w == NULL) {
+	return;
+    }
+
+    for (i = 0; i < WHEEL_ROOT_SIZE; i++) {
+	while (w->root[i]) {
+	    timer_unlink(w->root[i]);
+	}
+    }
+    for (i = 0; i < WHEEL_LEVELS; i++) {
+	for (j = 0; j < WHEEL_LEVEL_SIZE; j++) {
+	    while (w->level[i][j]) {
+		timer_unlink(w->level[i][j]);
+	    }
+	}
+    }
+    free(w);
+}
+
+
+/**
+ * @brief 타이머 초기화 (등록 전에 한번 호출)
+ * @param t - 타이머
+ * @param cb - 만료 콜백
+ * @param arg - 콜백 인자
+ * @return 없음
+ */
+void
+wheel_timer_init(wheel_timer_t *t, wheel_cb cb, void *arg)
+{
+    ASSERT(t != NULL);
+
+    memset(t, 0, sizeof(wheel_timer_t));
+    t->cb = cb;
+    t->arg = arg;
+}
+
+
+/**
+ * @brief 타이머 등록 (이미 등록되어 있으면 새 만료시간으로 재등록)
+ * @param w - 타이머 휠
+ * @param t - wheel_timer_init() 한 타이머
+ * @param msec - 만료시간(msec, tick 단위로 올림)
+ * @param repeat - 0 이 아니면 \a msec 주기로 반복
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * idle timeout 은 데이터를 받을 때마다 이 함수로 다시 등록하면 된다.
+ */
+int
+wheel_timer_add(wheel_t *w, wheel_timer_t *t, int msec, int repeat)
+{
+    long long now, ticks;
+
+    ASSERT(w != NULL && t != NULL);
+
+    if (t->cb == NULL) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    if (t->pprev) {
+	timer_unlink(t);
+	w->count--;
+    }
+
+    if (msec < 0) {
+	msec = 0;
+    }
+    ticks = (msec + w->tick - 1) / w->tick;
+    now = wait_now() / w->tick;
+
+    /* 비어 있는 동안 멈춰 있던 휠은 현재 시각으로 옮김 */
+    if (w->count == 0 && w->cur < now) {
+	w->cur = now;
+    }
+
+    t->expire = now + ticks;
+    t->interval = repeat ? (ticks > 0 ? (int) ticks : 1) : 0;
+    timer_place(w, t);
+    w->count++;
+
+    return 0;
+}
+
+
+/**
+ * @brief 타이머 취소 (등록되지 않은 타이머이면 아무것도 하지 않음)
+ * @param w - 타이머 휠
+ * @param t - 타이머
+ * @return 없음
+ */
+void
+wheel_timer_del(wheel_t *w, wheel_timer_t *t)
+{
+    ASSERT(w != NULL && t != NULL);
+
+    if (t->pprev) {
+	timer_unlink(t);
+	w->count--;
+    }
+}
+
+
+/**
+ * @brief 타이머가 등록되어 있는지 확인
+ * @param t - 타이머
+ * @return 등록되어 있으면 1, 아니면 0
+ */
+int
+wheel_timer_pending(const wheel_timer_t *t)
+{
+    return t->pprev != NULL;
+}
+
+
+/**
+ * @brief 등록된 타이머 수
+ * @param w - 타이머 휠
+ * @return 타이머 수
+ */
+int
+wheel_count(const wheel_t *w)
+{
+    return w->count;
+}
+
+
+/**
+ * @brief 다음에 wheel_run() 을 호출해야 할 때까지 남은 시간
+ * @param w - 타이머 휠
+ * @return
+ *  남은 시간(msec, 지났으면 0),\n
+ *  타이머가 없으면 -1
+ *
+ * 다음 cascade 에서 내려올 타이머가 있거나 첫 단계에 타이머가 없으면
+ * 다음 cascade 시각을 반환한다 (최대 256 tick).
+ */
+long
+wheel_next(wheel_t *w)
+{
+    long long tick, boundary, diff;
+    int i, idx, cascading = 0;
+
+    ASSERT(w != NULL);
+
+    if (w->count == 0) {
+	return -1;
+    }
+
+    /* 다음 cascade 에서 내려올 타이머가 있는지 확인 */
+    boundary = (w->cur + WHEEL_ROOT_MASK) & ~((long long) WHEEL_ROOT_MASK);
+    for (i = 0; i < WHEEL_LEVELS; i++) {
+	idx = (int) ((boundary >> (WHEEL_ROOT_BITS + i * WHEEL_LEVEL_BITS)) & WHEEL_LEVEL_MASK);
+	if (w->level[i][idx]) {
+	    cascading = 1;
+	    break;
+	}
+	if (idx != 0) {
+	    break;
+	}
+    }
+
+    tick = boundary;
+    for (i = 0; i < WHEEL_ROOT_SIZE; i++) {
+	if (cascading && w->cur + i >= boundary) {
+	    break;
+	}
+	if (w->root[(w->cur + i) & WHEEL_ROOT_MASK]) {
+	    tick = w->cur + i;
+	    break;
+	}
+    }
+
+    diff = tick * w->tick - wait_now();
+    return diff > 0 ? (long) diff : 0;
+}
+
+
+/**
+ * @brief 만료된 타이머의 콜백 실행
+ * @param w - 타이머 휠
+ * @return 실행한 콜백 수
+ */
+int
+wheel_run(wheel_t *w)
+{
+    wheel_timer_t *list = NULL, *t = NULL;
+    long long now;
+    int i, idx, nrun = 0;
+
+    ASSERT(w != NULL);
+
+    now = wait_now() / w->tick;
+    while (w->cur <= now) {
+	if (w->count == 0) {
+	    w->cur = now + 1;
+	    break;
+	}
+
+	idx = (int) (w->cur & WHEEL_ROOT_MASK);
+	if (idx == 0) {
+	    for (i = 0; i < WHEEL_LEVELS; i++) {
+		idx = (int) ((w->cur >> (WHEEL_ROOT_BITS + i * WHEEL_LEVEL_BITS)) & WHEEL_LEVEL_MASK);
+		cascade(w, i, idx);
+		if (idx != 0) {
+		    break;
+		}
+	    }
+	    idx = 0;
+	}
+
+	/* 콜백에서 등록하는 타이머가 이번 슬롯에 들어가지 않도록 먼저 진행 */
+	list = w->root[idx];
+	w->root[idx] = NULL;
+	if (list) {
+	    list->pprev = &list;
+	}
+	w->cur++;
+
+	while ((t = list) != NULL) {
+	    timer_unlink(t);
+	    w->count--;
+	    if (t->interval > 0) {
+		t->expire = now + t->interval;
+		timer_place(w, t);
+		w->count++;
+	    }
+	    t->cb(t, t->arg);
+	    nrun++;
+	}
+    }
+
+    return nrun;
+}
+
+
+/**
+ * @brief 슬롯 리스트 앞에 타이머 연결
+ */
+static void
+timer_link(wheel_timer_t **head, wheel_timer_t *t)
+{
+    t->next = *head;
+    if (t->next) {
+	t->next->pprev = &t->next;
+    }
+    *head = t;
+    t->pprev = head;
+}
+
+
+/**
+ * @brief 슬롯 리스트에서 타이머 제거
+ */
+static void
+timer_unlink(wheel_timer_t *t)
+{
+    *t->pprev = t->next;
+    if (t->next) {
+	t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+
+/**
+ * @brief 만료 tick 에 맞는 단계/슬롯에 타이머를 넣음
+ */
+static void
+timer_place(wheel_t *w, wheel_timer_t *t)
+{
+    long long delta;
+    int i, shift;
+
+    delta = t->expire - w->cur;
+    if (delta < 0) {
+	t->expire = w->cur;
+	delta = 0;
+    }
+    else if (delta > WHEEL_MAX_DELTA) {
+	t->expire = w->cur + WHEEL_MAX_DELTA;
+	delta = WHEEL_MAX_DELTA;
+    }
+
+    if (delta < WHEEL_ROOT_SIZE) {
+	timer_link(&w->root[t->expire & WHEEL_ROOT_MASK], t);
+	return;
+    }
+
+    for (i = 0; i < WHEEL_LEVELS - 1; i++) {
+	if (delta < 1LL << (WHEEL_ROOT_BITS + (i + 1) * WHEEL_LEVEL_BITS)) {
+	    break;
+	}
+    }
+    shift = WHEEL_ROOT_BITS + i * WHEEL_LEVEL_BITS;
+    timer_link(&w->level[i][(t->expire >> shift) & WHEEL_LEVEL_MASK], t);
+}
+
+
+/**
+ * @brief 상위 단계 슬롯의 타이머를 아래 단계로 내림
+ */
+static void
+cascade(wheel_t *w, int level, int idx)
+{
+    wheel_timer_t *list = NULL, *t = NULL;
+
+    list = w->level[level][idx];
+    w->level[level][idx] = NULL;
+    if (list) {
+	list->pprev = &list;
+    }
+
+    while ((t = list) != NULL) {
+	timer_unlink(t);
+	timer_place(w, t);
+    }
+}
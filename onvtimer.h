@@ -0,0 +1,60 @@
+/**
+ * @file onvtimer.h
+ * @brief 계층 타이머 휠 헤더
+ */
+
+/*
+ * 계층 타이머 휠 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_TIMER_H
+#define ONV_TIMER_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define WHEEL_TICK		1	/**< 기본 tick 크기(msec) */
+#define WHEEL_ROOT_BITS		8	/**< 첫 단계 슬롯 수 = 256 tick */
+#define WHEEL_LEVEL_BITS	6	/**< 상위 단계 슬롯 수 = 64 */
+#define WHEEL_LEVELS		4	/**< 상위 단계 수 (최대 2^32 tick) */
+
+typedef struct wheel_s wheel_t;
+typedef struct wheel_timer_s wheel_timer_t;
+
+/**
+ * 만료 콜백
+ * @param t - 만료된 타이머 (콜백에서 다시 등록하거나 해제해도 된다)
+ * @param arg - wheel_timer_init() 의 \a arg
+ */
+typedef void (*wheel_cb)(wheel_timer_t *t, void *arg);
+
+/**
+ * 타이머 (연결 구조체 등에 포함해서 사용, 필드는 직접 건드리지 않는다)
+ */
+struct wheel_timer_s
+{
+    struct wheel_timer_s *next;		/**< 슬롯 리스트 */
+    struct wheel_timer_s **pprev;	/**< NULL 이면 등록되지 않음 */
+    long long expire;			/**< 만료 tick */
+    int interval;			/**< 반복 주기(tick), 0 이면 1회 */
+    wheel_cb cb;			/**< 콜백 */
+    void *arg;				/**< 콜백 인자 */
+};
+
+wheel_t *wheel_create(int tick_msec);
+void wheel_destroy(wheel_t *w);
+void wheel_timer_init(wheel_timer_t *t, wheel_cb cb, void *arg);
+int wheel_timer_add(wheel_t *w, wheel_timer_t *t, int msec, int repeat);
+void wheel_timer_del(wheel_t *w, wheel_timer_t *t);
+int wheel_timer_pending(const wheel_timer_t *t);
+int wheel_count(const wheel_t *w);
+long wheel_next(wheel_t *w);
+int wheel_run(wheel_t *w);
+
+#endif
@@ -0,0 +1,706 @@
+/**
+ * @file onvudp.c
+ * @brief UDP 일괄 송수신 (sendmmsg/recvmmsg, UDP GSO)
+ */
+
+/*
+ * UDP 일괄 송수신 (sendmmsg/recvmmsg, UDP GSO)
+ *
+ * udp_sendPacket() 은 datagram 마다 socket/connect/write/close 를 하므로
+ * 대량 송신에는 맞지 않는다. udp_sender_t 는 목적지마다 connect() 된 소켓을
+ * 유지하고, datagram 을 큐에 모았다가 목적지별로 sendmmsg() 한번에 보낸다.
+ *
+ * GSO 를 사용하면 같은 목적지로 가는 같은 크기의 연속 datagram 을 하나의
+ * UDP_SEGMENT 메시지로 묶어 커널이 잘라 보내도록 한다. 커널이 지원하지 않거나
+ * 전송 중 GSO 에러가 나면 자동으로 일반 전송으로 바꾼다.
+ *
+ * udp_receiver_t 는 recvmmsg() 로 미리 할당한 버퍼(slab)에 여러 datagram 을
+ * 한번에 받고, 커널 수신 시각(SO_TIMESTAMPNS)과 소켓 수신큐 overflow 로 버려진
+ * datagram 수(SO_RXQ_OVFL)를 함께 제공한다. SO_REUSEPORT 로 쓰레드마다 수신
+ * 객체를 만들면 커널이 datagram 을 나누어 준다.
+ *
+ * 송수신 객체는 쓰레드간에 공유하지 않는다 (쓰레드마다 하나씩 생성).
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvudp.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+
+/**
+ * 목적지 (connect() 된 소켓)
+ */
+typedef struct udp_dest_s
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    int fd;
+    int count;			/**< 큐에 있는 datagram 수 */
+} udp_dest_t;
+
+/**
+ * 큐에 있는 datagram
+ */
+typedef struct udp_msg_s
+{
+    int dest;			/**< 목적지 인덱스 */
+    size_t off;			/**< slab 내 위치 */
+    size_t len;			/**< 길이 */
+} udp_msg_t;
+
+/**
+ * UDP 송신 객체
+ */
+struct udp_sender_s
+{
+    int batch;			/**< 큐 최대 datagram 수 */
+    int gso;			/**< GSO 사용 여부 */
+    udp_dest_t dests[UDP_MAX_DEST];
+    int ndests;
+    int evict;			/**< 목적지가 가득 찼을 때 교체할 위치 */
+    udp_msg_t *msgs;		/**< 큐 */
+    int nmsgs;
+    char *slab;			/**< datagram 데이터 */
+    size_t used;
+    int *order;			/**< flush 시 목적지별 datagram 인덱스 */
+    int *nsegs;			/**< flush 시 메시지별 datagram 수 */
+    struct mmsghdr *mh;
+    struct iovec *iov;
+    char *cmsg;			/**< 메시지별 UDP_SEGMENT 제어 메시지 */
+    udp_sender_stat_t stat;
+};
+
+/**
+ * UDP 수신 객체
+ */
+struct udp_receiver_s
+{
+    int fd;
+    int batch;			/**< 한번에 받는 최대 datagram 수 */
+    size_t slotsize;		/**< datagram 버퍼 크기 */
+    char *slab;			/**< batch * slotsize 버퍼 */
+    char *cmsg;			/**< datagram 별 제어 메시지 버퍼 */
+    struct mmsghdr *mh;
+    struct iovec *iov;
+    udp_datagram_t *dgrams;
+    unsigned long drops;	/**< SO_RXQ_OVFL 누적 drop 수 */
+};
+
+#define CMSG_SEG_SPACE	CMSG_SPACE(sizeof(uint16_t))
+#define CMSG_RECV_SPACE	(CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t)))
+
+static int gso_supported(void);
+static int dest_get(udp_sender_t *s, const char *ip, int port);
+static int build(udp_sender_t *s, int pos, int n);
+static int flush_dest(udp_sender_t *s, int d);
+
+
+/**
+ * @brief 커널의 UDP GSO 지원 여부
+ */
+static int
+gso_supported(void)
+{
+    int fd, val = 1400, ok;
+
+    if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+	return 0;
+    }
+    ok = setsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == 0;
+    close(fd);
+
+    return ok;
+}
+
+
+/**
+ * @brief UDP 송신 객체 생성
+ * @param batch - 큐 최대 datagram 수 (0 이면 UDP_BATCH)
+ * @param gso - 0 이 아니면 커널이 지원할 때 UDP GSO 사용
+ * @return
+ *  성공 시 송신 객체,\n
+ *  실패 시 NULL
+ */
+udp_sender_t *
+udp_sender_create(int batch, int gso)
+{
+    udp_sender_t *s = NULL;
+
+    if (batch <= 0) {
+	batch = UDP_BATCH;
+    }
+
+    if ((s = calloc(1, sizeof(udp_sender_t))) == NULL) {
+	Log(ERROR, "udp: calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    s->batch = batch;
+    s->gso = gso ? gso_supported() : 0;
+    s->msgs = calloc(batch, sizeof(udp_msg_t));
+    s->slab = malloc(UDP_QUEUE_BYTES);
+    s->order = calloc(batch, sizeof(int));
+    s->nsegs = calloc(batch, sizeof(int));
+    s->mh = calloc(batch, sizeof(struct mmsghdr));
+    s->iov = calloc(batch, sizeof(struct iovec));
+    s->cmsg = calloc(batch, CMSG_SEG_SPACE);
+    if (!s->msgs || !s->slab || !s->order || !s->nsegs || !s->mh || !s->iov || !s->cmsg) {
+	Log(ERROR, "udp: calloc() failed: %s", strerror(errno));
+	udp_sender_destroy(s);
+	return NULL;
+    }
+
+    if (gso && !s->gso) {
+	Log(INFO, "udp: UDP GSO not supported, using plain sendmmsg()");
+    }
+
+    return s;
+}
+
+
+/**
+ * @brief 큐를 비우고 송신 객체 해제
+ * @param s - 송신 객체
+ * @return 없음
+ */
+void
+udp_sender_destroy(udp_sender_t *s)
+{
+    int i;
+
+    if (!s) {
+	return;
+    }
+    if (s->nmsgs > 0) {
+	udp_sender_flush(s);
+    }
+    for (i = 0; i < s->ndests; i++) {
+	close(s->dests[i].fd);
+    }
+    free(s->msgs);
+    free(s->slab);
+    free(s->order);
+    free(s->nsegs);
+    free(s->mh);
+    free(s->iov);
+    free(s->cmsg);
+    free(s);
+}
+
+
+/**
+ * @brief 목적지 인덱스 (없으면 connect() 된 소켓 생성)
+ * @return
+ *  성공 시 목적지 인덱스,\n
+ *  실패 시 -1
+ */
+static int
+dest_get(udp_sender_t *s, const char *ip, int port)
+{
+    struct sockaddr_storage ss;
+    struct sockaddr_in *sin = (struct sockaddr_in *) &ss;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &ss;
+    socklen_t sslen;
+    udp_dest_t *d = NULL;
+    int i, fd;
+
+    memset(&ss, 0, sizeof(ss));
+    if (inet_pton(AF_INET, ip, &sin->sin_addr) == 1) {
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(port);
+	sslen = sizeof(struct sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, ip, &sin6->sin6_addr) == 1) {
+	sin6->sin6_family = AF_INET6;
+	sin6->sin6_port = htons(port);
+	sslen = sizeof(struct sockaddr_in6);
+    }
+    else {
+	Log(ERROR, "udp: invalid address: %s", ip);
+	errno = EINVAL;
+	return -1;
+    }
+
+    for (i = 0; i < s->ndests; i++) {
+	if (s->dests[i].addrlen == sslen && memcmp(&s->dests[i].addr, &ss, sslen) == 0) {
+	    return i;
+	}
+    }
+
+    if ((fd = socket(ss.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) {
+	Log(ERROR, "udp: socket() failed: %s", strerror(errno));
+	return -1;
+    }
+    if (connect(fd, (struct sockaddr *) &ss, sslen) < 0) {
+	Log(ERROR, "udp: connect(%s:%d) failed: %s", ip, port, strerror(errno));
+	close(fd);
+	return -1;
+    }
+
+    if (s->ndests < UDP_MAX_DEST) {
+	i = s->ndests++;
+    }
+    else {
+	/* 목적지가 가득 참: 큐를 비우고 하나를 교체 */
+	udp_sender_flush(s);
+	i = s->evict++ % UDP_MAX_DEST;
+	close(s->dests[i].fd);
+    }
+    d = &s->dests[i];
+    memcpy(&d->addr, &ss, sslen);
+    d->addrlen = sslen;
+    d->fd = fd;
+    d->count = 0;
+
+    return i;
+}
+
+
+/**
+ * @brief datagram 을 큐에 넣음 (데이터는 복사됨)
+ * @param s - 송신 객체
+ * @param ip - 목적지 IP (IPv4 또는 IPv6)
+ * @param port - 목적지 포트
+ * @param data - 데이터
+ * @param len - 데이터 길이 (UDP_MAX_PAYLOAD 이하)
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 큐가 가득 차면 먼저 udp_sender_flush() 한다. 마지막에는 직접
+ * udp_sender_flush() 를 호출해야 큐에 남은 datagram 이 전송된다.
+ */
+int
+udp_sender_send(udp_sender_t *s, const char *ip, int port, const void *data, size_t len)
+{
+    udp_msg_t *m = NULL;
+    int d;
+
+    ASSERT(s != NULL && ip != NULL);
+
+    if (len > UDP_MAX_PAYLOAD) {
+	errno = EMSGSIZE;
+	return -1;
+    }
+    if ((d = dest_get(s, ip, port)) < 0) {
+	return -1;
+    }
+    if (s->nmsgs == s->batch || s->used + len > UDP_QUEUE_BYTES) {
+	udp_sender_flush(s);
+    }
+
+    m = &s->msgs[s->nmsgs++];
+    m->dest = d;
+    m->off = s->used;
+    m->len = len;
+    memcpy(s->slab + s->used, data, len);
+    s->used += len;
+    s->dests[d].count++;
+    s->stat.queued++;
+
+    return 0;
+}
+
+
+/**
+ * @brief s->order[pos..pos+n) 의 datagram 으로 mmsghdr 배열 구성
+ * @return mmsghdr 수
+ *
+ * GSO 사용 시 같은 크기의 연속 datagram (마지막은 더 작아도 됨)을 하나의
+ * 메시지로 묶고 UDP_SEGMENT 에 datagram 크기를 지정한다.
+ */
+static int
+build(udp_sender_t *s, int pos, int n)
+{
+    struct cmsghdr *cm = NULL;
+    struct msghdr *hdr = NULL;
+    udp_msg_t *m = NULL;
+    size_t seg = 0, bytes = 0;
+    int i, nmh = 0, nvec = 0, closed = 1;
+
+    for (i = pos; i < pos + n; i++) {
+	m = &s->msgs[s->order[i]];
+
+	if (s->gso && !closed && m->len > 0 && m->len <= seg &&
+		s->nsegs[nmh - 1] < UDP_GSO_MAX_SEGS && bytes + m->len <= UDP_GSO_MAX_BYTES) {
+	    /* 현재 메시지에 segment 추가 */
+	    s->iov[nvec].iov_base = s->slab + m->off;
+	    s->iov[nvec].iov_len = m->len;
+	    nvec++;
+	    s->mh[nmh - 1].msg_hdr.msg_iovlen++;
+	    s->nsegs[nmh - 1]++;
+	    bytes += m->len;
+	    closed = m->len < seg;	/* 짧은 segment 는 마지막이어야 함 */
+	    continue;
+	}
+
+	hdr = &s->mh[nmh].msg_hdr;
+	memset(&s->mh[nmh], 0, sizeof(struct mmsghdr));
+	s->iov[nvec].iov_base = s->slab + m->off;
+	s->iov[nvec].iov_len = m->len;
+	hdr->msg_iov = &s->iov[nvec];
+	hdr->msg_iovlen = 1;
+	s->nsegs[nmh] = 1;
+	nvec++;
+	nmh++;
+	seg = bytes = m->len;
+	closed = (m->len == 0);
+    }
+
+    /* 둘 이상 묶인 메시지에 UDP_SEGMENT 설정 */
+    for (i = 0; i < nmh; i++) {
+	if (s->nsegs[i] < 2) {
+	    continue;
+	}
+	hdr = &s->mh[i].msg_hdr;
+	hdr->msg_control = s->cmsg + i * CMSG_SEG_SPACE;
+	hdr->msg_controllen = CMSG_SEG_SPACE;
+	cm = CMSG_FIRSTHDR(hdr);
+	cm->cmsg_level = SOL_UDP;
+	cm->cmsg_type = UDP_SEGMENT;
+	cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	*(uint16_t *) CMSG_DATA(cm) = (uint16_t) hdr->msg_iov[0].iov_len;
+    }
+
+    return nmh;
+}
+
+
+/**
+ * @brief 목적지 \a d 의 큐를 sendmmsg() 로 전송
+ * @return
+ *  성공 시 0,\n
+ *  하나라도 버리면 -1
+ */
+static int
+flush_dest(udp_sender_t *s, int d)
+{
+    udp_dest_t *dest = &s->dests[d];
+    int i, n = 0, pos = 0, nmh, sent, k, retried = 0, result = 0;
+
+    for (i = 0; i < s->nmsgs; i++) {
+	if (s->msgs[i].dest == d) {
+	    s->order[n++] = i;
+	}
+    }
+
+    while (pos < n) {
+	nmh = build(s, pos, n - pos);
+	s->stat.syscalls++;
+	if ((sent = sendmmsg(dest->fd, s->mh, nmh, 0)) < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (s->gso && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)) {
+		/* 장치가 GSO 를 지원하지 않음: 일반 전송으로 다시 */
+		Log(WARN, "udp: UDP GSO send failed (%s), disabled", strerror(errno));
+		s->gso = 0;
+		continue;
+	    }
+	    if (errno == ECONNREFUSED && !retried) {
+		/* 이전 ICMP 에러가 보고된 것: 에러는 지워졌으므로 다시 시도 */
+		retried = 1;
+		continue;
+	    }
+	    /* 첫 메시지를 버리고 계속 */
+	    Log(ERROR, "udp: sendmmsg() failed: %s", strerror(errno));
+	    s->stat.dropped += s->nsegs[0];
+	    pos += s->nsegs[0];
+	    result = -1;
+	    continue;
+	}
+	for (k = 0; k < sent; k++) {
+	    pos += s->nsegs[k];
+	    s->stat.sent += s->nsegs[k];
+	}
+	retried = 0;
+    }
+    dest->count = 0;
+
+    return result;
+}
+
+
+/**
+ * @brief 큐에 있는 datagram 을 목적지별 sendmmsg() 로 모두 전송
+ * @param s - 송신 객체
+ * @return
+ *  성공 시 보낸 datagram 수,\n
+ *  하나라도 버리면 -1 (udp_sender_stat() 의 dropped 참고)
+ */
+int
+udp_sender_flush(udp_sender_t *s)
+{
+    unsigned long before = s->stat.sent;
+    int d, result = 0;
+
+    for (d = 0; d < s->ndests && s->nmsgs > 0; d++) {
+	if (s->dests[d].count > 0 && flush_dest(s, d) < 0) {
+	    result = -1;
+	}
+    }
+    s->nmsgs = 0;
+    s->used = 0;
+
+    return result < 0 ? -1 : (int) (s->stat.sent - before);
+}
+
+
+/**
+ * @brief GSO 사용 여부
+ */
+int
+udp_sender_gso(const udp_sender_t *s)
+{
+    return s->gso;
+}
+
+
+/**
+ * @brief 송신 통계
+ */
+void
+udp_sender_stat(const udp_sender_t *s, udp_sender_stat_t *stat)
+{
+    *stat = s->stat;
+}
+
+
+/**
+ * @brief UDP 수신 객체 생성 (bind)
+ * @param ip - bind 할 IP (NULL 이면 모든 IPv4 주소, IPv6 주소 가능)
+ * @param port - bind 할 포트
+ * @param reuseport - 0 이 아니면 SO_REUSEPORT (쓰레드마다 수신 객체 생성)
+ * @param batch - 한번에 받는 최대 datagram 수 (0 이면 UDP_RECV_BATCH)
+ * @param slotsize - datagram 버퍼 크기 (0 이면 UDP_RECV_SLOT, 더 큰 datagram 은 잘림)
+ * @return
+ *  성공 시 수신 객체,\n
+ *  실패 시 NULL
+ */
+udp_receiver_t *
+udp_receiver_create(const char *ip, int port, int reuseport, int batch, size_t slotsize)
+{
+    struct sockaddr_storage ss;
+    struct sockaddr_in *sin = (struct sockaddr_in *) &ss;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &ss;
+    socklen_t sslen;
+    udp_receiver_t *r = NULL;
+    int on = 1;
+
+    if (batch <= 0) {
+	batch = UDP_RECV_BATCH;
+    }
+    if (slotsize == 0) {
+	slotsize = UDP_RECV_SLOT;
+    }
+
+    memset(&ss, 0, sizeof(ss));
+    if (!ip || inet_pton(AF_INET, ip, &sin->sin_addr) == 1) {
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(port);
+	if (!ip) {
+	    sin->sin_addr.s_addr = htonl(INADDR_ANY);
+	}
+	sslen = sizeof(struct sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, ip, &sin6->sin6_addr) == 1) {
+	sin6->sin6_family = AF_INET6;
+	sin6->sin6_port = htons(port);
+	sslen = sizeof(struct sockaddr_in6);
+    }
+    else {
+	Log(ERROR, "udp: invalid address: %s", ip);
+	errno = EINVAL;
+	return NULL;
+    }
+
+    if ((r = calloc(1, sizeof(udp_receiver_t))) == NULL) {
+	Log(ERROR, "udp: calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    r->fd = -1;
+    r->batch = batch;
+    r->slotsize = slotsize;
+    r->slab = malloc(batch * slotsize);
+    r->cmsg = calloc(batch, CMSG_RECV_SPACE);
+    r->mh = calloc(batch, sizeof(struct mmsghdr));
+    r->iov = calloc(batch, sizeof(struct iovec));
+    r->dgrams = calloc(batch, sizeof(udp_datagram_t));
+    if (!r->slab || !r->cmsg || !r->mh || !r->iov || !r->dgrams) {
+	Log(ERROR, "udp: calloc() failed: %s", strerror(errno));
+	udp_receiver_destroy(r);
+	return NULL;
+    }
+
+    if ((r->fd = socket(ss.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) {
+	Log(ERROR, "udp: socket() failed: %s", strerror(errno));
+	udp_receiver_destroy(r);
+	return NULL;
+    }
+    setsockopt(r->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (reuseport && setsockopt(r->fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+	Log(ERROR, "udp: setsockopt(SO_REUSEPORT) failed: %s", strerror(errno));
+	udp_receiver_destroy(r);
+	return NULL;
+    }
+    /* 수신 시각과 drop 수는 없어도 동작 */
+    if (setsockopt(r->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+	Log(WARN, "udp: setsockopt(SO_TIMESTAMPNS) failed: %s", strerror(errno));
+    }
+    if (setsockopt(r->fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+	Log(WARN, "udp: setsockopt(SO_RXQ_OVFL) failed: %s", strerror(errno));
+    }
+    if (bind(r->fd, (struct sockaddr *) &ss, sslen) < 0) {
+	Log(ERROR, "udp: bind(%d) failed: %s", port, strerror(errno));
+	udp_receiver_destroy(r);
+	return NULL;
+    }
+
+    return r;
+}
+
+
+/**
+ * @brief UDP 수신 객체 해제 (소켓 close)
+ * @param r - 수신 객체
+ * @return 없음
+ */
+void
+udp_receiver_destroy(udp_receiver_t *r)
+{
+    if (!r) {
+	return;
+    }
+    if (r->fd >= 0) {
+	close(r->fd);
+    }
+    free(r->slab);
+    free(r->cmsg);
+    free(r->mh);
+    free(r->iov);
+    free(r->dgrams);
+    free(r);
+}
+
+
+/**
+ * @brief 수신 소켓 (event_add() 등록 또는 setsockopt() 용)
+ */
+int
+udp_receiver_fd(const udp_receiver_t *r)
+{
+    return r->fd;
+}
+
+
+/**
+ * @brief recvmmsg() 로 datagram 을 한번에 여러개 수신
+ * @param r - 수신 객체
+ * @param dgrams - (OUT) datagram 배열 (다음 udp_receiver_recv() 호출 전까지 유효)
+ * @param wait - 0 이 아니면 첫 datagram 이 올 때까지 대기
+ * @return
+ *  성공 시 받은 datagram 수 (wait 가 0 이고 받을 것이 없으면 0),\n
+ *  실패 시 -1
+ */
+int
+udp_receiver_recv(udp_receiver_t *r, const udp_datagram_t **dgrams, int wait)
+{
+    struct msghdr *hdr = NULL;
+    struct cmsghdr *cm = NULL;
+    udp_datagram_t *dg = NULL;
+    uint32_t drops;
+    int i, n;
+
+    ASSERT(r != NULL && dgrams != NULL);
+
+    for (i = 0; i < r->batch; i++) {
+	hdr = &r->mh[i].msg_hdr;
+	r->iov[i].iov_base = r->slab + i * r->slotsize;
+	r->iov[i].iov_len = r->slotsize;
+	hdr->msg_name = &r->dgrams[i].addr;
+	hdr->msg_namelen = sizeof(struct sockaddr_storage);
+	hdr->msg_iov = &r->iov[i];
+	hdr->msg_iovlen = 1;
+	hdr->msg_control = r->cmsg + i * CMSG_RECV_SPACE;
+	hdr->msg_controllen = CMSG_RECV_SPACE;
+	hdr->msg_flags = 0;
+    }
+
+    while ((n = recvmmsg(r->fd, r->mh, r->batch, wait ? MSG_WAITFORONE : MSG_DONTWAIT, NULL)) < 0) {
+	if (errno == EINTR) {
+	    continue;
+	}
+	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    *dgrams = r->dgrams;
+	    return 0;
+	}
+	Log(ERROR, "udp: recvmmsg() failed: %s", strerror(errno));
+	return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+	hdr = &r->mh[i].msg_hdr;
+	dg = &r->dgrams[i];
+	dg->addrlen = hdr->msg_namelen;
+	dg->data = r->iov[i].iov_base;
+	dg->len = r->mh[i].msg_len;
+	dg->truncated = (hdr->msg_flags & MSG_TRUNC) != 0;
+	dg->ts.tv_sec = 0;
+	dg->ts.tv_nsec = 0;
+	for (cm = CMSG_FIRSTHDR(hdr); cm; cm = CMSG_NXTHDR(hdr, cm)) {
+	    if (cm->cmsg_level != SOL_SOCKET) {
+		continue;
+	    }
+	    if (cm->cmsg_type == SCM_TIMESTAMPNS) {
+		memcpy(&dg->ts, CMSG_DATA(cm), sizeof(struct timespec));
+	    }
+	    else if (cm->cmsg_type == SO_RXQ_OVFL) {
+		memcpy(&drops, CMSG_DATA(cm), sizeof(drops));
+		r->drops = drops;
+	    }
+	}
+    }
+
+    *dgrams = r->dgrams;
+    return n;
+}
+
+
+/**
+ * @brief 소켓 수신큐 overflow 로 커널이 버린 datagram 누적 수 (SO_RXQ_OVFL)
+ *
+ * 커널은 이 값을 datagram 과 함께 전달하므로, 마지막으로 받은 datagram 이
+ * 수신큐에 들어간 시점까지의 값이다.
+ */
+unsigned long
+udp_receiver_drops(const udp_receiver_t *r)
+{
+    return r->drops;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file onvudp.h
+ * @brief UDP 일괄 송수신 (sendmmsg/recvmmsg, UDP GSO) 헤더
+ */
+
+/*
+ * UDP 일괄 송수신 (sendmmsg/recvmmsg, UDP GSO) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_UDP_H
+#define ONV_UDP_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define UDP_BATCH		64	/**< 기본 한번에 보내는 최대 datagram 수 */
+#define UDP_MAX_DEST		64	/**< 송신 객체당 최대 목적지 수 */
+#define UDP_MAX_PAYLOAD		65507	/**< datagram 최대 크기 */
+#define UDP_QUEUE_BYTES		(256 * 1024)	/**< 큐에 쌓을 수 있는 최대 바이트수 */
+#define UDP_GSO_MAX_SEGS	64	/**< GSO 한번에 묶는 최대 datagram 수 */
+#define UDP_GSO_MAX_BYTES	65000	/**< GSO 한번에 묶는 최대 바이트수 */
+#define UDP_RECV_BATCH		64	/**< 기본 한번에 받는 최대 datagram 수 */
+#define UDP_RECV_SLOT		2048	/**< 기본 datagram 버퍼 크기 */
+
+typedef struct udp_sender_s udp_sender_t;
+typedef struct udp_receiver_s udp_receiver_t;
+
+/**
+ * UDP 송신 통계
+ */
+typedef struct udp_sender_stat_s
+{
+    unsigned long queued;	/**< 큐에 넣은 datagram 수 */
+    unsigned long sent;		/**< 보낸 datagram 수 */
+    unsigned long dropped;	/**< 에러로 버린 datagram 수 */
+    unsigned long syscalls;	/**< sendmmsg() 호출 수 */
+} udp_sender_stat_t;
+
+udp_sender_t *udp_sender_create(int batch, int gso);
+void udp_sender_destroy(udp_sender_t *s);
+int udp_sender_send(udp_sender_t *s, const char *ip, int port, const void *data, size_t len);
+int udp_sender_flush(udp_sender_t *s);
+int udp_sender_gso(const udp_sender_t *s);
+void udp_sender_stat(const udp_sender_t *s, udp_sender_stat_t *stat);
+
+/**
+ * 수신한 datagram (data 는 수신 객체의 버퍼를 가리킴)
+ */
+typedef struct udp_datagram_s
+{
+    struct sockaddr_storage addr;	/**< 보낸 쪽 주소 */
+    socklen_t addrlen;			/**< \a addr 의 길이 */
+    const char *data;			/**< 데이터 */
+    size_t len;				/**< 데이터 길이 */
+    int truncated;			/**< 버퍼보다 커서 잘렸으면 1 */
+    struct timespec ts;			/**< 커널 수신 시각 (CLOCK_REALTIME, 없으면 0) */
+} udp_datagram_t;
+
+udp_receiver_t *udp_receiver_create(const char *ip, int port, int reuseport, int batch, size_t slotsize);
+void udp_receiver_destroy(udp_receiver_t *r);
+int udp_receiver_fd(const udp_receiver_t *r);
+int udp_receiver_recv(udp_receiver_t *r, const udp_datagram_t **dgrams, int wait);
+unsigned long udp_receiver_drops(const udp_receiver_t *r);
+
+#endif
@@ -0,0 +1,460 @@
+/**
+ * @file onvunix.c
+ * @brief Unix 도메인 소켓 (로컬 IPC, fd/credential 전달)
+ */
+
+/*
+ * Unix 도메인 소켓 (로컬 IPC, fd/credential 전달)
+ *
+ * 같은 호스트의 프로세스끼리 tcp_Connect("127.0.0.1", ...) 로 통신하면 TCP
+ * 스택 전체를 거친다. socket_listen()/tcp_Connect() 에 대응하는 AF_UNIX
+ * stream/seqpacket 함수와, 연결된 소켓으로 fd(SCM_RIGHTS) 와 프로세스
+ * credential(SCM_CREDENTIALS) 을 전달하는 함수를 제공한다. accept 한 연결을
+ * 다른 프로세스에 넘길 때도 사용한다 (onvupgrade 도 이것을 사용한다).
+ *
+ * 경로가 '@' 로 시작하면 파일시스템에 파일을 만들지 않는 abstract
+ * namespace 주소를 사용한다 ("@name").
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvunix.h"
+
+static int unix_addr(const char *path, struct sockaddr_un *sun, socklen_t *len);
+
+
+/**
+ * @brief 경로를 Unix 소켓 주소로 변환 ('@' 로 시작하면 abstract namespace)
+ * @return
+ *  성공 시 0,\n
+ *  경로가 너무 길면 -1 (EINVAL)
+ */
+static int
+unix_addr(const char *path, struct sockaddr_un *sun, socklen_t *len)
+{
+    size_t n = strlen(path);
+
+    if (n == 0 || n >= sizeof(sun->sun_path)) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    memset(sun, 0, sizeof(struct sockaddr_un));
+    sun->sun_family = AF_UNIX;
+    memcpy(sun->sun_path, path, n);
+    if (path[0] == '@') {
+	sun->sun_path[0] = '\0';
+	*len = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + n);
+    }
+    else {
+	*len = (socklen_t) sizeof(struct sockaddr_un);
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Unix 소켓 리슨 (socket_listen() 대응)
+ * @param path - 소켓 경로 ('@' 로 시작하면 abstract namespace)
+ * @param type - SOCK_STREAM 또는 SOCK_SEQPACKET
+ * @return
+ *  성공 시 socket descriptor,\n
+ *  실패 시 -1
+ *
+ * 파일 경로는 남아있는 이전 소켓 파일을 지우고 bind 한다.
+ */
+int
+unix_listen(const char *path, int type)
+{
+    struct sockaddr_un sun;
+    socklen_t len;
+    int fd;
+
+    ASSERT(path != NULL);
+
+    if (unix_addr(path, &sun, &len) < 0) {
+	return -1;
+    }
+    if ((fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0)) < 0) {
+	return -1;
+    }
+    if (path[0] != '@') {
+	unlink(path);
+    }
+    if (bind(fd, (struct sockaddr *) &sun, len) < 0 || listen(fd, UNIX_BACKLOG) < 0) {
+	Log(ERROR, "unix socket %s: %s", path, strerror(errno));
+	close(fd);
+	return -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * @brief Unix 소켓 접속 (tcp_Connect() 대응)
+ * @param path - 소켓 경로 ('@' 로 시작하면 abstract namespace)
+ * @param type - SOCK_STREAM 또는 SOCK_SEQPACKET
+ * @return
+ *  성공 시 socket descriptor,\n
+ *  실패 시 -1 (리슨하는 쪽이 없으면 ENOENT 또는 ECONNREFUSED)
+ */
+int
+unix_connect(const char *path, int type)
+{
+    struct sockaddr_un sun;
+    socklen_t len;
+    int fd, n;
+
+    ASSERT(path != NULL);
+
+    if (unix_addr(path, &sun, &len) < 0) {
+	return -1;
+    }
+    if ((fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0)) < 0) {
+	return -1;
+    }
+    while ((n = connect(fd, (struct sockaddr *) &sun, len)) < 0 && errno == EINTR) {
+	;
+    }
+    if (n < 0) {
+	n = errno;
+	close(fd);
+	errno = n;
+	return -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * @brief Unix 소켓 연결 받기
+ * @param listenfd - unix_listen() 소켓
+ * @param cred - (OUT) 접속한 프로세스의 pid/uid/gid (NULL 가능)
+ * @return
+ *  성공 시 socket descriptor (close-on-exec),\n
+ *  실패 시 -1
+ */
+int
+unix_accept(int listenfd, struct ucred *cred)
+{
+    int fd;
+
+    while ((fd = accept4(listenfd, NULL, NULL, SOCK_CLOEXEC)) < 0) {
+	if (errno != EINTR && errno != ECONNABORTED) {
+	    return -1;
+	}
+    }
+
+    if (cred && unix_peercred(fd, cred) < 0) {
+	close(fd);
+	return -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * @brief 연결 상대 프로세스의 credential (SO_PEERCRED)
+ * @param fd - 연결된 Unix 소켓
+ * @param cred - (OUT) connect/listen 시점의 pid/uid/gid
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+unix_peercred(int fd, struct ucred *cred)
+{
+    socklen_t len = sizeof(struct ucred);
+
+    ASSERT(cred != NULL);
+
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, cred, &len);
+}
+
+
+/**
+ * @brief credential 수신 허용 (SO_PASSCRED, unix_recv_cred() 전에 호출)
+ * @param fd - Unix 소켓
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 상대방이 보내기 전에 설정해야 그 메시지에 credential 이 붙는다.
+ */
+int
+unix_passcred(int fd)
+{
+    const int on = 1;
+
+    return setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, (socklen_t) sizeof(on));
+}
+
+
+/**
+ * @brief 데이터와 함께 fd 전달 (SCM_RIGHTS)
+ * @param fd - 연결된 Unix 소켓
+ * @param data - 함께 보낼 데이터 (1 바이트 이상)
+ * @param len - 데이터 길이
+ * @param fds - 전달할 fd 배열 (받는 쪽에 복제되며 보내는 쪽 fd 는 그대로)
+ * @param nfds - \a fds 의 갯수 (UNIX_MAX_FDS 이하)
+ * @return
+ *  성공 시 보낸 바이트 수,\n
+ *  실패 시 -1
+ */
+ssize_t
+unix_send_fds(int fd, const void *data, size_t len, const int *fds, int nfds)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg = NULL;
+    union {
+	char buf[CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS)];
+	struct cmsghdr align;
+    } ctrl;
+    ssize_t n;
+
+    ASSERT(data != NULL && (fds != NULL || nfds == 0));
+
+    if (len == 0 || nfds < 0 || nfds > UNIX_MAX_FDS) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (nfds > 0) {
+	memset(&ctrl, 0, sizeof(ctrl));
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    }
+
+    while ((n = sendmsg(fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR) {
+	;
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief 데이터와 함께 전달된 fd 받기
+ * @param fd - 연결된 Unix 소켓
+ * @param data - (OUT) 데이터 버퍼
+ * @param len - 버퍼 크기
+ * @param fds - (OUT) 받은 fd (close-on-exec)
+ * @param nfds - (IN) \a fds 의 크기, (OUT) 받은 fd 갯수
+ * @return
+ *  성공 시 받은 바이트 수 (연결 종료 시 0),\n
+ *  실패 시 -1
+ *
+ * \a fds 에 다 담지 못한 fd 는 닫는다. stream 소켓에서는 fd 가 붙은
+ * 메시지의 경계에서 읽기가 나뉘므로 보낸 크기만큼 읽는다.
+ */
+ssize_t
+unix_recv_fds(int fd, void *data, size_t len, int *fds, int *nfds)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg = NULL;
+    union {
+	char buf[CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS)];
+	struct cmsghdr align;
+    } ctrl;
+    int i, n, got = 0, max;
+    int *rfds = NULL;
+    ssize_t nread;
+
+    ASSERT(data != NULL && fds != NULL && nfds != NULL);
+
+    max = *nfds;
+    *nfds = 0;
+
+    iov.iov_base = data;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    while ((nread = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+	;
+    }
+    if (nread < 0) {
+	return -1;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+	    continue;
+	}
+	n = (int) ((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+	rfds = (int *) CMSG_DATA(cmsg);
+	for (i = 0; i < n; i++) {
+	    if (got < max) {
+		fds[got++] = rfds[i];
+	    }
+	    else {
+		close(rfds[i]);
+	    }
+	}
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+	Log(WARN, "unix_recv_fds: control message truncated, fds dropped");
+    }
+
+    *nfds = got;
+    return nread;
+}
+
+
+/**
+ * @brief 자신의 credential 을 붙여서 데이터 전송 (SCM_CREDENTIALS)
+ * @param fd - 연결된 Unix 소켓
+ * @param data - 데이터 (1 바이트 이상)
+ * @param len - 데이터 길이
+ * @return
+ *  성공 시 보낸 바이트 수,\n
+ *  실패 시 -1
+ *
+ * 커널이 pid/uid/gid 를 검증하므로 받는 쪽은 값을 믿을 수 있다.
+ */
+ssize_t
+unix_send_cred(int fd, const void *data, size_t len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg = NULL;
+    struct ucred cred;
+    union {
+	char buf[CMSG_SPACE(sizeof(struct ucred))];
+	struct cmsghdr align;
+    } ctrl;
+    ssize_t n;
+
+    ASSERT(data != NULL);
+
+    if (len == 0) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    cred.pid = getpid();
+    cred.uid = getuid();
+    cred.gid = getgid();
+
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctrl, 0, sizeof(ctrl));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_CREDENTIALS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+    memcpy(CMSG_DATA(cmsg), &cred, sizeof(cred));
+
+    while ((n = sendmsg(fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR) {
+	;
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief 데이터와 보낸 프로세스의 credential 받기
+ * @param fd - unix_passcred() 를 설정한 Unix 소켓
+ * @param data - (OUT) 데이터 버퍼
+ * @param len - 버퍼 크기
+ * @param cred - (OUT) 보낸 프로세스의 pid/uid/gid (없으면 pid 0)
+ * @return
+ *  성공 시 받은 바이트 수 (연결 종료 시 0),\n
+ *  실패 시 -1
+ */
+ssize_t
+unix_recv_cred(int fd, void *data, size_t len, struct ucred *cred)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg = NULL;
+    union {
+	char buf[CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS)];
+	struct cmsghdr align;
+    } ctrl;
+    ssize_t nread;
+    int i, n;
+
+    ASSERT(data != NULL && cred != NULL);
+
+    memset(cred, 0, sizeof(struct ucred));
+    iov.iov_base = data;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    while ((nread = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+	;
+    }
+    if (nread < 0) {
+	return -1;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	if (cmsg->cmsg_level != SOL_SOCKET) {
+	    continue;
+	}
+	if (cmsg->cmsg_type == SCM_CREDENTIALS) {
+	    memcpy(cred, CMSG_DATA(cmsg), sizeof(struct ucred));
+	}
+	else if (cmsg->cmsg_type == SCM_RIGHTS) {
+	    /* 같이 온 fd 는 받지 않으므로 닫음 */
+	    n = (int) ((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+	    for (i = 0; i < n; i++) {
+		close(((int *) CMSG_DATA(cmsg))[i]);
+	    }
+	}
+    }
+
+    return nread;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file onvunix.h
+ * @brief Unix 도메인 소켓 (로컬 IPC, fd/credential 전달) 헤더
+ */
+
+/*
+ * Unix 도메인 소켓 (로컬 IPC, fd/credential 전달) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_UNIX_H
+#define ONV_UNIX_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define UNIX_MAX_FDS	64	/**< 한번에 전달할 수 있는 최대 fd 수 */
+#define UNIX_BACKLOG	1024	/**< unix_listen() backlog */
+
+struct ucred;
+
+int unix_listen(const char *path, int type);
+int unix_connect(const char *path, int type);
+int unix_accept(int listenfd, struct ucred *cred);
+int unix_peercred(int fd, struct ucred *cred);
+int unix_passcred(int fd);
+ssize_t unix_send_fds(int fd, const void *data, size_t len, const int *fds, int nfds);
+ssize_t unix_recv_fds(int fd, void *data, size_t len, int *fds, int *nfds);
+ssize_t unix_send_cred(int fd, const void *data, size_t len);
+ssize_t unix_recv_cred(int fd, void *data, size_t len, struct ucred *cred);
+
+#endif
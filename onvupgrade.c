@@ -0,0 +1,414 @@
+/**
+ * @file onvupgrade.c
+ * @brief 무중단 바이너리 업그레이드(리슨 소켓 인계)
+ */
+
+/*
+ * 무중단 바이너리 업그레이드(리슨 소켓 인계)
+ *
+ * 실행중인 프로세스가 리슨 소켓을 새 바이너리에 넘겨주고, 새 프로세스가
+ * 준비완료를 알리면 처리중인 연결만 마무리한 뒤 종료한다. 리슨 소켓이
+ * 닫히지 않으므로 accept queue 가 유지되고 연결 거부 구간이 없다.
+ *
+ * 인계 방법은 두가지이다.
+ *  - upgrade_exec() : 이전 프로세스가 새 바이너리를 직접 실행하며 fd 를
+ *    상속시킨다. fd 목록은 ONV_LISTEN_FDS 환경변수로 전달된다.
+ *  - upgrade_send_fds() / upgrade_recv_fds() : 외부에서 실행된 새 프로세스가
+ *    Unix 소켓으로 접속하면 SCM_RIGHTS 로 fd 를 넘겨준다 (onvunix).
+ *    UNIX_MAX_FDS 개씩 나누어 보내며, 메시지마다 1 바이트 데이터로 뒤에
+ *    메시지가 더 있는지 (1) 마지막인지 (0) 알린다.
+ *    경로가 '@' 로 시작하면 abstract namespace 를 사용한다.
+ *
+ * 어느 경우든 새 프로세스는 upgrade_inherited_fd() 로 리슨 소켓을 찾고,
+ * 준비가 끝나면 upgrade_notify_ready() 를 호출한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvunix.h"
+#include "onvupgrade.h"
+
+/* 준비완료를 통지할 fd (파이프 또는 Unix 소켓) */
+static int ready_fd = -1;
+
+static int sock_port(int fd);
+static int set_fds_env(const int *fds, int nfds);
+
+
+/**
+ * @brief 리슨 소켓의 포트 번호 확인
+ * @param fd - Socket descriptor
+ * @return
+ *  리슨중인 TCP 소켓이면 포트 번호,\n
+ *  아니면 -1
+ */
+static int
+sock_port(int fd)
+{
+    struct sockaddr_storage ss;
+    socklen_t len = sizeof(ss);
+    int listening = 0;
+    socklen_t optlen = sizeof(listening);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &optlen) < 0 || !listening) {
+	return -1;
+    }
+    if (getsockname(fd, (struct sockaddr *) &ss, &len) < 0) {
+	return -1;
+    }
+
+    if (ss.ss_family == AF_INET) {
+	return ntohs(((struct sockaddr_in *) &ss)->sin_port);
+    }
+    if (ss.ss_family == AF_INET6) {
+	return ntohs(((struct sockaddr_in6 *) &ss)->sin6_port);
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief fd 목록을 ONV_LISTEN_FDS 환경변수로 설정
+ * @param fds - fd 배열
+ * @param nfds - \a fds 의 갯수
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+static int
+set_fds_env(const int *fds, int nfds)
+{
+    char buf[UPGRADE_MAX_FDS * 12];
+    size_t len = 0;
+    int i;
+
+    buf[0] = '\0';
+    for (i = 0; i < nfds && i < UPGRADE_MAX_FDS; i++) {
+	len += snprintf(buf + len, sizeof(buf) - len, i ? ",%d" : "%d", fds[i]);
+    }
+
+    return setenv(UPGRADE_ENV_FDS, buf, 1);
+}
+
+
+/**
+ * @brief 리슨 소켓을 상속시켜 새 바이너리 실행
+ * @param argv - 실행할 프로그램과 인자 (argv[0] 은 경로)
+ * @param fds - 인계할 리슨 소켓 배열
+ * @param nfds - \a fds 의 갯수
+ * @param readyfd - (OUT) 준비완료 통지를 받을 파이프 (upgrade_wait_ready() 후 close)
+ * @return
+ *  성공 시 새 프로세스 pid,\n
+ *  실패 시 -1
+ */
+pid_t
+upgrade_exec(char *const argv[], const int *fds, int nfds, int *readyfd)
+{
+    int pfd[2], i;
+    char buf[16];
+    sigset_t empty;
+    pid_t pid;
+
+    ASSERT(argv != NULL && argv[0] != NULL && readyfd != NULL);
+
+    if (nfds <= 0 || nfds > UPGRADE_MAX_FDS) {
+	errno = EINVAL;
+	return -1;
+    }
+    if (pipe(pfd) < 0) {
+	return -1;
+    }
+
+    if ((pid = fork()) < 0) {
+	close(pfd[0]);
+	close(pfd[1]);
+	return -1;
+    }
+
+    if (pid == 0) {
+	close(pfd[0]);
+	for (i = 0; i < nfds; i++) {
+	    fcntl(fds[i], F_SETFD, 0);	/* FD_CLOEXEC 해제 */
+	}
+	snprintf(buf, sizeof(buf), "%d", pfd[1]);
+	if (set_fds_env(fds, nfds) < 0 || setenv(UPGRADE_ENV_READY, buf, 1) < 0) {
+	    _exit(EXIT_FAILURE);
+	}
+
+	/* 마스터가 막아둔 시그널 마스크는 exec 후에도 유지되므로 해제 */
+	sigemptyset(&empty);
+	sigprocmask(SIG_SETMASK, &empty, NULL);
+
+	execv(argv[0], argv);
+	Log(ERROR, "execv(%s) failed: %s", argv[0], strerror(errno));
+	_exit(EXIT_FAILURE);
+    }
+
+    close(pfd[1]);
+    fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+    *readyfd = pfd[0];
+
+    return pid;
+}
+
+
+/**
+ * @brief 새 프로세스의 준비완료 통지 대기
+ * @param readyfd - 통지를 받을 fd (upgrade_exec() 의 readyfd)
+ * @param timeout - 최대 대기시간(초)
+ * @return
+ *  준비완료 통지를 받으면 0,\n
+ *  Timeout 또는 새 프로세스가 통지 없이 종료하면 -1
+ */
+int
+upgrade_wait_ready(int readyfd, int timeout)
+{
+    struct pollfd pfd;
+    char c;
+    int n;
+
+    pfd.fd = readyfd;
+    pfd.events = POLLIN;
+
+again:
+    if ((n = poll(&pfd, 1, timeout * 1000)) < 0) {
+	if (errno == EINTR) {
+	    goto again;
+	}
+	return -1;
+    }
+    if (n == 0) {
+	errno = ETIMEDOUT;
+	return -1;
+    }
+
+    return (read(readyfd, &c, 1) == 1) ? 0 : -1;
+}
+
+
+/**
+ * @brief Unix 소켓으로 리슨 소켓을 넘겨주고 준비완료 통지 대기
+ * @param path - Unix 소켓 경로
+ * @param fds - 인계할 리슨 소켓 배열
+ * @param nfds - \a fds 의 갯수
+ * @param timeout - 새 프로세스 접속 및 준비완료 대기시간(초)
+ * @return
+ *  새 프로세스가 준비완료를 통지하면 0,\n
+ *  실패 또는 Timeout 시 -1
+ */
+int
+upgrade_send_fds(const char *path, const int *fds, int nfds, int timeout)
+{
+    struct pollfd pfd;
+    char more;
+    int lfd, cfd = -1, i, n, result = -1;
+
+    ASSERT(path != NULL && fds != NULL);
+
+    if (nfds <= 0 || nfds > UPGRADE_MAX_FDS) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    if ((lfd = unix_listen(path, SOCK_STREAM)) < 0) {
+	return -1;
+    }
+
+    pfd.fd = lfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout * 1000) <= 0 || (cfd = unix_accept(lfd, NULL)) < 0) {
+	Log(ERROR, "upgrade: no new process connected to %s", path);
+	goto cleanup;
+    }
+
+    for (i = 0; i < nfds; i += n) {
+	n = nfds - i > UNIX_MAX_FDS ? UNIX_MAX_FDS : nfds - i;
+	more = (char) (i + n < nfds);
+	if (unix_send_fds(cfd, &more, 1, fds + i, n) != 1) {
+	    Log(ERROR, "upgrade: sendmsg() failed: %s", strerror(errno));
+	    goto cleanup;
+	}
+    }
+
+    result = upgrade_wait_ready(cfd, timeout);
+
+cleanup:
+    if (cfd >= 0) {
+	close(cfd);
+    }
+    close(lfd);
+    if (path[0] != '@') {
+	unlink(path);
+    }
+
+    return result;
+}
+
+
+/**
+ * @brief 상속받은 리슨 소켓 검색
+ * @param port - 찾을 포트 번호 (0 이면 첫번째 소켓)
+ * @return
+ *  성공 시 socket descriptor,\n
+ *  상속받은 소켓이 없으면 -1
+ *
+ * upgrade_exec() 로 실행되었거나 upgrade_recv_fds() 로 받은 소켓 중에서
+ * \a port 로 리슨중인 소켓을 반환한다.
+ */
+int
+upgrade_inherited_fd(int port)
+{
+    int fd;
+
+    return (upgrade_inherited_fds(port, &fd, 1) == 1) ? fd : -1;
+}
+
+
+/**
+ * @brief 상속받은 리슨 소켓을 모두 검색
+ * @param port - 찾을 포트 번호 (0 이면 모든 소켓)
+ * @param fds - (OUT) 찾은 소켓을 저장할 배열
+ * @param maxfds - \a fds 의 크기
+ * @return 찾은 소켓 갯수 (없으면 0)
+ *
+ * SO_REUSEPORT 로 같은 포트에 여러 소켓을 리슨하던 경우에 사용한다.
+ * 준비완료 통지 fd 도 여기서 확인한다.
+ */
+int
+upgrade_inherited_fds(int port, int *fds, int maxfds)
+{
+    char *env = NULL, *p = NULL;
+    int fd, n = 0;
+
+    if ((env = getenv(UPGRADE_ENV_READY)) != NULL) {
+	ready_fd = atoi(env);
+	fcntl(ready_fd, F_SETFD, FD_CLOEXEC);
+	unsetenv(UPGRADE_ENV_READY);
+    }
+
+    if ((env = getenv(UPGRADE_ENV_FDS)) == NULL) {
+	return 0;
+    }
+
+    for (p = env; *p != '\0' && n < maxfds; ) {
+	fd = (int) strtol(p, &p, 10);
+	if (fd > 2 && (port == 0 || sock_port(fd) == port)) {
+	    fcntl(fd, F_SETFD, FD_CLOEXEC);
+	    fds[n++] = fd;
+	}
+	if (*p == ',') {
+	    p++;
+	}
+	else {
+	    break;
+	}
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Unix 소켓으로 이전 프로세스의 리슨 소켓을 넘겨받음
+ * @param path - Unix 소켓 경로
+ * @param fds - (OUT) 받은 fd 를 저장할 배열
+ * @param maxfds - \a fds 의 크기
+ * @param timeout - 이전 프로세스 접속 대기시간(초)
+ * @return
+ *  성공 시 받은 fd 갯수,\n
+ *  실패 시 -1
+ *
+ * 받은 fd 는 ONV_LISTEN_FDS 에 등록되므로 upgrade_inherited_fd() 로 찾을 수
+ * 있다. 준비가 끝나면 upgrade_notify_ready() 로 이전 프로세스에 알린다.
+ */
+int
+upgrade_recv_fds(const char *path, int *fds, int maxfds, int timeout)
+{
+    char more;
+    int fd, n, total = 0;
+    time_t deadline;
+
+    ASSERT(path != NULL && fds != NULL);
+
+    /* 이전 프로세스가 아직 소켓을 열지 않았으면 잠시 재시도 */
+    deadline = time(NULL) + timeout;
+    while ((fd = unix_connect(path, SOCK_STREAM)) < 0) {
+	if ((errno != ENOENT && errno != ECONNREFUSED) || time(NULL) >= deadline) {
+	    return -1;
+	}
+	usleep(100 * 1000);
+    }
+
+    /* maxfds 를 넘는 fd 는 unix_recv_fds() 가 닫는다 */
+    do {
+	n = maxfds - total;
+	if (unix_recv_fds(fd, &more, 1, fds + total, &n) <= 0) {
+	    while (--total >= 0) {
+		close(fds[total]);
+	    }
+	    close(fd);
+	    return -1;
+	}
+	total += n;
+    } while (more);
+
+    if (total <= 0 || set_fds_env(fds, total) < 0) {
+	while (--total >= 0) {
+	    close(fds[total]);
+	}
+	close(fd);
+	return -1;
+    }
+
+    /* 준비완료 통지는 같은 연결로 보낸다 */
+    ready_fd = fd;
+
+    return total;
+}
+
+
+/**
+ * @brief 이전 프로세스에 준비완료 통지
+ * @param 없음
+ * @return
+ *  성공 시 0,\n
+ *  업그레이드로 실행된 프로세스가 아니거나 실패 시 -1
+ */
+int
+upgrade_notify_ready(void)
+{
+    char c = 1;
+    int result;
+
+    if (ready_fd < 0) {
+	return -1;
+    }
+
+    result = (writen(ready_fd, &c, 1) == 1) ? 0 : -1;
+    close(ready_fd);
+    ready_fd = -1;
+
+    return result;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file onvupgrade.h
+ * @brief 무중단 바이너리 업그레이드(리슨 소켓 인계) 헤더
+ */
+
+/*
+ * 무중단 바이너리 업그레이드(리슨 소켓 인계) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_UPGRADE_H
+#define ONV_UPGRADE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define UPGRADE_ENV_FDS		"ONV_LISTEN_FDS"	/**< 상속된 리슨 소켓 목록 ("3,4") */
+#define UPGRADE_ENV_READY	"ONV_UPGRADE_READY_FD"	/**< 준비완료 통지 파이프 */
+#define UPGRADE_MAX_FDS		256	/**< 인계할 수 있는 최대 소켓 수 (PREFORK_MAX_WORKERS 이상) */
+#define UPGRADE_READY_TIMEOUT	30	/**< 새 프로세스 준비완료 대기시간(초) */
+
+/* 이전 프로세스 (fd 를 넘겨주는 쪽) */
+pid_t upgrade_exec(char *const argv[], const int *fds, int nfds, int *readyfd);
+int upgrade_wait_ready(int readyfd, int timeout);
+int upgrade_send_fds(const char *path, const int *fds, int nfds, int timeout);
+
+/* 새 프로세스 (fd 를 넘겨받는 쪽) */
+int upgrade_inherited_fd(int port);
+int upgrade_inherited_fds(int port, int *fds, int maxfds);
+int upgrade_recv_fds(const char *path, int *fds, int maxfds, int timeout);
+int upgrade_notify_ready(void);
+
+#endif
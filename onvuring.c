@@ -0,0 +1,1425 @@
+/**
+ * @file onvuring.c
+ * @brief 비동기 I/O 엔진 (io_uring, epoll fallback)
+ */
+
+/*
+ * 비동기 I/O 엔진 (io_uring, epoll fallback)
+ *
+ * readn()/writen() 계열은 요청마다 시스템콜을 한다. 이 엔진은 read, write,
+ * accept, recv 요청을 io_uring submission queue 에 모았다가 uring_wait() 에서
+ * io_uring_enter() 한번으로 제출과 완료 대기를 함께 하고, 완료된 요청의 콜백을
+ * 호출한다. liburing 없이 linux/io_uring.h 와 시스템콜만 사용한다.
+ *
+ *  - 등록 버퍼: uring_read_fixed()/uring_write_fixed() 는 미리 커널에 등록한
+ *    버퍼를 사용하여 요청마다 페이지를 고정하는 비용이 없다.
+ *  - multishot accept/recv: 한번 요청하면 연결/데이터가 올 때마다 완료가
+ *    계속 생긴다. recv 데이터는 커널에 제공한 버퍼 링(provided buffer ring)에
+ *    들어오며 콜백이 끝나면 버퍼를 돌려준다.
+ *
+ * io_uring 이 없거나 (커널 5.11 미만, seccomp 차단 등) force_epoll 이면 같은 API
+ * 를 epoll readiness 와 non-blocking 시스템콜로 처리한다. multishot 이나 버퍼
+ * 링을 지원하지 않는 커널에서는 single-shot 요청을 다시 거는 방식으로 흉내낸다.
+ *
+ * 콜백은 uring_wait() 안에서만 호출되며, 콜백에서 새 요청을 걸어도 된다.
+ * 엔진은 쓰레드간에 공유하지 않는다 (쓰레드마다 하나씩 생성).
+ * 요청이 걸린 fd 를 닫기 전에 uring_cancel() 로 취소하고 완료를 받아야 한다.
+ * epoll 방식에서는 fd 마다 읽기쪽(read, recv, accept)과 쓰기쪽(write) 요청을
+ * 하나씩만 걸 수 있다 (더 걸면 EBUSY).
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvuring.h"
+
+#define OP_READ		1
+#define OP_WRITE	2
+#define OP_READ_FIXED	3
+#define OP_WRITE_FIXED	4
+#define OP_ACCEPT	5
+#define OP_RECV		6
+#define OP_CANCEL	7
+
+#define URING_EPOLL_EVENTS	64	/**< epoll_wait() 한번에 처리할 이벤트 수 */
+#define URING_BURST		16	/**< epoll 방식 multishot 한번에 처리할 최대 수 */
+#define URING_BGID		0	/**< recv 버퍼 그룹 */
+
+/**
+ * 요청
+ */
+typedef struct uring_req_s
+{
+    int op;
+    int fd;
+    char *buf;
+    size_t len;
+    off_t off;			/**< -1 이면 현재 위치 */
+    int bufidx;			/**< 등록 버퍼 또는 (흉내낸 recv 의) recv 버퍼 번호 */
+    int multishot;
+    int res;			/**< epoll 방식 완료 결과 */
+    int done;			/**< epoll 방식 완료 목록에 있음 */
+    int cancelled;		/**< uring_cancel() 됨 (다시 걸지 않음) */
+    struct uring_req_s *target;	/**< OP_CANCEL 대상 요청 */
+    uring_cb cb;
+    void *arg;
+    struct uring_req_s *prev;
+    struct uring_req_s *next;
+} uring_req_t;
+
+/**
+ * epoll 방식 fd 상태
+ */
+typedef struct uring_fd_s
+{
+    uring_req_t *rd;		/**< 읽기쪽 요청 */
+    uring_req_t *wr;		/**< 쓰기쪽 요청 */
+    unsigned events;		/**< epoll 에 등록된 이벤트 */
+    int regular;		/**< epoll 불가 (일반 파일): 즉시 처리 */
+} uring_fd_t;
+
+/**
+ * I/O 엔진
+ */
+struct uring_s
+{
+    int backend;
+    unsigned entries;
+    size_t bufsize;
+    int nfixed;
+    char *fixed;		/**< 등록 버퍼 */
+    int nrecv;
+    char *recvbufs;		/**< recv 버퍼 */
+    int *freebid;		/**< 사용 가능한 recv 버퍼 번호 (버퍼 링이 없을 때) */
+    int nfree;
+    uring_req_t *live;		/**< 진행중인 요청 */
+    uring_req_t *freelist;	/**< 재사용할 요청 */
+    int pending;		/**< 사용자 요청 수 */
+    unsigned long syscalls;	/**< 시스템콜 수 */
+
+    /* io_uring */
+    int ringfd;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;		/**< 아직 제출하지 않은 SQE 수 */
+    struct io_uring_buf_ring *br;	/**< recv 버퍼 링 (NULL 이면 흉내냄) */
+    size_t br_size;
+    unsigned br_mask;
+    int no_multishot;		/**< multishot accept 미지원 커널 */
+
+    /* epoll */
+    int epfd;
+    uring_fd_t *fds;
+    int nfds;
+    uring_req_t *done;		/**< 즉시 완료된 요청 (콜백 대기) */
+    uring_req_t *done_tail;
+};
+
+static int sys_setup(unsigned entries, struct io_uring_params *p);
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz);
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned nr);
+static int ring_init(uring_t *ring);
+static void ring_exit(uring_t *ring);
+static void br_add(uring_t *ring, int bid);
+static struct io_uring_sqe *sqe_get(uring_t *ring);
+static int ring_flush(uring_t *ring);
+static int ring_push(uring_t *ring, uring_req_t *req);
+static int ring_reap(uring_t *ring);
+static uring_fd_t *fd_state(uring_t *ring, int fd);
+static int ep_update(uring_t *ring, int fd);
+static int ep_push(uring_t *ring, uring_req_t *req);
+static void ep_run(uring_t *ring, int fd, unsigned events);
+static int ep_wait(uring_t *ring, int msec);
+static uring_req_t *req_new(uring_t *ring, int op, int fd, uring_cb cb, void *arg);
+static void req_free(uring_t *ring, uring_req_t *req);
+static void done_push(uring_t *ring, uring_req_t *req, int res);
+static int submit(uring_t *ring, uring_req_t *req);
+
+
+/**
+ * @brief io_uring 시스템콜
+ */
+static int
+sys_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int
+sys_register(int fd, unsigned opcode, void *arg, unsigned nr)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr);
+}
+
+
+/**
+ * @brief 요청 할당 (live 리스트에 추가)
+ */
+static uring_req_t *
+req_new(uring_t *ring, int op, int fd, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if ((req = ring->freelist) != NULL) {
+	ring->freelist = req->next;
+    }
+    else if ((req = malloc(sizeof(uring_req_t))) == NULL) {
+	return NULL;
+    }
+    memset(req, 0, sizeof(uring_req_t));
+    req->op = op;
+    req->fd = fd;
+    req->off = -1;
+    req->bufidx = -1;
+    req->cb = cb;
+    req->arg = arg;
+
+    req->next = ring->live;
+    if (ring->live) {
+	ring->live->prev = req;
+    }
+    ring->live = req;
+    if (op != OP_CANCEL) {
+	ring->pending++;
+    }
+
+    return req;
+}
+
+
+/**
+ * @brief 요청 해제 (freelist 로)
+ */
+static void
+req_free(uring_t *ring, uring_req_t *req)
+{
+    if (req->prev) {
+	req->prev->next = req->next;
+    }
+    else {
+	ring->live = req->next;
+    }
+    if (req->next) {
+	req->next->prev = req->prev;
+    }
+    if (req->op != OP_CANCEL) {
+	ring->pending--;
+    }
+    req->prev = NULL;
+    req->next = ring->freelist;
+    ring->freelist = req;
+}
+
+
+/**
+ * @brief io_uring 생성, 링 매핑, 버퍼 등록
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1 (epoll 방식 사용)
+ */
+static int
+ring_init(uring_t *ring)
+{
+    struct io_uring_params p;
+    struct io_uring_buf_reg reg;
+    struct iovec *iov = NULL;
+    unsigned entries;
+    char *sq = NULL, *cq = NULL;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_COOP_TASKRUN;
+    if ((ring->ringfd = sys_setup(ring->entries, &p)) < 0 && errno == EINVAL) {
+	/* 5.19 이전 커널 */
+	memset(&p, 0, sizeof(p));
+	ring->ringfd = sys_setup(ring->entries, &p);
+    }
+    ring->syscalls++;
+    if (ring->ringfd < 0) {
+	Log(INFO, "uring: io_uring_setup() failed: %s, using epoll", strerror(errno));
+	return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP) ||
+	    !(p.features & IORING_FEAT_EXT_ARG)) {
+	Log(INFO, "uring: io_uring too old (features 0x%x), using epoll", p.features);
+	close(ring->ringfd);
+	ring->ringfd = -1;
+	return -1;
+    }
+
+    /* SINGLE_MMAP: SQ, CQ 링을 한번에 매핑 */
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) > ring->sq_size) {
+	ring->sq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    }
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, ring->ringfd, IORING_OFF_SQ_RING);
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, ring->ringfd, IORING_OFF_SQES);
+    if (ring->sq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+	Log(ERROR, "uring: mmap() failed: %s", strerror(errno));
+	if (ring->sq_ptr == MAP_FAILED) {
+	    ring->sq_ptr = NULL;
+	}
+	if (ring->sqes == MAP_FAILED) {
+	    ring->sqes = NULL;
+	}
+	ring_exit(ring);
+	return -1;
+    }
+    ring->cq_ptr = ring->sq_ptr;
+
+    sq = ring->sq_ptr;
+    cq = ring->cq_ptr;
+    ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    ring->entries = p.sq_entries;
+
+    /* 등록 버퍼 */
+    if (ring->nfixed > 0) {
+	if ((iov = calloc(ring->nfixed, sizeof(struct iovec))) == NULL) {
+	    ring_exit(ring);
+	    return -1;
+	}
+	for (i = 0; i < ring->nfixed; i++) {
+	    iov[i].iov_base = ring->fixed + i * ring->bufsize;
+	    iov[i].iov_len = ring->bufsize;
+	}
+	ring->syscalls++;
+	if (sys_register(ring->ringfd, IORING_REGISTER_BUFFERS, iov, ring->nfixed) < 0) {
+	    Log(ERROR, "uring: IORING_REGISTER_BUFFERS failed: %s", strerror(errno));
+	    free(iov);
+	    ring_exit(ring);
+	    return -1;
+	}
+	free(iov);
+    }
+
+    /* recv 버퍼 링 (5.19 이상, 없으면 single-shot recv 로 흉내냄) */
+    for (entries = 1; entries < (unsigned) ring->nrecv; entries <<= 1) {
+	;
+    }
+    ring->br_size = entries * sizeof(struct io_uring_buf);
+    ring->br = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->br == MAP_FAILED) {
+	ring->br = NULL;
+    }
+    else {
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) ring->br;
+	reg.ring_entries = entries;
+	reg.bgid = URING_BGID;
+	ring->syscalls++;
+	if (sys_register(ring->ringfd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+	    Log(INFO, "uring: provided buffer ring unavailable: %s", strerror(errno));
+	    munmap(ring->br, ring->br_size);
+	    ring->br = NULL;
+	}
+	else {
+	    ring->br_mask = entries - 1;
+	    ring->br->tail = 0;
+	    for (i = 0; i < ring->nrecv; i++) {
+		br_add(ring, i);
+	    }
+	}
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief io_uring 해제
+ */
+static void
+ring_exit(uring_t *ring)
+{
+    if (ring->br) {
+	munmap(ring->br, ring->br_size);
+	ring->br = NULL;
+    }
+    if (ring->sqes) {
+	munmap(ring->sqes, ring->sqes_size);
+	ring->sqes = NULL;
+    }
+    if (ring->sq_ptr) {
+	munmap(ring->sq_ptr, ring->sq_size);
+	ring->sq_ptr = NULL;
+    }
+    if (ring->ringfd >= 0) {
+	close(ring->ringfd);
+	ring->ringfd = -1;
+    }
+}
+
+
+/**
+ * @brief recv 버퍼를 커널 버퍼 링에 돌려줌
+ */
+static void
+br_add(uring_t *ring, int bid)
+{
+    struct io_uring_buf *buf = NULL;
+    unsigned short tail = ring->br->tail;
+
+    buf = &ring->br->bufs[tail & ring->br_mask];
+    buf->addr = (unsigned long) (ring->recvbufs + (size_t) bid * ring->bufsize);
+    buf->len = ring->bufsize;
+    buf->bid = bid;
+    __atomic_store_n(&ring->br->tail, (unsigned short) (tail + 1), __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief 빈 SQE (submission queue 가 가득 차면 먼저 제출)
+ */
+static struct io_uring_sqe *
+sqe_get(uring_t *ring)
+{
+    struct io_uring_sqe *sqe = NULL;
+    unsigned head, tail;
+
+    tail = *ring->sq_tail;
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->entries) {
+	if (ring_flush(ring) < 0) {
+	    return NULL;
+	}
+	head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (tail - head >= ring->entries) {
+	    errno = EBUSY;
+	    return NULL;
+	}
+    }
+
+    sqe = &ring->sqes[tail & *ring->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+
+    return sqe;
+}
+
+
+/**
+ * @brief 쌓인 SQE 제출 (대기 없음)
+ */
+static int
+ring_flush(uring_t *ring)
+{
+    int n;
+
+    while (ring->to_submit > 0) {
+	ring->syscalls++;
+	if ((n = sys_enter(ring->ringfd, ring->to_submit, 0, 0, NULL, 0)) < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    Log(ERROR, "uring: io_uring_enter() failed: %s", strerror(errno));
+	    return -1;
+	}
+	ring->to_submit -= n;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 요청을 SQE 로 만들어 submission queue 에 넣음 (제출은 나중에)
+ */
+static int
+ring_push(uring_t *ring, uring_req_t *req)
+{
+    struct io_uring_sqe *sqe = NULL;
+
+    if ((sqe = sqe_get(ring)) == NULL) {
+	return -1;
+    }
+
+    sqe->fd = req->fd;
+    sqe->user_data = (unsigned long) req;
+    sqe->off = (uint64_t) req->off;
+
+    switch (req->op) {
+	case OP_READ:
+	case OP_WRITE:
+	    sqe->opcode = req->op == OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+	    sqe->addr = (unsigned long) req->buf;
+	    sqe->len = req->len;
+	    break;
+	case OP_READ_FIXED:
+	case OP_WRITE_FIXED:
+	    sqe->opcode = req->op == OP_READ_FIXED ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+	    sqe->addr = (unsigned long) req->buf;
+	    sqe->len = req->len;
+	    sqe->buf_index = req->bufidx;
+	    break;
+	case OP_ACCEPT:
+	    sqe->opcode = IORING_OP_ACCEPT;
+	    sqe->off = 0;
+	    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	    if (req->multishot && !ring->no_multishot) {
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	    }
+	    break;
+	case OP_RECV:
+	    sqe->opcode = IORING_OP_RECV;
+	    sqe->off = 0;
+	    if (ring->br) {
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_BGID;
+	    }
+	    else {
+		/* 버퍼 링 없음: 버퍼 하나로 single-shot recv */
+		if (req->bufidx < 0) {
+		    req->bufidx = ring->freebid[--ring->nfree];
+		}
+		sqe->addr = (unsigned long) (ring->recvbufs + (size_t) req->bufidx * ring->bufsize);
+		sqe->len = ring->bufsize;
+	    }
+	    break;
+	case OP_CANCEL:
+	    /* user_data 로 취소 (IORING_ASYNC_CANCEL_FD 는 5.19 이상) */
+	    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	    sqe->fd = -1;
+	    sqe->off = 0;
+	    sqe->addr = (unsigned long) req->target;
+	    break;
+    }
+
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+
+    return 0;
+}
+
+
+/**
+ * @brief completion queue 의 완료를 모두 처리
+ * @return 처리한 완료 수
+ */
+static int
+ring_reap(uring_t *ring)
+{
+    struct io_uring_cqe *cqe = NULL;
+    uring_req_t *req = NULL;
+    unsigned head, tail, flags;
+    char *data = NULL;
+    int res, bid, more, rearm, count = 0;
+
+    head = *ring->cq_head;
+    for (;;) {
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	if (head == tail) {
+	    break;
+	}
+	cqe = &ring->cqes[head & *ring->cq_mask];
+	req = (uring_req_t *) (unsigned long) cqe->user_data;
+	res = cqe->res;
+	flags = cqe->flags;
+	head++;
+	/* 콜백에서 새 요청을 걸 수 있도록 먼저 CQE 를 돌려줌 */
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	more = (flags & IORING_CQE_F_MORE) != 0;
+	rearm = 0;
+
+	switch (req->op) {
+	    case OP_CANCEL:
+		req_free(ring, req);
+		continue;
+	    case OP_ACCEPT:
+		if (res == -EINVAL && req->multishot && !ring->no_multishot && !req->cancelled) {
+		    /* multishot accept 미지원: single-shot 으로 흉내냄 */
+		    ring->no_multishot = 1;
+		    if (ring_push(ring, req) == 0) {
+			continue;
+		    }
+		    res = -errno;
+		    Log(ERROR, "uring: accept on fd %d failed: %s", req->fd, strerror(-res));
+		}
+		req->cb(ring, res, NULL, req->arg);
+		rearm = req->multishot && !more && res >= 0;
+		break;
+	    case OP_RECV:
+		if (ring->br) {
+		    if (res == -ENOBUFS) {
+			rearm = !more;	/* 콜백이 버퍼를 돌려준 후 다시 */
+			break;
+		    }
+		    bid = (flags & IORING_CQE_F_BUFFER) ? (int) (flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+		    data = bid >= 0 ? ring->recvbufs + (size_t) bid * ring->bufsize : NULL;
+		    req->cb(ring, res, data, req->arg);
+		    if (bid >= 0) {
+			br_add(ring, bid);
+		    }
+		    rearm = !more && res > 0;
+		}
+		else {
+		    data = ring->recvbufs + (size_t) req->bufidx * ring->bufsize;
+		    req->cb(ring, res, data, req->arg);
+		    rearm = res > 0;
+		    if (!rearm) {
+			ring->freebid[ring->nfree++] = req->bufidx;
+		    }
+		}
+		break;
+	    default:
+		req->cb(ring, res, req->buf, req->arg);
+		break;
+	}
+	count++;
+
+	if (rearm && req->cancelled) {
+	    /* 콜백에서 uring_cancel(): 다시 걸지 않고 취소로 끝냄 */
+	    if (req->op == OP_RECV && !ring->br) {
+		ring->freebid[ring->nfree++] = req->bufidx;
+	    }
+	    req->cb(ring, -ECANCELED, NULL, req->arg);
+	    req_free(ring, req);
+	}
+	else if (rearm) {
+	    if (ring_push(ring, req) == 0) {
+		continue;
+	    }
+	    res = -errno;
+	    Log(ERROR, "uring: re-arm on fd %d failed: %s", req->fd, strerror(-res));
+	    if (req->op == OP_RECV && !ring->br) {
+		ring->freebid[ring->nfree++] = req->bufidx;
+	    }
+	    req->cb(ring, res, NULL, req->arg);
+	    req_free(ring, req);
+	}
+	else if (!more) {
+	    req_free(ring, req);
+	}
+    }
+
+    return count;
+}
+
+
+/**
+ * @brief epoll 방식 fd 상태 (배열 확장)
+ */
+static uring_fd_t *
+fd_state(uring_t *ring, int fd)
+{
+    uring_fd_t *fds = NULL;
+    int n;
+
+    if (fd < 0) {
+	errno = EBADF;
+	return NULL;
+    }
+    if (fd >= ring->nfds) {
+	n = ring->nfds ? ring->nfds : 64;
+	while (n <= fd) {
+	    n *= 2;
+	}
+	if ((fds = realloc(ring->fds, n * sizeof(uring_fd_t))) == NULL) {
+	    return NULL;
+	}
+	memset(fds + ring->nfds, 0, (n - ring->nfds) * sizeof(uring_fd_t));
+	ring->fds = fds;
+	ring->nfds = n;
+    }
+
+    return &ring->fds[fd];
+}
+
+
+/**
+ * @brief fd 의 걸린 요청에 맞게 epoll 등록 갱신
+ */
+static int
+ep_update(uring_t *ring, int fd)
+{
+    struct epoll_event ev;
+    uring_fd_t *st = &ring->fds[fd];
+    unsigned events = 0;
+    int op;
+
+    if (st->rd) {
+	events |= EPOLLIN;
+    }
+    if (st->wr) {
+	events |= EPOLLOUT;
+    }
+    if (events == st->events) {
+	return 0;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (events == 0) {
+	op = EPOLL_CTL_DEL;
+    }
+    else {
+	op = st->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    }
+    ring->syscalls++;
+    if (epoll_ctl(ring->epfd, op, fd, &ev) < 0) {
+	if (op == EPOLL_CTL_DEL) {
+	    /* 이미 닫힌 fd */
+	    st->events = 0;
+	    return 0;
+	}
+	return -1;
+    }
+    st->events = events;
+
+    return 0;
+}
+
+
+/**
+ * @brief 요청을 즉시 완료 목록에 넣음 (다음 uring_wait() 에서 콜백)
+ */
+static void
+done_push(uring_t *ring, uring_req_t *req, int res)
+{
+    req->res = res;
+    req->done = 1;
+    if (req->prev) {
+	req->prev->next = req->next;
+    }
+    else {
+	ring->live = req->next;
+    }
+    if (req->next) {
+	req->next->prev = req->prev;
+    }
+    req->prev = NULL;
+    req->next = NULL;
+    if (ring->done_tail) {
+	ring->done_tail->next = req;
+    }
+    else {
+	ring->done = req;
+    }
+    ring->done_tail = req;
+}
+
+
+/**
+ * @brief epoll 방식 요청 등록
+ */
+static int
+ep_push(uring_t *ring, uring_req_t *req)
+{
+    uring_fd_t *st = NULL;
+    ssize_t n;
+    int rd;
+
+    if (req->op == OP_CANCEL) {
+	if ((st = fd_state(ring, req->fd)) != NULL) {
+	    if (st->rd) {
+		done_push(ring, st->rd, -ECANCELED);
+		st->rd = NULL;
+	    }
+	    if (st->wr) {
+		done_push(ring, st->wr, -ECANCELED);
+		st->wr = NULL;
+	    }
+	    ep_update(ring, req->fd);
+	}
+	req_free(ring, req);
+	return 0;
+    }
+
+    if ((st = fd_state(ring, req->fd)) == NULL) {
+	return -1;
+    }
+    rd = req->op != OP_WRITE && req->op != OP_WRITE_FIXED;
+
+    if (st->regular) {
+	/* 일반 파일은 항상 준비됨: 바로 처리 */
+	if (rd) {
+	    n = req->off < 0 ? read(req->fd, req->buf, req->len) : pread(req->fd, req->buf, req->len, req->off);
+	}
+	else {
+	    n = req->off < 0 ? write(req->fd, req->buf, req->len) : pwrite(req->fd, req->buf, req->len, req->off);
+	}
+	ring->syscalls++;
+	done_push(ring, req, n < 0 ? -errno : (int) n);
+	return 0;
+    }
+
+    if ((rd && st->rd) || (!rd && st->wr)) {
+	errno = EBUSY;
+	return -1;
+    }
+    if (!rd && req->off < 0) {
+	/* 소켓 write 는 먼저 바로 시도하여 epoll 등록을 줄임 */
+	ring->syscalls++;
+	if ((n = send(req->fd, req->buf, req->len, MSG_DONTWAIT)) >= 0 ||
+		(errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOTSOCK)) {
+	    done_push(ring, req, n < 0 ? -errno : (int) n);
+	    return 0;
+	}
+    }
+    if (req->op == OP_ACCEPT) {
+	set_nonblock(req->fd);
+    }
+    if (rd) {
+	st->rd = req;
+    }
+    else {
+	st->wr = req;
+    }
+
+    if (ep_update(ring, req->fd) < 0) {
+	if (errno == EPERM && req->op != OP_ACCEPT && req->op != OP_RECV) {
+	    /* epoll 불가 (일반 파일) */
+	    st->rd = st->wr = NULL;
+	    st->regular = 1;
+	    return ep_push(ring, req);
+	}
+	if (rd) {
+	    st->rd = NULL;
+	}
+	else {
+	    st->wr = NULL;
+	}
+	return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief epoll 방식: 준비된 fd 의 요청을 처리하고 콜백 호출
+ */
+static void
+ep_run(uring_t *ring, int fd, unsigned events)
+{
+    uring_fd_t *st = &ring->fds[fd];
+    uring_req_t *req = NULL;
+    ssize_t n;
+    int i, bid = -1;
+
+    if ((req = st->rd) != NULL && (events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+	for (i = 0; i < URING_BURST && st->rd == req; i++) {
+	    ring->syscalls++;
+	    switch (req->op) {
+		case OP_ACCEPT:
+		    n = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		    break;
+		case OP_RECV:
+		    if (ring->nfree == 0) {
+			n = -2;
+			break;
+		    }
+		    bid = ring->freebid[ring->nfree - 1];
+		    n = recv(fd, ring->recvbufs + (size_t) bid * ring->bufsize, ring->bufsize, MSG_DONTWAIT);
+		    break;
+		default:
+		    n = req->off < 0 ? read(fd, req->buf, req->len) : pread(fd, req->buf, req->len, req->off);
+		    break;
+	    }
+	    if (n == -2 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))) {
+		break;
+	    }
+	    if (n < 0 && errno == EINTR) {
+		continue;
+	    }
+	    if (n < 0) {
+		n = -errno;
+	    }
+
+	    if (req->op == OP_ACCEPT) {
+		if (!req->multishot || n < 0) {
+		    st->rd = NULL;
+		}
+		req->cb(ring, (int) n, NULL, req->arg);
+	    }
+	    else if (req->op == OP_RECV) {
+		if (n <= 0) {
+		    st->rd = NULL;
+		}
+		ring->nfree--;
+		req->cb(ring, (int) n, ring->recvbufs + (size_t) bid * ring->bufsize, req->arg);
+		ring->freebid[ring->nfree++] = bid;
+	    }
+	    else {
+		st->rd = NULL;
+		req->cb(ring, (int) n, req->buf, req->arg);
+	    }
+	    /* 콜백에서 다른 fd 를 등록하면 fds 가 realloc 될 수 있음 */
+	    st = &ring->fds[fd];
+	    if (req->done) {
+		break;		/* 콜백에서 uring_cancel() */
+	    }
+	    if (st->rd != req) {
+		req_free(ring, req);
+		break;
+	    }
+	}
+    }
+
+    if ((req = st->wr) != NULL && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+	ring->syscalls++;
+	n = req->off < 0 ? write(fd, req->buf, req->len) : pwrite(fd, req->buf, req->len, req->off);
+	if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+	    st->wr = NULL;
+	    req->cb(ring, n < 0 ? -errno : (int) n, req->buf, req->arg);
+	    req_free(ring, req);
+	}
+    }
+
+    ep_update(ring, fd);
+}
+
+
+/**
+ * @brief epoll 방식 대기 및 완료 처리
+ */
+static int
+ep_wait(uring_t *ring, int msec)
+{
+    struct epoll_event events[URING_EPOLL_EVENTS];
+    uring_req_t *req = NULL;
+    int i, n, count = 0;
+
+    /* 즉시 완료된 요청 */
+    while ((req = ring->done) != NULL) {
+	ring->done = req->next;
+	if (!ring->done) {
+	    ring->done_tail = NULL;
+	}
+	req->cb(ring, req->res, req->op == OP_RECV || req->op == OP_ACCEPT ? NULL : req->buf, req->arg);
+	if (req->op != OP_CANCEL) {
+	    ring->pending--;
+	}
+	req->next = ring->freelist;
+	ring->freelist = req;
+	count++;
+    }
+    if (count > 0) {
+	msec = 0;
+    }
+
+    ring->syscalls++;
+    if ((n = epoll_wait(ring->epfd, events, URING_EPOLL_EVENTS, msec)) < 0) {
+	if (errno == EINTR) {
+	    return count;
+	}
+	Log(ERROR, "uring: epoll_wait() failed: %s", strerror(errno));
+	return -1;
+    }
+    for (i = 0; i < n; i++) {
+	ep_run(ring, events[i].data.fd, events[i].events);
+	count++;
+    }
+
+    return count;
+}
+
+
+/**
+ * @brief 요청 제출 (backend 별)
+ */
+static int
+submit(uring_t *ring, uring_req_t *req)
+{
+    int result;
+
+    if (ring->backend == URING_BACKEND_IOURING) {
+	if (req->op == OP_RECV && !ring->br && ring->nfree == 0) {
+	    errno = ENOBUFS;
+	    result = -1;
+	}
+	else {
+	    result = ring_push(ring, req);
+	}
+    }
+    else {
+	if (req->op == OP_CANCEL) {
+	    return ep_push(ring, req);
+	}
+	result = ep_push(ring, req);
+    }
+
+    if (result < 0) {
+	req_free(ring, req);
+    }
+
+    return result;
+}
+
+
+/**
+ * @brief I/O 엔진 생성
+ * @param conf - 설정 (NULL 이면 기본값)
+ * @return
+ *  성공 시 엔진,\n
+ *  실패 시 NULL
+ *
+ * io_uring 을 사용할 수 없으면 epoll 방식으로 생성한다 (uring_backend() 확인).
+ */
+uring_t *
+uring_create(const uring_conf_t *conf)
+{
+    uring_t *ring = NULL;
+    int i;
+
+    if ((ring = calloc(1, sizeof(uring_t))) == NULL) {
+	Log(ERROR, "uring: calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    ring->ringfd = -1;
+    ring->epfd = -1;
+    ring->entries = conf && conf->entries ? conf->entries : URING_ENTRIES;
+    ring->nfixed = conf ? conf->nfixed : 0;
+    ring->nrecv = conf && conf->nrecv > 0 ? conf->nrecv : URING_RECV_BUFS;
+    ring->bufsize = conf && conf->bufsize ? conf->bufsize : URING_BUF_SIZE;
+
+    if (ring->nfixed > 0) {
+	ring->fixed = mmap(NULL, ring->nfixed * ring->bufsize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring->fixed == MAP_FAILED) {
+	    ring->fixed = NULL;
+	    Log(ERROR, "uring: mmap() failed: %s", strerror(errno));
+	    uring_destroy(ring);
+	    return NULL;
+	}
+    }
+    ring->recvbufs = malloc(ring->nrecv * ring->bufsize);
+    ring->freebid = calloc(ring->nrecv, sizeof(int));
+    if (!ring->recvbufs || !ring->freebid) {
+	Log(ERROR, "uring: malloc() failed: %s", strerror(errno));
+	uring_destroy(ring);
+	return NULL;
+    }
+    for (i = 0; i < ring->nrecv; i++) {
+	ring->freebid[i] = ring->nrecv - 1 - i;
+    }
+    ring->nfree = ring->nrecv;
+
+    if ((!conf || !conf->force_epoll) && ring_init(ring) == 0) {
+	ring->backend = URING_BACKEND_IOURING;
+	return ring;
+    }
+
+    if ((ring->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+	Log(ERROR, "uring: epoll_create1() failed: %s", strerror(errno));
+	uring_destroy(ring);
+	return NULL;
+    }
+    ring->backend = URING_BACKEND_EPOLL;
+
+    return ring;
+}
+
+
+/**
+ * @brief I/O 엔진 해제
+ * @param ring - 엔진
+ * @return 없음
+ *
+ * 진행중인 요청은 콜백 없이 버려진다 (먼저 uring_cancel() 후 완료를 기다릴 것).
+ */
+void
+uring_destroy(uring_t *ring)
+{
+    uring_req_t *req = NULL;
+
+    if (!ring) {
+	return;
+    }
+    ring_exit(ring);
+    if (ring->epfd >= 0) {
+	close(ring->epfd);
+    }
+
+    while ((req = ring->live) != NULL) {
+	ring->live = req->next;
+	free(req);
+    }
+    while ((req = ring->done) != NULL) {
+	ring->done = req->next;
+	free(req);
+    }
+    while ((req = ring->freelist) != NULL) {
+	ring->freelist = req->next;
+	free(req);
+    }
+    if (ring->fixed) {
+	munmap(ring->fixed, ring->nfixed * ring->bufsize);
+    }
+    free(ring->recvbufs);
+    free(ring->freebid);
+    free(ring->fds);
+    free(ring);
+}
+
+
+/**
+ * @brief 사용중인 backend (URING_BACKEND_IOURING, URING_BACKEND_EPOLL)
+ */
+int
+uring_backend(const uring_t *ring)
+{
+    return ring->backend;
+}
+
+
+/**
+ * @brief 등록 버퍼 \a idx 의 주소 (크기는 conf.bufsize)
+ */
+char *
+uring_buffer(uring_t *ring, int idx)
+{
+    if (idx < 0 || idx >= ring->nfixed) {
+	return NULL;
+    }
+    return ring->fixed + (size_t) idx * ring->bufsize;
+}
+
+
+/**
+ * @brief 완료되지 않은 요청 수
+ */
+int
+uring_pending(const uring_t *ring)
+{
+    return ring->pending;
+}
+
+
+/**
+ * @brief 엔진이 사용한 시스템콜 수 (성능 비교용)
+ */
+unsigned long
+uring_syscalls(const uring_t *ring)
+{
+    return ring->syscalls;
+}
+
+
+/**
+ * @brief read 요청
+ * @param ring - 엔진
+ * @param fd - descriptor
+ * @param buf - 버퍼 (완료까지 유효해야 함)
+ * @param len - 최대 길이
+ * @param off - 파일 위치 (-1 이면 현재 위치, 소켓은 -1)
+ * @param cb - 완료 콜백 (res = 읽은 바이트수, 0 은 EOF)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+uring_read(uring_t *ring, int fd, char *buf, size_t len, off_t off, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if ((req = req_new(ring, OP_READ, fd, cb, arg)) == NULL) {
+	return -1;
+    }
+    req->buf = buf;
+    req->len = len;
+    req->off = off;
+
+    return submit(ring, req);
+}
+
+
+/**
+ * @brief write 요청 (한번의 write, 일부만 쓰일 수 있음)
+ * @param ring - 엔진
+ * @param fd - descriptor
+ * @param buf - 데이터 (완료까지 유효해야 함)
+ * @param len - 길이
+ * @param off - 파일 위치 (-1 이면 현재 위치, 소켓은 -1)
+ * @param cb - 완료 콜백 (res = 쓴 바이트수)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+uring_write(uring_t *ring, int fd, const char *buf, size_t len, off_t off, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if ((req = req_new(ring, OP_WRITE, fd, cb, arg)) == NULL) {
+	return -1;
+    }
+    req->buf = (char *) buf;
+    req->len = len;
+    req->off = off;
+
+    return submit(ring, req);
+}
+
+
+/**
+ * @brief 등록 버퍼 \a idx 로 read 요청
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 콜백의 data 는 uring_buffer(ring, idx) 이다.
+ */
+int
+uring_read_fixed(uring_t *ring, int fd, int idx, size_t len, off_t off, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if (idx < 0 || idx >= ring->nfixed || len > ring->bufsize) {
+	errno = EINVAL;
+	return -1;
+    }
+    if ((req = req_new(ring, OP_READ_FIXED, fd, cb, arg)) == NULL) {
+	return -1;
+    }
+    req->buf = uring_buffer(ring, idx);
+    req->len = len;
+    req->off = off;
+    req->bufidx = idx;
+
+    return submit(ring, req);
+}
+
+
+/**
+ * @brief 등록 버퍼 \a idx 의 데이터로 write 요청
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+uring_write_fixed(uring_t *ring, int fd, int idx, size_t len, off_t off, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if (idx < 0 || idx >= ring->nfixed || len > ring->bufsize) {
+	errno = EINVAL;
+	return -1;
+    }
+    if ((req = req_new(ring, OP_WRITE_FIXED, fd, cb, arg)) == NULL) {
+	return -1;
+    }
+    req->buf = uring_buffer(ring, idx);
+    req->len = len;
+    req->off = off;
+    req->bufidx = idx;
+
+    return submit(ring, req);
+}
+
+
+/**
+ * @brief accept 요청
+ * @param ring - 엔진
+ * @param listenfd - 리슨 소켓
+ * @param multishot - 0 이 아니면 uring_cancel() 까지 연결마다 콜백
+ * @param cb - 완료 콜백 (res = 새 연결 fd (non-blocking, close-on-exec))
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+uring_accept(uring_t *ring, int listenfd, int multishot, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if ((req = req_new(ring, OP_ACCEPT, listenfd, cb, arg)) == NULL) {
+	return -1;
+    }
+    req->multishot = multishot;
+
+    return submit(ring, req);
+}
+
+
+/**
+ * @brief multishot recv 요청
+ * @param ring - 엔진
+ * @param fd - 소켓
+ * @param cb - 완료 콜백 (res = 받은 바이트수, data = 라이브러리 버퍼)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ *
+ * 데이터가 올 때마다 콜백하며, EOF(res 0), 에러, uring_cancel() 이면 끝난다.
+ * data 는 콜백이 반환하면 재사용되므로 필요하면 복사해야 한다.
+ */
+int
+uring_recv(uring_t *ring, int fd, uring_cb cb, void *arg)
+{
+    uring_req_t *req = NULL;
+
+    if ((req = req_new(ring, OP_RECV, fd, cb, arg)) == NULL) {
+	return -1;
+    }
+    req->multishot = 1;
+
+    return submit(ring, req);
+}
+
+
+/**
+ * @brief \a fd 의 모든 요청 취소 (콜백은 res = -ECANCELED)
+ * @param ring - 엔진
+ * @param fd - descriptor
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+uring_cancel(uring_t *ring, int fd)
+{
+    uring_req_t *req = NULL, *c = NULL;
+
+    if (ring->backend != URING_BACKEND_IOURING) {
+	if ((req = req_new(ring, OP_CANCEL, fd, NULL, NULL)) == NULL) {
+	    return -1;
+	}
+	return submit(ring, req);
+    }
+
+    /*
+     * 요청마다 user_data 로 취소 (5.11 에서도 동작).
+     * 콜백 안에서 불리면 완료된 요청은 다시 걸지 않도록 표시해둔다.
+     */
+    for (req = ring->live; req != NULL; req = req->next) {
+	if (req->fd != fd || req->op == OP_CANCEL || req->cancelled) {
+	    continue;
+	}
+	req->cancelled = 1;
+	if ((c = req_new(ring, OP_CANCEL, fd, NULL, NULL)) == NULL) {
+	    return -1;
+	}
+	c->target = req;
+	if (submit(ring, c) < 0) {
+	    return -1;
+	}
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 쌓인 요청을 대기없이 제출
+ * @param ring - 엔진
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+uring_submit(uring_t *ring)
+{
+    if (ring->backend == URING_BACKEND_IOURING) {
+	return ring_flush(ring);
+    }
+    return 0;
+}
+
+
+/**
+ * @brief 쌓인 요청을 제출하고 완료를 기다려 콜백 호출
+ * @param ring - 엔진
+ * @param msec - 최대 대기시간 (0 이면 대기없음, 음수이면 무제한)
+ * @return
+ *  성공 시 처리한 완료 수 (timeout 이면 0),\n
+ *  실패 시 -1
+ *
+ * io_uring 은 제출과 대기를 io_uring_enter() 한번으로 한다.
+ */
+int
+uring_wait(uring_t *ring, int msec)
+{
+    struct io_uring_getevents_arg ext;
+    struct __kernel_timespec ts;
+    unsigned wait;
+    int n;
+
+    if (ring->backend != URING_BACKEND_IOURING) {
+	return ep_wait(ring, msec);
+    }
+
+    /* 이미 완료가 있으면 기다리지 않음 */
+    wait = msec != 0 && *ring->cq_head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (ring->to_submit > 0 || wait) {
+	memset(&ext, 0, sizeof(ext));
+	if (msec > 0) {
+	    ts.tv_sec = msec / 1000;
+	    ts.tv_nsec = (msec % 1000) * 1000000L;
+	    ext.ts = (unsigned long) &ts;
+	}
+	ring->syscalls++;
+	n = sys_enter(ring->ringfd, ring->to_submit, wait ? 1 : 0,
+		(wait ? IORING_ENTER_GETEVENTS : 0) | IORING_ENTER_EXT_ARG, &ext, sizeof(ext));
+	if (n < 0) {
+	    if (errno != ETIME && errno != EINTR && errno != EBUSY) {
+		Log(ERROR, "uring: io_uring_enter() failed: %s", strerror(errno));
+		return -1;
+	    }
+	}
+	else {
+	    ring->to_submit -= n;
+	}
+    }
+
+    return ring_reap(ring);
+}
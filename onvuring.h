@@ -0,0 +1,70 @@
+/**
+ * @file onvuring.h
+ * @brief 비동기 I/O 엔진 (io_uring, epoll fallback) 헤더
+ */
+
+/*
+ * 비동기 I/O 엔진 (io_uring, epoll fallback) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_URING_H
+#define ONV_URING_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define URING_ENTRIES		256	/**< 기본 submission queue 크기 */
+#define URING_RECV_BUFS		64	/**< 기본 recv 버퍼 수 */
+#define URING_BUF_SIZE		16384	/**< 기본 버퍼 크기 */
+
+#define URING_BACKEND_IOURING	1	/**< io_uring 사용 */
+#define URING_BACKEND_EPOLL	2	/**< epoll readiness + 시스템콜 */
+
+typedef struct uring_s uring_t;
+
+/**
+ * 완료 콜백
+ * res 는 시스템콜 결과 (바이트수, accept 한 fd) 또는 -errno 이다.
+ * data 는 read/write 는 요청한 버퍼, recv 는 라이브러리 버퍼 (콜백 안에서만 유효)이다.
+ */
+typedef void (*uring_cb)(uring_t *ring, int res, char *data, void *arg);
+
+/**
+ * 엔진 설정 (0 이면 기본값)
+ */
+typedef struct uring_conf_s
+{
+    unsigned entries;		/**< submission queue 크기 */
+    int nfixed;			/**< 등록 버퍼(read_fixed/write_fixed) 수 */
+    int nrecv;			/**< recv 버퍼 수 */
+    size_t bufsize;		/**< 버퍼 크기 */
+    int force_epoll;		/**< 0 이 아니면 io_uring 을 쓰지 않음 */
+} uring_conf_t;
+
+uring_t *uring_create(const uring_conf_t *conf);
+void uring_destroy(uring_t *ring);
+int uring_backend(const uring_t *ring);
+char *uring_buffer(uring_t *ring, int idx);
+int uring_pending(const uring_t *ring);
+unsigned long uring_syscalls(const uring_t *ring);
+
+int uring_read(uring_t *ring, int fd, char *buf, size_t len, off_t off, uring_cb cb, void *arg);
+int uring_write(uring_t *ring, int fd, const char *buf, size_t len, off_t off, uring_cb cb, void *arg);
+int uring_read_fixed(uring_t *ring, int fd, int idx, size_t len, off_t off, uring_cb cb, void *arg);
+int uring_write_fixed(uring_t *ring, int fd, int idx, size_t len, off_t off, uring_cb cb, void *arg);
+int uring_accept(uring_t *ring, int listenfd, int multishot, uring_cb cb, void *arg);
+int uring_recv(uring_t *ring, int fd, uring_cb cb, void *arg);
+int uring_cancel(uring_t *ring, int fd);
+
+int uring_submit(uring_t *ring);
+int uring_wait(uring_t *ring, int msec);
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file onvwait.c
+ * @brief fd 대기 (poll, monotonic deadline)
+ */
+
+/*
+ * fd 대기 (poll, monotonic deadline)
+ *
+ * select() 는 FD_SETSIZE(1024) 이상의 fd 에서 메모리를 깨뜨리므로 poll() 을
+ * 사용한다. 대기시간은 CLOCK_MONOTONIC 기준 절대시각(deadline, msec)으로
+ * 받아서, 여러번 나누어 읽고 쓰는 작업 전체에 하나의 제한시간을 적용할 수
+ * 있게 한다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include "log.h"
+#include "onvwait.h"
+
+
+/**
+ * @brief 현재 monotonic 시각
+ * @param 없음
+ * @return msec 단위 monotonic 시각
+ */
+long
+wait_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+
+/**
+ * @brief 현재부터 \a msec 후의 deadline
+ * @param msec - 제한시간 (음수이면 무제한)
+ * @return deadline (무제한이면 WAIT_FOREVER)
+ */
+long
+wait_deadline(int msec)
+{
+    if (msec < 0) {
+	return WAIT_FOREVER;
+    }
+    return wait_now() + msec;
+}
+
+
+/**
+ * @brief deadline 까지 남은 시간
+ * @param deadline - wait_deadline() 으로 구한 시각
+ * @return
+ *  남은 시간(msec, 지났으면 0),\n
+ *  무제한이면 -1
+ */
+int
+wait_remaining(long deadline)
+{
+    long left;
+
+    if (deadline < 0) {
+	return -1;
+    }
+    left = deadline - wait_now();
+    if (left <= 0) {
+	return 0;
+    }
+    return left > 0x7fffffffL ? 0x7fffffff : (int) left;
+}
+
+
+/**
+ * @brief fd 가 읽기/쓰기 가능해질 때까지 대기
+ * @param fd - 파일 디스크립터 (번호 제한 없음)
+ * @param events - WAIT_READ, WAIT_WRITE 조합
+ * @param deadline - wait_deadline() 으로 구한 시각
+ * @return
+ *  성공 시 준비된 이벤트 (WAIT_READ, WAIT_WRITE, WAIT_ERROR 조합),\n
+ *  timeout 시 0 (errno = ETIMEDOUT),\n
+ *  실패 시 -1
+ *
+ * EINTR 은 남은 시간으로 다시 대기한다.
+ */
+int
+wait_fd(int fd, int events, long deadline)
+{
+    struct pollfd pfd;
+    int result, ready = 0;
+
+    pfd.fd = fd;
+    pfd.events = 0;
+    if (events & WAIT_READ) {
+	pfd.events |= POLLIN;
+    }
+    if (events & WAIT_WRITE) {
+	pfd.events |= POLLOUT;
+    }
+
+    for (;;) {
+	pfd.revents = 0;
+	result = poll(&pfd, 1, wait_remaining(deadline));
+	if (result > 0) {
+	    break;
+	}
+	if (result == 0) {
+	    errno = ETIMEDOUT;
+	    return 0;
+	}
+	if (errno != EINTR) {
+	    Log(ERROR, "poll() function failed: %s", strerror(errno));
+	    return -1;
+	}
+    }
+
+    if (pfd.revents & POLLNVAL) {
+	errno = EBADF;
+	return -1;
+    }
+    if (pfd.revents & (POLLIN | POLLHUP)) {
+	ready |= WAIT_READ;
+    }
+    if (pfd.revents & POLLOUT) {
+	ready |= WAIT_WRITE;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP)) {
+	ready |= WAIT_ERROR;
+    }
+
+    return ready;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file onvwait.h
+ * @brief fd 대기 (poll, monotonic deadline) 헤더
+ */
+
+/*
+ * fd 대기 (poll, monotonic deadline) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_WAIT_H
+#define ONV_WAIT_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define WAIT_READ	0x01	/**< 읽기 가능 대기 */
+#define WAIT_WRITE	0x02	/**< 쓰기 가능 대기 */
+#define WAIT_ERROR	0x04	/**< 에러 또는 상대방 연결 종료 (결과에만 설정) */
+
+#define WAIT_FOREVER	(-1L)	/**< 무제한 deadline */
+
+long wait_now(void);
+long wait_deadline(int msec);
+int wait_remaining(long deadline);
+int wait_fd(int fd, int events, long deadline);
+
+#endif
@@ -0,0 +1,723 @@
+/**
+ * @file onvwqueue.c
+ * @brief 연결별 비동기 쓰기 큐 (참조계수 버퍼, watermark)
+ */
+
+/*
+ * 연결별 비동기 쓰기 큐 (참조계수 버퍼, watermark)
+ *
+ * writen()/onvWrite() 는 모든 바이트를 쓸 때까지 block 되므로 느린 클라이언트
+ * 하나가 같은 쓰레드의 다른 연결을 멈추게 한다. 쓰기 큐는 non-blocking
+ * 소켓에 바로 쓸 수 있는 만큼 쓰고, 나머지는 큐에 넣었다가 소켓이 쓰기
+ * 가능해지면 writev 로 내보낸다.
+ *
+ *  - 작은 쓰기는 WQUEUE_CHUNK 버퍼에 모아 복사하고, wbuf_t 로 넣은 데이터는
+ *    참조만 늘려서 (여러 연결에 같은 응답을 보낼 때) 복사하지 않는다.
+ *  - 대기 바이트가 high watermark 이상이 되면 WQUEUE_EV_HIGH, 그 뒤 low
+ *    watermark 이하로 내려가면 WQUEUE_EV_LOW 콜백을 호출한다. 생산자는 이
+ *    때 읽기/생산을 멈추고 다시 시작한다.
+ *  - 대기 바이트가 max 를 넘게 되는 쓰기는 ENOBUFS 로 실패한다. 단, 큐가
+ *    비어 있으면 max 보다 큰 쓰기도 받아들인다 (아니면 영원히 보낼 수 없음).
+ *
+ * 한 핸들러에서 작은 쓰기를 여러번 하는 경우 wqueue_cork() 와
+ * wqueue_uncork() 사이의 쓰기는 보내지 않고 모았다가 uncork 시점에 한번의
+ * sendmsg 로 보낸다 (IOV_BATCH 를 넘으면 마지막 외에는 MSG_MORE).
+ * wqueue_cork_tick() 은 현재 이벤트 루프 반복이 끝날 때 (epoll_wait() 전)
+ * uncork 하므로 한 반복 동안의 쓰기를 지연 없이 묶는다.
+ *
+ * onvevent 와 사용할 때는 쓰기 콜백에서 wqueue_flush() 를 호출한다.
+ *
+ *     static void conn_write(event_loop_t *loop, int fd, int events, void *arg)
+ *     {
+ *         conn_t *c = arg;
+ *         wqueue_flush(c->wq);
+ *     }
+ *     event_add(loop, fd, conn_read, conn_write, c);
+ *
+ * 콜백 안에서 wqueue_destroy() 를 호출해도 된다. 한 큐는 한 쓰레드에서만
+ * 사용해야 하며, wbuf_t 의 참조계수는 쓰레드 간에 공유해도 된다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvwqueue.h"
+
+/**
+ * 큐 원소 (버퍼의 일부분)
+ */
+typedef struct wqueue_ent_s
+{
+    wbuf_t *buf;		/**< 버퍼 (참조 1 개 보유) */
+    size_t off;			/**< 보낼 데이터 시작 위치 */
+    size_t len;			/**< 보낼 데이터 길이 */
+    struct wqueue_ent_s *next;
+} wqueue_ent_t;
+
+struct wqueue_s
+{
+    int fd;			/**< 소켓 */
+    int error;			/**< 쓰기 실패 errno (0 이면 정상) */
+    int notsock;		/**< 소켓이 아니면 1 (writev 사용) */
+    int above;			/**< high watermark 를 넘은 상태이면 1 */
+    int corked;			/**< wqueue_cork() 중첩 횟수 (0 이 아니면 모으기만 함) */
+    event_tick_t tick;		/**< wqueue_cork_tick() 의 uncork 예약 */
+    event_loop_t *loop;		/**< \a tick 을 예약한 루프 */
+    size_t pending;		/**< 대기 바이트 */
+    size_t low;			/**< low watermark */
+    size_t high;		/**< high watermark */
+    size_t max;			/**< 최대 대기 바이트 */
+    wqueue_cb cb;		/**< watermark/에러 콜백 */
+    void *arg;			/**< 콜백 인자 */
+    wqueue_ent_t *head;		/**< 대기 원소 리스트 */
+    wqueue_ent_t *tail;
+    wqueue_ent_t *free_ents;	/**< 재사용할 원소 */
+};
+
+static ssize_t queue_send(wqueue_t *q, struct iovec *vec, int n, int flags);
+static int queue_append(wqueue_t *q, wbuf_t *b, size_t off, size_t len);
+static int queue_copy(wqueue_t *q, const char *data, size_t len);
+static void queue_consume(wqueue_t *q, size_t done);
+static void queue_clear(wqueue_t *q);
+static int queue_check_high(wqueue_t *q);
+static void tick_uncork(event_loop_t *loop, void *arg);
+
+
+/**
+ * @brief 참조계수 버퍼 생성 (참조계수 1, 길이 0)
+ * @param size - 할당 크기
+ * @return
+ *  성공 시 버퍼 (사용 후 wbuf_unref()),\n
+ *  실패 시 NULL
+ */
+wbuf_t *
+wbuf_create(size_t size)
+{
+    wbuf_t *b = NULL;
+
+    if ((b = malloc(sizeof(wbuf_t) + size)) == NULL) {
+	Log(ERROR, "malloc(%lu) failed: %s", (unsigned long) size, strerror(errno));
+	return NULL;
+    }
+    b->data = (char *) (b + 1);
+    b->len = 0;
+    b->size = size;
+    b->refcnt = 1;
+    b->free_cb = NULL;
+    b->free_arg = NULL;
+
+    return b;
+}
+
+
+/**
+ * @brief 데이터를 복사한 참조계수 버퍼 생성
+ * @param data - 데이터
+ * @param len - 데이터 길이
+ * @return
+ *  성공 시 버퍼 (사용 후 wbuf_unref()),\n
+ *  실패 시 NULL
+ */
+wbuf_t *
+wbuf_from(const void *data, size_t len)
+{
+    wbuf_t *b = NULL;
+
+    if ((b = wbuf_create(len)) == NULL) {
+	return NULL;
+    }
+    memcpy(b->data, data, len);
+    b->len = len;
+
+    return b;
+}
+
+
+/**
+ * @brief 외부 메모리를 복사 없이 참조계수 버퍼로 감쌈
+ * @param data - 데이터 (마지막 참조가 해제될 때까지 유지되어야 함)
+ * @param len - 데이터 길이
+ * @param free_cb - 마지막 참조 해제 시 호출 (NULL 가능)
+ * @param arg - \a free_cb 인자
+ * @return
+ *  성공 시 버퍼 (사용 후 wbuf_unref()),\n
+ *  실패 시 NULL
+ */
+wbuf_t *
+wbuf_wrap(void *data, size_t len, wbuf_free_cb free_cb, void *arg)
+{
+    wbuf_t *b = NULL;
+
+    if ((b = wbuf_create(0)) == NULL) {
+	return NULL;
+    }
+    b->data = data;
+    b->len = len;
+    b->size = len;
+    b->free_cb = free_cb;
+    b->free_arg = arg;
+
+    return b;
+}
+
+
+/**
+ * @brief 참조 추가
+ * @param b - 버퍼
+ * @return \a b
+ */
+wbuf_t *
+wbuf_ref(wbuf_t *b)
+{
+    __atomic_add_fetch(&b->refcnt, 1, __ATOMIC_RELAXED);
+    return b;
+}
+
+
+/**
+ * @brief 참조 해제 (마지막 참조이면 버퍼 해제)
+ * @param b - 버퍼 (NULL 가능)
+ * @return 없음
+ */
+void
+wbuf_unref(wbuf_t *b)
+{
+    if (b == NULL || __atomic_sub_fetch(&b->refcnt, 1, __ATOMIC_ACQ_REL) > 0) {
+	return;
+    }
+    if (b->free_cb) {
+	b->free_cb(b->data, b->free_arg);
+    }
+    free(b);
+}
+
+
+/**
+ * @brief 쓰기 큐 생성
+ * @param fd - non-blocking 소켓 (close 는 호출자가 한다)
+ * @param low - low watermark (0 이면 WQUEUE_LOW)
+ * @param high - high watermark (0 이면 WQUEUE_HIGH)
+ * @param max - 최대 대기 바이트 (0 이면 WQUEUE_MAX)
+ * @param cb - watermark/에러 콜백 (NULL 가능)
+ * @param arg - 콜백 인자
+ * @return
+ *  성공 시 쓰기 큐 (사용 후 wqueue_destroy()),\n
+ *  실패 시 NULL
+ */
+wqueue_t *
+wqueue_create(int fd, size_t low, size_t high, size_t max, wqueue_cb cb, void *arg)
+{
+    wqueue_t *q = NULL;
+
+    if ((q = calloc(1, sizeof(wqueue_t))) == NULL) {
+	Log(ERROR, "calloc() failed: %s", strerror(errno));
+	return NULL;
+    }
+    q->fd = fd;
+    q->low = low ? low : WQUEUE_LOW;
+    q->high = high ? high : WQUEUE_HIGH;
+    q->max = max ? max : WQUEUE_MAX;
+    if (q->low > q->high) {
+	q->low = q->high;
+    }
+    q->cb = cb;
+    q->arg = arg;
+
+    return q;
+}
+
+
+/**
+ * @brief 쓰기 큐 해제 (보내지 않은 데이터는 버림)
+ * @param q - 쓰기 큐
+ * @return 없음
+ */
+void
+wqueue_destroy(wqueue_t *q)
+{
+    wqueue_ent_t *e = NULL;
+
+    if (q == NULL) {
+	return;
+    }
+
+    queue_clear(q);
+    if (q->tick.queued) {
+	event_tick_cancel(q->loop, &q->tick);
+    }
+    while ((e = q->free_ents) != NULL) {
+	q->free_ents = e->next;
+	free(e);
+    }
+    free(q);
+}
+
+
+/**
+ * @brief 소켓
+ * @param q - 쓰기 큐
+ * @return 소켓
+ */
+int
+wqueue_fd(const wqueue_t *q)
+{
+    return q->fd;
+}
+
+
+/**
+ * @brief 보내지 못하고 대기중인 바이트 수
+ * @param q - 쓰기 큐
+ * @return 대기 바이트 수
+ */
+size_t
+wqueue_pending(const wqueue_t *q)
+{
+    return q->pending;
+}
+
+
+/**
+ * @brief 쓰기 실패 원인
+ * @param q - 쓰기 큐
+ * @return 실패했으면 errno, 아니면 0
+ */
+int
+wqueue_error(const wqueue_t *q)
+{
+    return q->error;
+}
+
+
+/**
+ * @brief 데이터 쓰기 (바로 못 쓴 부분은 복사해서 큐에 넣음, block 되지 않음)
+ * @param q - 쓰기 큐
+ * @param data - 데이터
+ * @param len - 데이터 길이
+ * @return
+ *  성공 시 0 (보냈거나 큐에 넣음),\n
+ *  실패 시 -1 (ENOBUFS: 대기중인 데이터가 있는데 최대 대기 바이트 초과,
+ *  그 외: 이전 쓰기 실패)
+ */
+int
+wqueue_write(wqueue_t *q, const void *data, size_t len)
+{
+    struct iovec vec;
+    ssize_t nwrite = 0;
+
+    ASSERT(q != NULL && (data != NULL || len == 0));
+
+    if (q->error) {
+	errno = q->error;
+	return -1;
+    }
+    /* 큐가 비어 있으면 max 보다 큰 쓰기 하나는 받아들임 */
+    if (q->pending > 0 && q->pending + len > q->max) {
+	errno = ENOBUFS;
+	return -1;
+    }
+    if (len == 0) {
+	return 0;
+    }
+
+    /* 큐가 비어 있으면 바로 쓰기 */
+    if (q->head == NULL && !q->corked) {
+	vec.iov_base = (void *) data;
+	vec.iov_len = len;
+	if ((nwrite = queue_send(q, &vec, 1, 0)) < 0) {
+	    return -1;
+	}
+    }
+
+    if ((size_t) nwrite < len) {
+	if (queue_copy(q, (const char *) data + nwrite, len - nwrite) < 0) {
+	    return -1;
+	}
+	return queue_check_high(q);
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 참조계수 버퍼의 일부를 복사 없이 쓰기
+ * @param q - 쓰기 큐
+ * @param b - 버퍼 (큐에 넣으면 참조를 하나 추가, 호출자의 참조는 그대로)
+ * @param off - 보낼 데이터 시작 위치
+ * @param len - 보낼 데이터 길이
+ * @return
+ *  성공 시 0 (보냈거나 큐에 넣음),\n
+ *  실패 시 -1 (ENOBUFS: 대기중인 데이터가 있는데 최대 대기 바이트 초과,
+ *  그 외: 이전 쓰기 실패)
+ */
+int
+wqueue_write_buf(wqueue_t *q, wbuf_t *b, size_t off, size_t len)
+{
+    struct iovec vec;
+    ssize_t nwrite = 0;
+
+    ASSERT(q != NULL && b != NULL && off + len <= b->len);
+
+    if (q->error) {
+	errno = q->error;
+	return -1;
+    }
+    /* 큐가 비어 있으면 max 보다 큰 쓰기 하나는 받아들임 */
+    if (q->pending > 0 && q->pending + len > q->max) {
+	errno = ENOBUFS;
+	return -1;
+    }
+    if (len == 0) {
+	return 0;
+    }
+
+    if (q->head == NULL && !q->corked) {
+	vec.iov_base = b->data + off;
+	vec.iov_len = len;
+	if ((nwrite = queue_send(q, &vec, 1, 0)) < 0) {
+	    return -1;
+	}
+    }
+
+    if ((size_t) nwrite < len) {
+	if (queue_append(q, wbuf_ref(b), off + nwrite, len - nwrite) < 0) {
+	    wbuf_unref(b);
+	    return -1;
+	}
+	return queue_check_high(q);
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 대기중인 데이터를 소켓에 쓸 수 있는 만큼 씀 (쓰기 가능 이벤트에서 호출)
+ * @param q - 쓰기 큐
+ * @return
+ *  성공 시 남은 대기 바이트 수,\n
+ *  실패 시 -1 (WQUEUE_EV_ERROR 콜백 호출 후)
+ *
+ * cork 중이면 아무것도 보내지 않는다 (uncork 시점에 보냄).
+ *
+ * 콜백에서 \a q 를 해제할 수 있으므로 콜백을 호출한 뒤에는 \a q 를 건드리지
+ * 않고 반환한다.
+ */
+ssize_t
+wqueue_flush(wqueue_t *q)
+{
+    struct iovec vec[IOV_BATCH];
+    wqueue_ent_t *e = NULL;
+    ssize_t nwrite;
+    size_t total;
+    int n;
+
+    ASSERT(q != NULL);
+
+    if (q->error) {
+	errno = q->error;
+	return -1;
+    }
+    if (q->corked) {
+	return (ssize_t) q->pending;
+    }
+
+    while (q->head) {
+	n = 0;
+	total = 0;
+	for (e = q->head; e && n < IOV_BATCH; e = e->next) {
+	    vec[n].iov_base = e->buf->data + e->off;
+	    vec[n].iov_len = e->len;
+	    total += e->len;
+	    n++;
+	}
+
+	/* 뒤에 더 보낼 원소가 있으면 MSG_MORE */
+	if ((nwrite = queue_send(q, vec, n, e ? MSG_MORE : 0)) < 0) {
+	    return -1;
+	}
+	queue_consume(q, (size_t) nwrite);
+	if ((size_t) nwrite < total) {
+	    break;		/* 소켓 버퍼가 찼음 */
+	}
+    }
+
+    total = q->pending;
+    if (q->above && total <= q->low) {
+	q->above = 0;
+	if (q->cb) {
+	    q->cb(q, WQUEUE_EV_LOW, q->arg);
+	}
+    }
+
+    return (ssize_t) total;
+}
+
+
+/**
+ * @brief 쓰기 모으기 시작 (wqueue_uncork() 까지 보내지 않음, 중첩 가능)
+ * @param q - 쓰기 큐
+ * @return 없음
+ */
+void
+wqueue_cork(wqueue_t *q)
+{
+    ASSERT(q != NULL);
+
+    q->corked++;
+}
+
+
+/**
+ * @brief 쓰기 모으기 끝 (마지막 uncork 이면 모은 데이터를 바로 보냄)
+ * @param q - 쓰기 큐
+ * @return wqueue_flush() 와 같음
+ */
+ssize_t
+wqueue_uncork(wqueue_t *q)
+{
+    ASSERT(q != NULL);
+
+    if (q->corked > 0) {
+	q->corked--;
+    }
+    return wqueue_flush(q);
+}
+
+
+/**
+ * @brief 현재 이벤트 루프 반복이 끝날 때까지 쓰기 모으기
+ * @param q - 쓰기 큐
+ * @param loop - \a q 의 소켓이 등록된 이벤트 루프 (루프 쓰레드에서 호출)
+ * @return 항상 0 (이미 예약되어 있어도 0)
+ *
+ * 예약은 큐 안의 event_tick_t 노드를 루프의 리스트에 연결할 뿐이므로 할당,
+ * 잠금, 시스템콜이 없다.
+ * 읽기 콜백 처음에 호출하면 그 반복에서 처리한 요청들의 응답이 epoll_wait()
+ * 전에 한번에 전송된다.
+ */
+int
+wqueue_cork_tick(wqueue_t *q, event_loop_t *loop)
+{
+    ASSERT(q != NULL && loop != NULL);
+
+    if (q->tick.queued) {
+	return 0;
+    }
+    event_tick_init(&q->tick, tick_uncork, q);
+    event_tick(loop, &q->tick);
+    q->loop = loop;
+    q->corked++;
+
+    return 0;
+}
+
+
+/**
+ * @brief wqueue_cork_tick() 의 예약된 uncork
+ */
+static void
+tick_uncork(event_loop_t *loop, void *arg)
+{
+    wqueue_t *q = arg;
+
+    (void) loop;
+
+    (void) wqueue_uncork(q);
+}
+
+
+/**
+ * @brief non-blocking 쓰기 (EAGAIN 이면 0, 실패 시 에러 상태로 만들고 콜백)
+ * @return
+ *  성공 시 쓴 바이트 수,\n
+ *  실패 시 -1
+ */
+static ssize_t
+queue_send(wqueue_t *q, struct iovec *vec, int n, int flags)
+{
+    struct msghdr msg;
+    ssize_t nwrite;
+    int err;
+
+    for (;;) {
+	if (!q->notsock) {
+	    memset(&msg, 0, sizeof(msg));
+	    msg.msg_iov = vec;
+	    msg.msg_iovlen = n;
+	    nwrite = sendmsg(q->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | flags);
+	    if (nwrite < 0 && errno == ENOTSOCK) {
+		q->notsock = 1;
+		continue;
+	    }
+	}
+	else {
+	    nwrite = writev(q->fd, vec, n);
+	}
+
+	if (nwrite >= 0) {
+	    return nwrite;
+	}
+	if (errno == EINTR) {
+	    continue;
+	}
+	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    return 0;
+	}
+	break;
+    }
+
+    /* 연결 실패: 대기 데이터를 버리고 알림 */
+    err = errno;
+    q->error = err;
+    Log(DEBUG, "write queue fd %d failed: %s", q->fd, strerror(err));
+    queue_clear(q);
+    if (q->cb) {
+	q->cb(q, WQUEUE_EV_ERROR, q->arg);
+    }
+    errno = err;
+    return -1;
+}
+
+
+/**
+ * @brief 큐 끝에 버퍼 조각 추가 (참조는 큐가 넘겨받음)
+ */
+static int
+queue_append(wqueue_t *q, wbuf_t *b, size_t off, size_t len)
+{
+    wqueue_ent_t *e = NULL;
+
+    if ((e = q->free_ents) != NULL) {
+	q->free_ents = e->next;
+    }
+    else if ((e = malloc(sizeof(wqueue_ent_t))) == NULL) {
+	return -1;
+    }
+
+    e->buf = b;
+    e->off = off;
+    e->len = len;
+    e->next = NULL;
+    if (q->tail) {
+	q->tail->next = e;
+    }
+    else {
+	q->head = e;
+    }
+    q->tail = e;
+    q->pending += len;
+
+    return 0;
+}
+
+
+/**
+ * @brief 데이터를 큐 끝 버퍼에 이어서 복사 (공간이 없으면 새 버퍼)
+ */
+static int
+queue_copy(wqueue_t *q, const char *data, size_t len)
+{
+    wqueue_ent_t *e = q->tail;
+    wbuf_t *b = NULL;
+    size_t n;
+
+    /* 큐만 참조하는 내부 버퍼의 끝에 붙일 수 있으면 붙임 */
+    if (e && e->buf->free_cb == NULL && e->off + e->len == e->buf->len &&
+	    __atomic_load_n(&e->buf->refcnt, __ATOMIC_ACQUIRE) == 1) {
+	n = e->buf->size - e->buf->len;
+	if (n > len) {
+	    n = len;
+	}
+	memcpy(e->buf->data + e->buf->len, data, n);
+	e->buf->len += n;
+	e->len += n;
+	q->pending += n;
+	data += n;
+	len -= n;
+    }
+
+    if (len == 0) {
+	return 0;
+    }
+    if ((b = wbuf_create(len > WQUEUE_CHUNK ? len : WQUEUE_CHUNK)) == NULL) {
+	return -1;
+    }
+    memcpy(b->data, data, len);
+    b->len = len;
+    if (queue_append(q, b, 0, len) < 0) {
+	wbuf_unref(b);
+	return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 앞에서부터 \a done 바이트 제거
+ */
+static void
+queue_consume(wqueue_t *q, size_t done)
+{
+    wqueue_ent_t *e = NULL;
+
+    q->pending -= done;
+    while (done > 0 && (e = q->head) != NULL) {
+	if (done < e->len) {
+	    e->off += done;
+	    e->len -= done;
+	    break;
+	}
+	done -= e->len;
+	q->head = e->next;
+	if (q->head == NULL) {
+	    q->tail = NULL;
+	}
+	wbuf_unref(e->buf);
+	e->next = q->free_ents;
+	q->free_ents = e;
+    }
+}
+
+
+/**
+ * @brief 대기 데이터 모두 버림
+ */
+static void
+queue_clear(wqueue_t *q)
+{
+    queue_consume(q, q->pending);
+}
+
+
+/**
+ * @brief high watermark 를 넘었으면 콜백
+ * @return 0
+ */
+static int
+queue_check_high(wqueue_t *q)
+{
+    if (!q->above && q->pending >= q->high) {
+	q->above = 1;
+	if (q->cb) {
+	    q->cb(q, WQUEUE_EV_HIGH, q->arg);
+	}
+    }
+    return 0;
+}
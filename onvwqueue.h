@@ -0,0 +1,80 @@
+/**
+ * @file onvwqueue.h
+ * @brief 연결별 비동기 쓰기 큐 (참조계수 버퍼, watermark) 헤더
+ */
+
+/*
+ * 연결별 비동기 쓰기 큐 (참조계수 버퍼, watermark) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_WQUEUE_H
+#define ONV_WQUEUE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include "onvevent.h"
+
+#define WQUEUE_CHUNK	16384			/**< 작은 쓰기를 모아 복사하는 버퍼 크기 */
+#define WQUEUE_LOW	(64 * 1024)		/**< 기본 low watermark */
+#define WQUEUE_HIGH	(256 * 1024)		/**< 기본 high watermark */
+#define WQUEUE_MAX	(4 * 1024 * 1024)	/**< 기본 연결당 최대 대기 바이트 */
+
+#define WQUEUE_EV_HIGH	1	/**< 대기 바이트가 high watermark 이상이 됨 (생산 중지) */
+#define WQUEUE_EV_LOW	2	/**< high 이후 low watermark 이하로 내려감 (생산 재개) */
+#define WQUEUE_EV_ERROR	3	/**< 쓰기 실패 (wqueue_error()), 대기 데이터는 버려짐 */
+
+/**
+ * 외부 메모리 해제 콜백 (wbuf_wrap())
+ */
+typedef void (*wbuf_free_cb)(void *data, void *arg);
+
+/**
+ * 참조계수 버퍼 (여러 연결에 같은 데이터를 복사 없이 큐잉)
+ */
+typedef struct wbuf_s
+{
+    char *data;			/**< 데이터 */
+    size_t len;			/**< 데이터 길이 */
+    size_t size;		/**< \a data 의 할당 크기 */
+    int refcnt;			/**< 참조계수 */
+    wbuf_free_cb free_cb;	/**< 외부 메모리 해제 콜백 (NULL 이면 내부 메모리) */
+    void *free_arg;		/**< \a free_cb 인자 */
+} wbuf_t;
+
+typedef struct wqueue_s wqueue_t;
+
+/**
+ * watermark/에러 콜백
+ * @param q - 쓰기 큐
+ * @param event - WQUEUE_EV_HIGH, WQUEUE_EV_LOW, WQUEUE_EV_ERROR
+ * @param arg - wqueue_create() 의 \a arg
+ */
+typedef void (*wqueue_cb)(wqueue_t *q, int event, void *arg);
+
+wbuf_t *wbuf_create(size_t size);
+wbuf_t *wbuf_from(const void *data, size_t len);
+wbuf_t *wbuf_wrap(void *data, size_t len, wbuf_free_cb free_cb, void *arg);
+wbuf_t *wbuf_ref(wbuf_t *b);
+void wbuf_unref(wbuf_t *b);
+
+wqueue_t *wqueue_create(int fd, size_t low, size_t high, size_t max, wqueue_cb cb, void *arg);
+void wqueue_destroy(wqueue_t *q);
+int wqueue_fd(const wqueue_t *q);
+size_t wqueue_pending(const wqueue_t *q);
+int wqueue_error(const wqueue_t *q);
+int wqueue_write(wqueue_t *q, const void *data, size_t len);
+int wqueue_write_buf(wqueue_t *q, wbuf_t *b, size_t off, size_t len);
+ssize_t wqueue_flush(wqueue_t *q);
+void wqueue_cork(wqueue_t *q);
+ssize_t wqueue_uncork(wqueue_t *q);
+int wqueue_cork_tick(wqueue_t *q, event_loop_t *loop);
+
+#endif
@@ -0,0 +1,360 @@
+/**
+ * @file onvxfer.c
+ * @brief zero-copy 전송 (sendfile, splice)
+ */
+
+/*
+ * zero-copy 전송 (sendfile, splice)
+ *
+ * 파일 → 소켓은 sendfile(), 소켓 → 파일 및 소켓 → 소켓 중계는 파이프를 거치는
+ * splice() 로 커널 안에서 데이터를 옮긴다. 사용자 메모리로 read() 한 후
+ * writen() 하는 것보다 복사가 두번 줄어든다.
+ *
+ * 해당 fd 조합을 커널이 지원하지 않으면 (EINVAL, ENOSYS) 자동으로
+ * read()/writen() 버퍼 복사로 전송한다.
+ *
+ * blocking fd 기준이며, non-blocking fd 에서 EAGAIN 이 나면 그때까지 전송한
+ * 바이트수를 반환한다 (하나도 못 보냈으면 -1, errno = EAGAIN).
+ * 파이프로 읽어들인 데이터는 버리지 않는다. xfer_splice() 는 쓰레드별
+ * 파이프를 쓰므로 \a outfd 가 쓰기 가능해질 때까지 기다려 파이프를 비우고,
+ * non-blocking 연결은 xfer_pipe_t 를 연결마다 두고 xfer_splice_pipe() 로
+ * 다음 호출까지 파이프에 남겨둔다.
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include "misclib.h"
+#include "log.h"
+#include "onvwait.h"
+#include "onvxfer.h"
+
+/* 쓰레드별 splice() 중계 파이프 (재사용) */
+static __thread xfer_pipe_t xfer_pipe = { { -1, -1 }, 0 };
+
+static int pipe_drain(xfer_pipe_t *p, int outfd, size_t *total, int wait, int more);
+static ssize_t pipe_splice(xfer_pipe_t *p, int infd, int outfd, size_t count, int wait);
+
+
+/**
+ * @brief 중계 파이프 생성
+ * @param p - 파이프
+ * @return
+ *  성공 시 0,\n
+ *  실패 시 -1
+ */
+int
+xfer_pipe_open(xfer_pipe_t *p)
+{
+    ASSERT(p != NULL);
+
+    p->pending = 0;
+    if (pipe2(p->fd, O_CLOEXEC) < 0) {
+	Log(ERROR, "xfer: pipe2() failed: %s", strerror(errno));
+	p->fd[0] = p->fd[1] = -1;
+	return -1;
+    }
+    /* 실패해도 기본 크기(64KB)로 동작 */
+    fcntl(p->fd[1], F_SETPIPE_SZ, XFER_PIPE_SIZE);
+
+    return 0;
+}
+
+
+/**
+ * @brief 중계 파이프 닫기 (남은 데이터는 버려짐)
+ * @param p - 파이프
+ * @return 없음
+ */
+void
+xfer_pipe_close(xfer_pipe_t *p)
+{
+    int saved = errno;
+
+    if (p->fd[0] >= 0) {
+	close(p->fd[0]);
+	close(p->fd[1]);
+    }
+    p->fd[0] = p->fd[1] = -1;
+    p->pending = 0;
+    errno = saved;
+}
+
+
+/**
+ * @brief 파이프에 남은 데이터를 \a outfd 로 내보냄
+ * @param p - 파이프
+ * @param outfd - 쓸 descriptor
+ * @param total - (IN/OUT) 내보낸 만큼 증가
+ * @param wait - EAGAIN 이면 쓰기 가능해질 때까지 기다림
+ * @param more - 뒤에 데이터가 더 올 때만 1 (SPLICE_F_MORE, TCP 에서 cork 처럼 동작)
+ * @return
+ *  파이프가 비면 0,\n
+ *  실패 시 -1 (EAGAIN 이면 남은 데이터는 p->pending 에 유지)
+ */
+static int
+pipe_drain(xfer_pipe_t *p, int outfd, size_t *total, int wait, int more)
+{
+    ssize_t m;
+
+    while (p->pending > 0) {
+	m = splice(p->fd[0], NULL, outfd, NULL, p->pending,
+		SPLICE_F_MOVE | (more ? SPLICE_F_MORE : 0));
+	if (m > 0) {
+	    p->pending -= m;
+	    *total += m;
+	    continue;
+	}
+	if (m < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (m < 0 && errno == EAGAIN && wait) {
+	    if (wait_fd(outfd, WAIT_WRITE, WAIT_FOREVER) < 0) {
+		return -1;
+	    }
+	    continue;
+	}
+	if (m == 0) {
+	    errno = EIO;
+	}
+	return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief 파이프를 거쳐 \a infd 에서 \a outfd 로 splice
+ * @return
+ *  성공 시 \a outfd 로 내보낸 바이트수,\n
+ *  실패 시 -1 (\a wait 가 0 이고 splice() 불가이면 EINVAL)
+ *
+ * \a wait 가 0 이면 xfer_copy() 로 대신하지 않는다. 버퍼로 읽은 데이터를
+ * EAGAIN 에 보관할 곳이 없기 때문이다.
+ */
+static ssize_t
+pipe_splice(xfer_pipe_t *p, int infd, int outfd, size_t count, int wait)
+{
+    ssize_t n;
+    size_t total = 0, chunk;
+
+    /* 지난 호출에서 남은 데이터부터 */
+    if (pipe_drain(p, outfd, &total, wait, 0) < 0) {
+	goto error;
+    }
+
+    while (count == 0 || total < count) {
+	chunk = XFER_CHUNK;
+	if (count && count - total < chunk) {
+	    chunk = count - total;
+	}
+	n = splice(infd, NULL, p->fd[1], NULL, chunk, SPLICE_F_MOVE);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+		if (!wait) {
+		    errno = EINVAL;
+		    return -1;
+		}
+		return xfer_copy(infd, outfd, NULL, count);
+	    }
+	    goto error;
+	}
+	if (n == 0) {
+	    break;	/* EOF */
+	}
+
+	/* chunk 를 다 채웠고 count 가 남았을 때만 뒤에 더 온다고 본다 */
+	p->pending = n;
+	if (pipe_drain(p, outfd, &total, wait,
+		    (size_t) n == chunk && (count == 0 || total + n < count)) < 0) {
+	    goto error;
+	}
+    }
+
+    return (ssize_t) total;
+
+error:
+    if (errno == EAGAIN && total > 0) {
+	return (ssize_t) total;
+    }
+    if (errno != EAGAIN && p->pending > 0) {
+	Log(ERROR, "xfer: splice() to fd %d failed: %s", outfd, strerror(errno));
+    }
+    return -1;
+}
+
+
+/**
+ * @brief 파일을 소켓으로 전송 (sendfile)
+ * @param sockfd - 소켓
+ * @param filefd - 파일
+ * @param offset - 파일 위치 (전송 후 갱신, NULL 이면 파일의 현재 위치 사용)
+ * @param count - 전송할 바이트수 (0 이면 파일 끝까지)
+ * @return
+ *  성공 시 전송한 바이트수 (파일이 짧으면 \a count 보다 작음),\n
+ *  실패 시 -1
+ */
+ssize_t
+xfer_sendfile(int sockfd, int filefd, off_t *offset, size_t count)
+{
+    ssize_t n;
+    size_t total = 0, chunk;
+
+    while (count == 0 || total < count) {
+	chunk = XFER_CHUNK;
+	if (count && count - total < chunk) {
+	    chunk = count - total;
+	}
+	if ((n = sendfile(sockfd, filefd, offset, chunk)) < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+		/* 이 조합은 sendfile() 불가 */
+		return xfer_copy(filefd, sockfd, offset, count);
+	    }
+	    if (errno == EAGAIN && total > 0) {
+		break;
+	    }
+	    return -1;
+	}
+	if (n == 0) {
+	    break;	/* EOF */
+	}
+	total += n;
+    }
+
+    return (ssize_t) total;
+}
+
+
+/**
+ * @brief fd 간 중계 (splice, 소켓 → 파일, 소켓 → 소켓 등)
+ * @param infd - 읽을 descriptor
+ * @param outfd - 쓸 descriptor
+ * @param count - 전송할 바이트수 (0 이면 EOF 까지)
+ * @return
+ *  성공 시 전송한 바이트수,\n
+ *  실패 시 -1
+ *
+ * 쓰레드별로 재사용하는 파이프를 거쳐 splice() 한다. 읽은 데이터는 모두
+ * \a outfd 로 쓴 후에 반환한다 (\a outfd 가 EAGAIN 이면 쓰기 가능해질 때까지
+ * 기다린다).
+ */
+ssize_t
+xfer_splice(int infd, int outfd, size_t count)
+{
+    ssize_t n;
+
+    if (xfer_pipe.fd[0] < 0 && xfer_pipe_open(&xfer_pipe) < 0) {
+	return xfer_copy(infd, outfd, NULL, count);
+    }
+    if ((n = pipe_splice(&xfer_pipe, infd, outfd, count, 1)) < 0 && xfer_pipe.pending > 0) {
+	/* outfd 에러로 못 쓴 데이터가 다른 연결로 가지 않도록 */
+	xfer_pipe_close(&xfer_pipe);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief 연결별 파이프로 fd 간 중계 (non-blocking fd 용)
+ * @param p - xfer_pipe_open() 으로 만든 파이프
+ * @param infd - 읽을 descriptor
+ * @param outfd - 쓸 descriptor
+ * @param count - 내보낼 바이트수 (0 이면 EOF 까지)
+ * @return
+ *  성공 시 \a outfd 로 내보낸 바이트수 (EOF 이면 0),\n
+ *  실패 시 -1 (EAGAIN 이면 다시 호출, EINVAL 이면 splice() 불가)
+ *
+ * \a outfd 가 EAGAIN 이면 읽은 데이터를 파이프에 남겨두고 (p->pending)
+ * 다음 호출에서 먼저 내보낸다. 연결을 끊을 때 xfer_pipe_close() 한다.
+ * 이 fd 조합을 splice() 할 수 없으면 EINVAL 이므로 호출자가 자신의 버퍼
+ * 복사로 전송한다.
+ */
+ssize_t
+xfer_splice_pipe(xfer_pipe_t *p, int infd, int outfd, size_t count)
+{
+    ASSERT(p != NULL && p->fd[0] >= 0);
+
+    return pipe_splice(p, infd, outfd, count, 0);
+}
+
+
+/**
+ * @brief 버퍼 복사 전송 (read/writen, sendfile/splice 불가 시)
+ * @param infd - 읽을 descriptor
+ * @param outfd - 쓸 descriptor
+ * @param offset - 읽을 위치 (pread() 후 갱신, NULL 이면 현재 위치)
+ * @param count - 전송할 바이트수 (0 이면 EOF 까지)
+ * @return
+ *  성공 시 전송한 바이트수,\n
+ *  실패 시 -1
+ */
+ssize_t
+xfer_copy(int infd, int outfd, off_t *offset, size_t count)
+{
+    char *buf = NULL;
+    ssize_t n;
+    size_t total = 0, chunk;
+
+    if ((buf = malloc(XFER_BUF_SIZE)) == NULL) {
+	Log(ERROR, "xfer: malloc() failed: %s", strerror(errno));
+	return -1;
+    }
+
+    while (count == 0 || total < count) {
+	chunk = XFER_BUF_SIZE;
+	if (count && count - total < chunk) {
+	    chunk = count - total;
+	}
+	n = offset ? pread(infd, buf, chunk, *offset) : read(infd, buf, chunk);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (errno == EAGAIN && total > 0) {
+		break;
+	    }
+	    free(buf);
+	    return -1;
+	}
+	if (n == 0) {
+	    break;	/* EOF */
+	}
+	if (writen(outfd, buf, n) != n) {
+	    free(buf);
+	    return -1;
+	}
+	if (offset) {
+	    *offset += n;
+	}
+	total += n;
+    }
+    free(buf);
+
+    return (ssize_t) total;
+}
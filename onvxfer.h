@@ -0,0 +1,44 @@
+/**
+ * @file onvxfer.h
+ * @brief zero-copy 전송 (sendfile, splice) 헤더
+ */
+
+/*
+ * zero-copy 전송 (sendfile, splice) 헤더
+ *
+ * AUTHOR:
+ *
+ * Copyright 2010 OneNetView, Inc.  All rights reserved. (방창현 winchild@kldp.org)
+ *
+ */
+
+#ifndef ONV_XFER_H
+#define ONV_XFER_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+
+#define XFER_CHUNK	(1024 * 1024)	/**< sendfile()/splice() 한번에 요청하는 최대 크기 */
+#define XFER_PIPE_SIZE	(1024 * 1024)	/**< splice() 중계 파이프 크기 */
+#define XFER_BUF_SIZE	65536		/**< 버퍼 복사(fallback) 크기 */
+
+/**
+ * splice() 중계 파이프 (non-blocking 연결마다 하나씩)
+ */
+typedef struct xfer_pipe_s
+{
+    int fd[2];			/**< 파이프 (읽기, 쓰기) */
+    size_t pending;		/**< 파이프에 남아 아직 쓰지 못한 바이트수 */
+} xfer_pipe_t;
+
+ssize_t xfer_sendfile(int sockfd, int filefd, off_t *offset, size_t count);
+ssize_t xfer_splice(int infd, int outfd, size_t count);
+int xfer_pipe_open(xfer_pipe_t *p);
+void xfer_pipe_close(xfer_pipe_t *p);
+ssize_t xfer_splice_pipe(xfer_pipe_t *p, int infd, int outfd, size_t count);
+ssize_t xfer_copy(int infd, int outfd, off_t *offset, size_t count);
+
+#endif